@@ -0,0 +1,278 @@
+// cppAuth_microbench: Google Benchmark suite for the per-request components.
+//
+// Usage:
+//   cppAuth_microbench [--benchmark_filter=REGEX] [any other --benchmark_* flag]
+//
+// Results are printed and, unless --benchmark_out is given, also written to
+// bench_results.json (Google Benchmark's JSON format, with the git commit in
+// the context block) so runs can be compared over time, e.g. with
+// benchmark's tools/compare.py.
+//
+// Every benchmark runs at 1, 2, 4, ... threads up to the core count (wall
+// time, so the per-thread rate shows how it scales) and reports
+// allocs_per_iter and bytes_per_iter, counted by the operator new below.
+//
+// RequestLoggerJSON is not covered: its doFilter() does not match
+// drogon::HttpFilter's interface, so it cannot be compiled. The
+// file-logger benchmarks write into the working directory.
+
+#include <benchmark/benchmark.h>
+#include <bcrypt/BCrypt.hpp>
+#include <drogon/orm/DbClient.h>
+#include <json/json.h>
+#include <jwt-cpp/jwt.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AllocStats.h"
+#include "DbLoggerAuto.h"
+#include "DbLoggerRotating.h"
+#include "IdAllocator.h"
+#include "JwtSigner.h"
+#include "LoggerBase.h"
+#include "RuntimeConfig.h"
+#include "jwt_utils.h"
+
+#ifndef CPPAUTH_GIT_COMMIT
+#define CPPAUTH_GIT_COMMIT "unknown"
+#endif
+
+namespace {
+thread_local uint64_t threadAllocations = 0;
+thread_local uint64_t threadBytes = 0;
+}
+
+// Same counting as the server (see main.cc), plus per-thread totals so each
+// benchmark thread can attribute its own allocations.
+void *operator new(std::size_t n) {
+    AllocStats::record(n);
+    ++threadAllocations;
+    threadBytes += n;
+    if (void *p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+// Reports the allocations made by this thread during the timed loop as
+// per-iteration averages; construct before the loop.
+class AllocCounter
+{
+public:
+    explicit AllocCounter(benchmark::State &state)
+        : state_(state), allocations_(threadAllocations), bytes_(threadBytes) {}
+
+    ~AllocCounter()
+    {
+        state_.counters["allocs_per_iter"] =
+            benchmark::Counter(static_cast<double>(threadAllocations - allocations_), benchmark::Counter::kAvgIterations);
+        state_.counters["bytes_per_iter"] =
+            benchmark::Counter(static_cast<double>(threadBytes - bytes_), benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State &state_;
+    uint64_t allocations_;
+    uint64_t bytes_;
+};
+
+int maxThreads() { return static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); }
+
+void scaling(benchmark::internal::Benchmark *b) { b->ThreadRange(1, maxThreads())->UseRealTime(); }
+
+const ConfigSnapshot &config() {
+    static const ConfigSnapshot &cfg = [] () -> const ConfigSnapshot & {
+        setenv("JWT_SECRET", "microbench-secret-0123456789abcdef", 0);
+        return RuntimeConfig::reloadFromEnv();
+    }();
+    return cfg;
+}
+
+// ---------------------- Passwords ----------------------
+
+void BM_HashPassword(benchmark::State &state) {
+    int cost = static_cast<int>(state.range(0));
+    AllocCounter allocs(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(BCrypt::generateHash("correct horse battery staple", cost));
+}
+BENCHMARK(BM_HashPassword)->ArgName("cost")->Arg(4)->Arg(8)->Arg(10)->Arg(12)
+    ->Unit(benchmark::kMillisecond)->Apply(scaling);
+
+void BM_VerifyPassword(benchmark::State &state) {
+    static const std::string hashes[] = {BCrypt::generateHash("correct horse battery staple", 4),
+                                         BCrypt::generateHash("correct horse battery staple", 8),
+                                         BCrypt::generateHash("correct horse battery staple", 10),
+                                         BCrypt::generateHash("correct horse battery staple", 12)};
+    const std::string &hash = hashes[state.range(0) <= 4 ? 0 : state.range(0) <= 8 ? 1 : state.range(0) <= 10 ? 2 : 3];
+    AllocCounter allocs(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(BCrypt::validatePassword("correct horse battery staple", hash));
+}
+BENCHMARK(BM_VerifyPassword)->ArgName("cost")->Arg(4)->Arg(8)->Arg(10)->Arg(12)
+    ->Unit(benchmark::kMillisecond)->Apply(scaling);
+
+// ---------------------- Tokens ----------------------
+
+// What AuthController::generateAccessToken does.
+void BM_GenerateAccessToken(benchmark::State &state) {
+    const auto &cfg = config();
+    AllocCounter allocs(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(JwtSigner::sign("microbench_user", cfg.accessTokenTtl, cfg.jwtSecret));
+}
+BENCHMARK(BM_GenerateAccessToken)->Apply(scaling);
+
+// The jwt-cpp builder it replaced, for comparison.
+void BM_GenerateAccessTokenJwtCpp(benchmark::State &state) {
+    const auto &cfg = config();
+    AllocCounter allocs(state);
+    for (auto _ : state) {
+        auto now = std::chrono::system_clock::now();
+        benchmark::DoNotOptimize(jwt::create()
+                                     .set_issuer(JwtSigner::kIssuer)
+                                     .set_subject("microbench_user")
+                                     .set_issued_at(now)
+                                     .set_expires_at(now + cfg.accessTokenTtl)
+                                     .sign(jwt::algorithm::hs256{cfg.jwtSecret}));
+    }
+}
+BENCHMARK(BM_GenerateAccessTokenJwtCpp)->Apply(scaling);
+
+// What JwtMiddleware and the bank handlers run per request.
+void BM_VerifyToken(benchmark::State &state) {
+    const auto &cfg = config();
+    static const std::string token = JwtSigner::sign("microbench_user", cfg.accessTokenTtl, cfg.jwtSecret);
+    AllocCounter allocs(state);
+    std::string subject;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(verifyJWT(token, cfg, subject));
+}
+BENCHMARK(BM_VerifyToken)->Apply(scaling);
+
+// The jwt-cpp fallback, taken for tokens JwtSigner does not recognise.
+void BM_VerifyTokenGeneric(benchmark::State &state) {
+    const auto &cfg = config();
+    static const std::string token = JwtSigner::sign("microbench_user", cfg.accessTokenTtl, cfg.jwtSecret);
+    AllocCounter allocs(state);
+    std::string subject;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(verifyJWTGeneric(token, cfg, subject));
+}
+BENCHMARK(BM_VerifyTokenGeneric)->Apply(scaling);
+
+// ---------------------- Account numbers ----------------------
+
+void BM_GenerateAccountNumber(benchmark::State &state) {
+    uint64_t sequence = 1000000 * static_cast<uint64_t>(state.thread_index() + 1);
+    AllocCounter allocs(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(AccountNumber::format(sequence++));
+}
+BENCHMARK(BM_GenerateAccountNumber)->Apply(scaling);
+
+// ---------------------- Loggers ----------------------
+
+const drogon::orm::DbClientPtr &sqlite() {
+    static auto client = [] {
+        auto c = drogon::orm::DbClient::newSqlite3Client("filename=:memory:", 1);
+        c->execSqlSync("SELECT 1"); // wait for the connection
+        return c;
+    }();
+    return client;
+}
+
+// Baseline for the two DB loggers: the same statement without logging.
+void BM_SqliteSelectUnlogged(benchmark::State &state) {
+    const auto &client = sqlite();
+    AllocCounter allocs(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(client->execSqlSync("SELECT 1"));
+}
+BENCHMARK(BM_SqliteSelectUnlogged)->Apply(scaling);
+
+void BM_DbLoggerAuto(benchmark::State &state) {
+    static DbLoggerAuto logger(sqlite(), "microbench_db_api_log.json");
+    AllocCounter allocs(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(logger.execSqlSync("SELECT 1"));
+}
+BENCHMARK(BM_DbLoggerAuto)->Apply(scaling);
+
+void BM_DbLoggerRotating(benchmark::State &state) {
+    static DbLoggerRotating logger(sqlite());
+    AllocCounter allocs(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(logger.execSqlSync("SELECT 1"));
+}
+BENCHMARK(BM_DbLoggerRotating)->Apply(scaling);
+
+struct JsonFileLogger : LoggerBase
+{
+    using LoggerBase::LoggerBase;
+    using LoggerBase::writeJson;
+};
+
+void BM_LoggerBaseWriteJson(benchmark::State &state) {
+    static JsonFileLogger logger("microbench_log");
+    nlohmann::json entry;
+    entry["timestamp"] = "2026-10-19T12:00:00";
+    entry["sql"] = "UPDATE users SET balance = balance + $1 WHERE account_number=$2 RETURNING balance";
+    entry["rows"] = 1;
+    entry["status"] = "success";
+    AllocCounter allocs(state);
+    for (auto _ : state)
+        logger.writeJson(entry);
+}
+BENCHMARK(BM_LoggerBaseWriteJson)->Apply(scaling);
+
+// ---------------------- Request bodies ----------------------
+
+// The jsoncpp parse behind req->getJsonObject(), on a /transfer body.
+void BM_ParseJsonBody(benchmark::State &state) {
+    static const std::string body =
+        R"({"to_account":"ACCT0000012345","amount":125.50,"memo":"rent for october","idempotency_key":"3f1c9a2e-7d4b-4c55-9a7e-2b1f0c8d6e4a"})";
+    Json::CharReaderBuilder builder;
+    builder["collectComments"] = false;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    AllocCounter allocs(state);
+    for (auto _ : state) {
+        Json::Value root;
+        std::string errs;
+        benchmark::DoNotOptimize(reader->parse(body.data(), body.data() + body.size(), &root, &errs));
+    }
+}
+BENCHMARK(BM_ParseJsonBody)->Apply(scaling);
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<char *> args(argv, argv + argc);
+    bool hasOut = std::any_of(args.begin(), args.end(),
+                              [](const char *a) { return std::strncmp(a, "--benchmark_out=", 16) == 0; });
+    std::string out = "--benchmark_out=bench_results.json";
+    std::string format = "--benchmark_out_format=json";
+    if (!hasOut) {
+        args.push_back(out.data());
+        args.push_back(format.data());
+    }
+    int n = static_cast<int>(args.size());
+    benchmark::Initialize(&n, args.data());
+    if (benchmark::ReportUnrecognizedArguments(n, args.data()))
+        return 1;
+    benchmark::AddCustomContext("git_commit", CPPAUTH_GIT_COMMIT);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,18 @@
+#include "AdminController.h"
+#include "AdminFilter.h"
+#include <spdlog/spdlog.h>
+#include "JsonWriter.h"
+#include "RuntimeConfig.h"
+
+void AdminController::reloadConfig(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+    const std::string oldSecret = RuntimeConfig::current().jwtSecret;
+    const auto &cfg = RuntimeConfig::reloadFromEnv();
+    bool rotated = cfg.jwtSecret != oldSecret;
+
+    JsonWriter j;
+    j.field("status", "reloaded")
+        .field("version", static_cast<int64_t>(cfg.version))
+        .field("rotated", rotated);
+    callback(j.toResponse());
+    spdlog::info("Config reloaded via admin endpoint (version {}, secret rotated: {})", cfg.version, rotated);
+}
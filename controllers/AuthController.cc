@@ -39,11 +39,20 @@
 #include <laserpants/dotenv/dotenv.h>
 #include <chrono>
 #include <drogon/drogon.h>
+#include <cstring>
+#include <memory_resource>
 #include <string>
 #include <functional>
 #include <cstdlib>
 #include <iostream>
 #include <bcrypt/BCrypt.hpp>
+#include "JsonWriter.h"
+#include "JwtSigner.h"
+#include "PasswordHasher.h"
+#include "RequestScope.h"
+#include "RuntimeConfig.h"
+#include "jwt_utils.h"
+#include "ResponseCache.h"
 
 using json = nlohmann::json;
 
@@ -59,12 +68,11 @@ namespace {
         return jsonObj;
     }
 
-    HttpResponsePtr errorResponse(const std::string &msg, HttpStatusCode code) {
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(code);
-        resp->setBody(msg);
-        return resp;
+    HttpResponsePtr errorResponse(CannedResponse which) {
+        return ResponseCache::get(which);
     }
+
+    const std::string kProfileSql = "SELECT id, username, email, created_at FROM users WHERE username=$1";
 }
 
 std::string hashPassword(const std::string &password) {
@@ -79,56 +87,102 @@ bool verifyPassword(const std::string &password, const std::string &hash) {
 
 
 AuthController::AuthController() {
-    const char *envSecret = std::getenv("JWT_SECRET");
-    if (envSecret && std::string(envSecret).size() > 0) {
-        jwtSecret = envSecret;
-        std::cout << "[INFO] JWT_SECRET loaded from .env file." << std::endl;
-    } else {
-        jwtSecret = "default_secret_key";
+    if (!std::getenv("JWT_SECRET")) {
         std::cerr << "[WARN] JWT_SECRET not set. Using fallback secret!" << std::endl;
     }
 }
 
-// Constructor with injected DB client and JWT secret used by main.cc
-AuthController::AuthController(drogon::orm::DbClientPtr dbClientParam, const std::string &jwtSecretParam)
+// Constructor with injected DB router used by main.cc
+AuthController::AuthController(std::shared_ptr<ShardMap> shards, std::shared_ptr<IdAllocator> accountIds,
+                               std::shared_ptr<SingleFlight> flights, std::shared_ptr<SessionStore> sessions)
+    : shards_(std::move(shards)), accountIds_(std::move(accountIds)), flights_(std::move(flights)),
+      sessions_(sessions ? std::move(sessions) : std::make_shared<MemorySessionStore>())
 {
-    // Store jwt secret from main
-    jwtSecret = jwtSecretParam;
     // Optionally set the global dbClient used across controllers
-    if (dbClientParam) {
-        dbClient = dbClientParam;
+    if (shards_ && shards_->primary()->writer()) {
+        dbClient = shards_->primary()->writer();
     }
 }
 
 
 
+// Request state for register/login; callbacks capture only this
+struct AuthController::CredentialsScope : RequestScope {
+    AuthController *controller;
+    std::pmr::string username;
+    std::pmr::string email;
+    std::pmr::string password;
+    std::pmr::string accountNumber;
+
+    CredentialsScope(Callback &&cb, AuthController *c, const Json::Value &body)
+        : RequestScope(std::move(cb)), controller(c),
+          username(jsonString(body, "username"), arena()),
+          email(jsonString(body, "email"), arena()),
+          password(jsonString(body, "password"), arena()),
+          accountNumber(arena()) {}
+
+    // View of a string member without copying it out of the JSON tree
+    static std::string_view jsonString(const Json::Value &body, const char *key) {
+        const Json::Value *v = body.find(key, key + std::strlen(key));
+        const char *begin = nullptr, *end = nullptr;
+        if (!v || !v->isString() || !v->getString(&begin, &end))
+            return {};
+        return std::string_view(begin, static_cast<size_t>(end - begin));
+    }
+};
+
 // ---------------------- Register User ----------------------
+
 void AuthController::registerUser(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback)
 {
     auto jsonReq = validateJson(req);
     if (!jsonReq) {
-        callback(errorResponse("Invalid JSON", k400BadRequest));
+        callback(errorResponse(CannedResponse::InvalidJson));
         return;
     }
-
-    std::string username = (*jsonReq)["username"].asString();
-    std::string email = (*jsonReq)["email"].asString();
-    std::string password = (*jsonReq)["password"].asString();
-
-    std::string passwordHash = hashPassword(password);
-
-    dbClient->execSqlAsync(
-        "INSERT INTO users (username, email, password_hash) VALUES ($1, $2, $3)",
-        [callback](const drogon::orm::Result &) {
-            Json::Value resp;
-            resp["status"] = "success";
-            callback(HttpResponse::newHttpJsonResponse(resp));
+    auto s = RequestScope::make<CredentialsScope>(std::move(callback), this, *jsonReq);
+
+    // The account number comes from a pre-reserved block, so it is unique
+    // without a lookup or retry.
+    accountIds_->next(
+        [s](uint64_t sequence) {
+            s->accountNumber = AccountNumber::format(sequence);
+            // With several shards the username is claimed globally first
+            s->controller->shards_->claimUsername(std::string(s->username), std::string(s->accountNumber),
+                [s](bool claimed) {
+                    if (!claimed) {
+                        s->respond(errorResponse(CannedResponse::ErrorCreatingUser));
+                        return;
+                    }
+                    PasswordHasher::instance().hash(std::string(s->password),
+                        [s](std::string passwordHash) {
+                            s->controller->shards_->forAccount(s->accountNumber)->write(
+                                "INSERT INTO users (username, email, password_hash, account_number) VALUES ($1, $2, $3, $4)",
+                                [s](const drogon::orm::Result &) {
+                                    // A "not found" profile read may still be in flight
+                                    if (s->controller->flights_)
+                                        s->controller->flights_->forget(SingleFlight::key(kProfileSql, {s->username}));
+                                    JsonWriter resp;
+                                    resp.field("status", "success")
+                                        .field("account_number", std::string_view(s->accountNumber));
+                                    s->respond(resp.toResponse());
+                                },
+                                [s](const drogon::orm::DrogonDbException &e) {
+                                    s->controller->shards_->releaseUsername(std::string(s->username),
+                                                                            std::string(s->accountNumber));
+                                    s->respond(errorResponse(CannedResponse::ErrorCreatingUser));
+                                },
+                                s->username.c_str(), s->email.c_str(), passwordHash, s->accountNumber.c_str()
+                            );
+                        });
+                },
+                [s](const drogon::orm::DrogonDbException &e) {
+                    s->respond(errorResponse(CannedResponse::ErrorCreatingUser));
+                });
         },
-        [callback](const drogon::orm::DrogonDbException &e) {
-            callback(errorResponse("Error creating user", k500InternalServerError));
-        },
-        username, email, passwordHash
-    );
+        [s](const std::string &) {
+            s->respond(errorResponse(CannedResponse::ErrorCreatingUser));
+        });
 }
 
 // ---------------------- Login User ----------------------
@@ -136,68 +190,66 @@ void AuthController::loginUser(const HttpRequestPtr &req, std::function<void(con
 {
     auto jsonReq = validateJson(req);
     if (!jsonReq) {
-        callback(errorResponse("Invalid JSON", k400BadRequest));
+        callback(errorResponse(CannedResponse::InvalidJson));
         return;
     }
+    auto s = RequestScope::make<CredentialsScope>(std::move(callback), this, *jsonReq);
 
-    std::string username = (*jsonReq)["username"].asString();
-    std::string password = (*jsonReq)["password"].asString();
-
-    dbClient->execSqlAsync(
-        "SELECT password_hash FROM users WHERE username=$1",
-        [this, callback, password, username](const drogon::orm::Result &r) {
+    // Only the shard the username was registered on is asked
+    shards_->readForUser(std::string(s->username),
+        "SELECT password_hash, account_number FROM users WHERE username=$1",
+        [s](const drogon::orm::Result &r) {
             if (r.empty()) {
-                callback(errorResponse("User not found", k401Unauthorized));
+                s->respond(errorResponse(CannedResponse::UserNotFound));
                 return;
             }
 
             std::string storedHash = r[0]["password_hash"].as<std::string>();
-            if (!verifyPassword(password, storedHash)) {
-                callback(errorResponse("Invalid password", k401Unauthorized));
-                return;
-            }
-
-            auto accessToken = generateAccessToken(username);
-            auto refreshToken = generateRefreshToken(username);
-
-            Json::Value resp;
-            resp["status"] = "success";
-            resp["access_token"] = accessToken;
-            resp["refresh_token"] = refreshToken;
-            callback(HttpResponse::newHttpJsonResponse(resp));
+            s->accountNumber = r[0]["account_number"].as<std::string>();
+            PasswordHasher::instance().verify(std::string(s->password), std::move(storedHash),
+                [s](bool ok) {
+                    if (!ok) {
+                        s->respond(errorResponse(CannedResponse::InvalidPassword));
+                        return;
+                    }
+
+                    std::string username(s->username);
+                    std::string account(s->accountNumber);
+                    auto accessToken = s->controller->generateAccessToken(username, account);
+                    auto refreshToken = s->controller->generateRefreshToken(username, account);
+
+                    s->controller->sessions_->put(username, refreshToken, RuntimeConfig::current().refreshTokenTtl,
+                        [s, accessToken, refreshToken](SessionStore::Result result) {
+                            if (result != SessionStore::Result::Ok) {
+                                s->respond(errorResponse(CannedResponse::ErrorLoggingIn));
+                                return;
+                            }
+                            JsonWriter resp;
+                            resp.field("status", "success")
+                                .field("access_token", accessToken)
+                                .field("refresh_token", refreshToken);
+                            s->respond(resp.toResponse());
+                        });
+                });
         },
-        [callback](const drogon::orm::DrogonDbException &e) {
-            callback(errorResponse("Error logging in", k500InternalServerError));
+        [s](const drogon::orm::DrogonDbException &e) {
+            s->respond(errorResponse(CannedResponse::ErrorLoggingIn));
         },
-        username
+        s->username.c_str()
     );
 }
 
 // ---------------------- JWT Tokens ----------------------
-std::string AuthController::generateAccessToken(const std::string &username)
+std::string AuthController::generateAccessToken(const std::string &username, const std::string &account)
 {
-    using namespace std::chrono;
-    return jwt::create()
-        .set_issuer("my_cppAuth")
-        .set_subject(username)
-        .set_issued_at(system_clock::now())
-        .set_expires_at(system_clock::now() + minutes{15})
-        .sign(jwt::algorithm::hs256{jwtSecret});
+    const auto &cfg = RuntimeConfig::current();
+    return JwtSigner::sign(username, cfg.accessTokenTtl, cfg.jwtSecret, account);
 }
 
-std::string AuthController::generateRefreshToken(const std::string &username)
+std::string AuthController::generateRefreshToken(const std::string &username, const std::string &account)
 {
-    using namespace std::chrono;
-    auto token = jwt::create()
-        .set_issuer("my_cppAuth")
-        .set_subject(username)
-        .set_issued_at(system_clock::now())
-        .set_expires_at(system_clock::now() + hours{24*7})
-        .sign(jwt::algorithm::hs256{jwtSecret});
-
-    std::lock_guard<std::mutex> lock(refreshMutex);
-    refreshTokens[username] = token;
-    return token;
+    const auto &cfg = RuntimeConfig::current();
+    return JwtSigner::sign(username, cfg.refreshTokenTtl, cfg.jwtSecret, account);
 }
 
 // ---------------------- Refresh Token ----------------------
@@ -205,34 +257,54 @@ void AuthController::refreshToken(const HttpRequestPtr &req, std::function<void(
 {
     auto jsonReq = validateJson(req);
     if (!jsonReq) {
-        callback(errorResponse("Invalid JSON", k400BadRequest));
+        callback(errorResponse(CannedResponse::InvalidJson));
         return;
     }
 
     std::string username = (*jsonReq)["username"].asString();
     std::string oldToken = (*jsonReq)["refresh_token"].asString();
 
-    std::lock_guard<std::mutex> lock(refreshMutex);
-    if (refreshTokens.find(username) == refreshTokens.end() || refreshTokens[username] != oldToken) {
-        callback(errorResponse("Invalid refresh token", k401Unauthorized));
-        return;
-    }
+    // Usually answered from the store's local cache
+    sessions_->check(username, oldToken,
+        [this, callback = std::move(callback), username, oldToken](SessionStore::Result result) {
+            if (result != SessionStore::Result::Ok) {
+                callback(errorResponse(result == SessionStore::Result::Rejected ? CannedResponse::InvalidRefreshToken
+                                                                                 : CannedResponse::DatabaseError));
+                return;
+            }
 
-    try {
-        auto decoded = jwt::decode(oldToken);
-        jwt::verify()
-            .allow_algorithm(jwt::algorithm::hs256{jwtSecret})
-            .with_issuer("my_cppAuth")
-            .verify(decoded);
-
-        Json::Value resp;
-        resp["access_token"] = generateAccessToken(username);
-        resp["refresh_token"] = generateRefreshToken(username);
-        callback(HttpResponse::newHttpJsonResponse(resp));
-    }
-    catch (...) {
-        callback(errorResponse("Refresh token expired or invalid", k401Unauthorized));
-    }
+            std::string subject, account;
+            if (!verifyJWT(oldToken, subject, &account) || subject != username) {
+                callback(errorResponse(CannedResponse::RefreshTokenExpired));
+                return;
+            }
+
+            std::string accessToken, refreshToken;
+            try {
+                accessToken = generateAccessToken(username, account);
+                refreshToken = generateRefreshToken(username, account);
+            }
+            catch (...) {
+                callback(errorResponse(CannedResponse::RefreshTokenExpired));
+                return;
+            }
+
+            // Compare-and-swap: a token replayed concurrently, here or on
+            // another replica, loses
+            sessions_->rotate(username, oldToken, refreshToken, RuntimeConfig::current().refreshTokenTtl,
+                [callback, accessToken, refreshToken](SessionStore::Result rotated) {
+                    if (rotated != SessionStore::Result::Ok) {
+                        callback(errorResponse(rotated == SessionStore::Result::Rejected
+                                                   ? CannedResponse::InvalidRefreshToken
+                                                   : CannedResponse::DatabaseError));
+                        return;
+                    }
+                    JsonWriter resp;
+                    resp.field("access_token", accessToken)
+                        .field("refresh_token", refreshToken);
+                    callback(resp.toResponse());
+                });
+        });
 }
 
 // ---------------------- Get Profile ----------------------
@@ -242,27 +314,33 @@ void AuthController::getProfile(const HttpRequestPtr &req, std::function<void(co
     try {
         username = req->attributes()->get<std::string>("username");
     } catch (...) {
-        callback(errorResponse("Username attribute missing", k401Unauthorized));
+        callback(errorResponse(CannedResponse::UsernameMissing));
         return;
     }
 
-    dbClient->execSqlAsync(
-        "SELECT id, username, email, created_at FROM users WHERE username=$1",
-        [callback](const drogon::orm::Result &r) {
-            if (r.empty()) {
-                callback(errorResponse("User not found", k404NotFound));
-                return;
-            }
-            Json::Value respJson;
-            respJson["id"] = r[0]["id"].as<int>();
-            respJson["username"] = r[0]["username"].as<std::string>();
-            respJson["email"] = r[0]["email"].as<std::string>();
-            respJson["created_at"] = r[0]["created_at"].as<std::string>();
-            callback(HttpResponse::newHttpJsonResponse(respJson));
-        },
-        [callback](const drogon::orm::DrogonDbException &e) {
-            callback(errorResponse("Database error", k500InternalServerError));
-        },
-        username
-    );
+    auto onResult = [callback](const drogon::orm::Result &r) {
+        if (r.empty()) {
+            callback(errorResponse(CannedResponse::ProfileNotFound));
+            return;
+        }
+        JsonWriter respJson;
+        respJson.field("id", r[0]["id"].as<int>())
+            .field("username", r[0]["username"].as<std::string>())
+            .field("email", r[0]["email"].as<std::string>())
+            .field("created_at", r[0]["created_at"].as<std::string>());
+        callback(respJson.toResponse());
+    };
+    auto onError = [callback](const drogon::orm::DrogonDbException &e) {
+        callback(errorResponse(CannedResponse::DatabaseError));
+    };
+
+    // Identical concurrent reads (app launch bursts) share one query
+    if (!flights_) {
+        shards_->readForUser(username, kProfileSql, std::move(onResult), std::move(onError), username);
+        return;
+    }
+    flights_->run(SingleFlight::key(kProfileSql, {username}), std::move(onResult), std::move(onError),
+        [&](drogon::orm::ResultCallback rcb, drogon::orm::ExceptionCallback ecb) {
+            shards_->readForUser(username, kProfileSql, std::move(rcb), std::move(ecb), username);
+        });
 }
@@ -2,204 +2,651 @@
 #include <drogon/HttpResponse.h>
 #include <drogon/HttpRequest.h>
 #include <spdlog/spdlog.h>
-#include <random>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory_resource>
+#include <utility>
 #include "jwt_utils.h"  // your JWT helper functions
+#include "IdAllocator.h"
+#include "JsonWriter.h"
+#include "RequestScope.h"
+#include "ResponseCache.h"
+#include "RuntimeConfig.h"
+#include "TransferBatch.h"
+#include "TransferSaga.h"
 
 using namespace drogon;
 
-std::string generateAccountNumber() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(10000000, 99999999);
-    return "ACCT" + std::to_string(dis(gen));
+namespace {
+    // Positive and, when MAX_AMOUNT is configured, within the cap
+    bool validAmount(double amount) {
+        double cap = RuntimeConfig::current().maxAmount;
+        return amount > 0 && (cap <= 0 || amount <= cap);
+    }
+
+    // Callbacks capture only the scope, so they fit std::function's inline buffer.
+    // Transaction statements also capture `trans` and `finish` themselves: the
+    // commit callback holds the scope, so a TransactionPtr kept in the scope
+    // would never be released and the transaction would never commit.
+    struct AccountScope : RequestScope {
+        std::pmr::string account;
+        double amount = 0;
+        SingleFlight *flights = nullptr;
+        AuditJournal *audit = nullptr;
+
+        AccountScope(Callback &&cb, std::string_view acct, double amt)
+            : RequestScope(std::move(cb)), account(acct, arena()), amount(amt) {}
+    };
+
+    struct TransferScope : RequestScope {
+        std::pmr::string from;
+        std::pmr::string to;
+        double amount = 0;
+        bool insufficient = false;
+        bool missingTarget = false;
+        SingleFlight *flights = nullptr;
+        AuditJournal *audit = nullptr;
+        std::string error;
+
+        TransferScope(Callback &&cb, std::string_view f, std::string_view t, double amt)
+            : RequestScope(std::move(cb)), from(f, arena()), to(t, arena()), amount(amt) {}
+    };
+
+    struct BatchScope : RequestScope {
+        std::pmr::string from;
+        TransferBatch batch;
+        bool missingSource = false;
+        bool insufficient = false;
+        SingleFlight *flights = nullptr;
+        AuditJournal *audit = nullptr;
+        std::string error;
+        bool forUpdate = false;             // lock rows explicitly (Postgres)
+        std::vector<TransferBatch::Chunk> chunks; // statement being worked through
+        std::vector<std::string> existing;  // accounts the lock statements found
+        std::atomic<size_t> outstanding{0}; // engine replies or audit records still to come
+        std::atomic<bool> auditFailed{false};
+
+        BatchScope(Callback &&cb, std::string_view f) : RequestScope(std::move(cb)), from(f, arena()) {}
+    };
+
+    // Maps a BalanceEngine result onto the same responses as the SQL path.
+    HttpResponsePtr engineResponse(BalanceEngine::Status status, const char *field, double balance,
+                                   CannedResponse notFound) {
+        switch (status) {
+        case BalanceEngine::Status::Ok: {
+            JsonWriter j;
+            if (field)
+                j.field(field, balance);
+            else
+                j.field("status", "success");
+            return j.toResponse();
+        }
+        case BalanceEngine::Status::NotFound:
+            return ResponseCache::get(notFound);
+        case BalanceEngine::Status::Insufficient:
+            return ResponseCache::get(CannedResponse::InsufficientBalance);
+        case BalanceEngine::Status::Error:
+            break;
+        }
+        return ResponseCache::get(CannedResponse::DatabaseError);
+    }
+
+    // Records a completed movement, then sends `resp`. In AUDIT_STRICT mode
+    // that waits for the journal batch to be fdatasync'd. The movement has
+    // committed by then, so a failed audit write must not turn the answer
+    // into an error a client would retry: it goes out as it is, marked
+    // "X-Audit: pending" (the record itself is in the error log).
+    // The change has committed but its audit record did not make it to disk;
+    // answer as usual, marked, so a client never retries a committed write.
+    // `resp` may be a shared canned response, so the mark goes on a copy.
+    HttpResponsePtr auditPending(const HttpResponsePtr &resp) {
+        auto marked = HttpResponse::newHttpResponse(resp->statusCode(), resp->contentType());
+        marked->setBody(std::string(resp->body()));
+        marked->addHeader("X-Audit", "pending");
+        return marked;
+    }
+
+    template <typename Respond>
+    void audited(AuditJournal *audit, const AuditJournal::Entry &entry, HttpResponsePtr resp, Respond respond) {
+        if (!audit) {
+            respond(resp);
+            return;
+        }
+        audit->record(entry, [resp = std::move(resp), respond = std::move(respond)](bool ok) {
+            respond(ok ? resp : auditPending(resp));
+        });
+    }
+
+    const std::string kBalanceSql = "SELECT balance FROM users WHERE account_number=$1";
+
+    // Called once a balance write has committed, before answering: balance
+    // reads that start after this do not join one that ran before the write.
+    void balanceChanged(SingleFlight *flights, std::string_view account) {
+        if (flights)
+            flights->forget(SingleFlight::key(kBalanceSql, {account}));
+    }
+
+    void internalError(const RequestScope &scope, const char *what) {
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setStatusCode(k500InternalServerError);
+        resp->setBody(std::string("Internal error: ") + what);
+        scope.respond(resp);
+    }
+
+    template <typename Scope>
+    void abortTransfer(Scope &s, const std::function<void(bool)> &finish, const drogon::orm::DrogonDbException &e) {
+        s.error = e.base().what();
+        finish(false);
+    }
+
+    // {"status":"success"|"partial"|"failed","applied":n,"total":x,"results":[...]}
+    HttpResponsePtr batchResponse(const TransferBatch &batch) {
+        std::string results = batch.resultsJson();
+        size_t applied = batch.count(TransferBatch::Status::Ok);
+        double total = 0;
+        for (const auto &item : batch.items)
+            if (item.status == TransferBatch::Status::Ok) total += item.amount;
+        JsonWriter j;
+        j.field("status", applied == batch.items.size() ? "success" : applied ? "partial" : "failed")
+            .field("applied", static_cast<int64_t>(applied))
+            .field("total", total)
+            .rawField("results", results);
+        return j.toResponse();
+    }
+
+    // Applied items are forgotten by the balance cache and audited one
+    // record each; the answer goes out once every record is accepted.
+    void finishBatch(const std::shared_ptr<BatchScope> &s) {
+        using Status = TransferBatch::Status;
+        size_t applied = s->batch.count(Status::Ok);
+        if (applied) balanceChanged(s->flights, s->from);
+        for (const auto &item : s->batch.items)
+            if (item.status == Status::Ok) balanceChanged(s->flights, item.to);
+        auto resp = batchResponse(s->batch);
+        spdlog::info("Batch from {}: {} of {} transfers applied", s->from.c_str(), applied, s->batch.items.size());
+        if (!s->audit || applied == 0) {
+            s->respond(resp);
+            return;
+        }
+        s->outstanding = applied;
+        for (const auto &item : s->batch.items) {
+            if (item.status != Status::Ok) continue;
+            s->audit->record({"transfer", s->from, item.to, item.amount}, [s, resp](bool ok) {
+                if (!ok) s->auditFailed = true;
+                if (--s->outstanding == 0)
+                    s->respond(s->auditFailed ? auditPending(resp) : resp);
+            });
+        }
+    }
+
+    using Finish = std::function<void(bool)>;
+
+    // Binds one TransferBatch chunk: lockSql() takes the accounts,
+    // creditSql() account/amount pairs.
+    template <size_t... I>
+    void execLockChunk(const TransactionPtr &trans, const std::string &sql, const TransferBatch::Chunk &c,
+                       drogon::orm::ResultCallback rcb, drogon::orm::ExceptionCallback ecb,
+                       std::index_sequence<I...>) {
+        DbRouter::exec(trans, sql, std::move(rcb), std::move(ecb), c.accounts[I]...);
+    }
+
+    template <size_t... I>
+    void execCreditChunk(const TransactionPtr &trans, const TransferBatch::Chunk &c,
+                         drogon::orm::ResultCallback rcb, drogon::orm::ExceptionCallback ecb,
+                         std::index_sequence<I...>) {
+        DbRouter::exec(trans, TransferBatch::creditSql(), std::move(rcb), std::move(ecb),
+                       TransferBatch::creditArg<I>(c)...);
+    }
+
+    void creditBatch(const std::shared_ptr<BatchScope> &s, const TransactionPtr &trans, const Finish &finish, size_t i) {
+        if (i == s->chunks.size()) {
+            finish(true);
+            return;
+        }
+        execCreditChunk(trans, s->chunks[i],
+            [s, trans, finish, i](const drogon::orm::Result &r) {
+                if (r.size() != s->chunks[i].size) {
+                    s->error = "credit matched fewer rows than were locked";
+                    finish(false);
+                    return;
+                }
+                creditBatch(s, trans, finish, i + 1);
+            },
+            [s, finish](const drogon::orm::DrogonDbException &e) { abortTransfer(*s, finish, e); },
+            std::make_index_sequence<2 * TransferBatch::kChunk>{});
+    }
+
+    // Once every row is locked: drop missing targets, debit the total, credit.
+    void debitBatch(const std::shared_ptr<BatchScope> &s, const TransactionPtr &trans, const Finish &finish) {
+        using Status = TransferBatch::Status;
+        if (std::find(s->existing.begin(), s->existing.end(), std::string_view(s->from)) == s->existing.end()) {
+            s->missingSource = true;
+            finish(false);
+            return;
+        }
+        s->batch.markMissing(s->existing);
+        if (s->batch.count(Status::Pending) == 0) {
+            finish(false);
+            return;
+        }
+        // One balance check for the whole batch
+        DbRouter::exec(trans,
+            "UPDATE users SET balance = balance - $1 WHERE account_number=$2 AND balance >= $1 RETURNING balance",
+            [s, trans, finish](const drogon::orm::Result &r) {
+                if (r.empty()) {
+                    s->insufficient = true;
+                    finish(false);
+                    return;
+                }
+                s->chunks = s->batch.creditChunks();
+                creditBatch(s, trans, finish, 0);
+            },
+            [s, finish](const drogon::orm::DrogonDbException &e) { abortTransfer(*s, finish, e); },
+            s->batch.pendingTotal(), s->from.c_str());
+    }
+
+    void lockBatch(const std::shared_ptr<BatchScope> &s, const TransactionPtr &trans, const Finish &finish, size_t i) {
+        if (i == s->chunks.size()) {
+            debitBatch(s, trans, finish);
+            return;
+        }
+        execLockChunk(trans, TransferBatch::lockSql(s->forUpdate), s->chunks[i],
+            [s, trans, finish, i](const drogon::orm::Result &r) {
+                for (const auto &row : r)
+                    s->existing.push_back(row["account_number"].as<std::string>());
+                lockBatch(s, trans, finish, i + 1);
+            },
+            [s, finish](const drogon::orm::DrogonDbException &e) { abortTransfer(*s, finish, e); },
+            std::make_index_sequence<TransferBatch::kChunk>{});
+    }
+
+    // "Bearer <token>" -> the token's account number, or false. Tokens from
+    // before the "acct" claim have none and are refused until a new login.
+    bool authenticate(const HttpRequestPtr &req, std::string &account) {
+        const auto &authHeader = req->getHeader("Authorization");
+        std::string username;
+        return authHeader.size() > 7 && verifyJWT(authHeader.substr(7), username, &account) && !account.empty();
+    }
 }
 
 void BankController::getBalance(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
-    auto authHeader = req->getHeader("Authorization");
-    std::string token = authHeader.substr(7); // "Bearer <token>"
     std::string account;
-    if (!verifyJWT(token, jwtSecret_, account)) {
-        {
-            auto resp = HttpResponse::newHttpResponse();
-            resp->setStatusCode(k401Unauthorized);
-            resp->setBody("Unauthorized");
-            callback(resp);
-        }
+    if (!authenticate(req, account)) {
+        callback(ResponseCache::get(CannedResponse::Unauthorized));
         return;
     }
+    auto s = RequestScope::make<AccountScope>(std::move(callback), account, 0.0);
 
-    dbClient_->execSqlAsync(
-        "SELECT balance FROM users WHERE account_number=$1",
-        [callback, account](const drogon::orm::Result &r) {
-            if (r.empty()) {
-                auto resp = HttpResponse::newHttpResponse();
-                resp->setStatusCode(k404NotFound);
-                resp->setBody("Account not found");
-                callback(resp);
-                spdlog::warn("Balance check failed for {}", account);
-                return;
-            }
-            double balance = r[0]["balance"].as<double>();
-            Json::Value j;
-            j["balance"] = balance;
-            callback(HttpResponse::newHttpJsonResponse(j));
-            spdlog::info("Balance retrieved for {}", account);
-            },
-        [callback, account](const drogon::orm::DrogonDbException &e) {
-            auto resp = HttpResponse::newHttpResponse();
-            resp->setStatusCode(k500InternalServerError);
-            resp->setBody(std::string("Internal error: ") + e.base().what());
-            callback(resp);
-            spdlog::error("Balance query failed for {}: {}", account, e.base().what());
-        },
-        account
-    );
+    if (engine_) {
+        engine_->balance(account, [s](BalanceEngine::Status status, double balance) {
+            s->respond(engineResponse(status, "balance", balance, CannedResponse::AccountNotFound));
+        });
+        return;
+    }
+
+    auto onResult = [s](const drogon::orm::Result &r) {
+        if (r.empty()) {
+            s->respond(ResponseCache::get(CannedResponse::AccountNotFound));
+            spdlog::warn("Balance check failed for {}", s->account.c_str());
+            return;
+        }
+        double balance = r[0]["balance"].as<double>();
+        JsonWriter j;
+        j.field("balance", balance);
+        s->respond(j.toResponse());
+        spdlog::info("Balance retrieved for {}", s->account.c_str());
+    };
+    auto onError = [s](const drogon::orm::DrogonDbException &e) {
+        internalError(*s, e.base().what());
+        spdlog::error("Balance query failed for {}: {}", s->account.c_str(), e.base().what());
+    };
+
+    const auto &shard = shards_->forAccount(account);
+    if (!flights_) {
+        shard->read(kBalanceSql, std::move(onResult), std::move(onError), s->account.c_str());
+        return;
+    }
+    // Identical concurrent reads (app launch bursts) share one query
+    flights_->run(SingleFlight::key(kBalanceSql, {account}), std::move(onResult), std::move(onError),
+        [&](drogon::orm::ResultCallback rcb, drogon::orm::ExceptionCallback ecb) {
+            shard->read(kBalanceSql, std::move(rcb), std::move(ecb), s->account.c_str());
+        });
 }
 
 void BankController::deposit(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
-    auto authHeader = req->getHeader("Authorization");
-    std::string token = authHeader.substr(7);
     std::string account;
-    if (!verifyJWT(token, jwtSecret_, account)) {
-        {
-            auto resp = HttpResponse::newHttpResponse();
-            resp->setStatusCode(k401Unauthorized);
-            resp->setBody("Unauthorized");
-            callback(resp);
-        }
+    if (!authenticate(req, account)) {
+        callback(ResponseCache::get(CannedResponse::Unauthorized));
         return;
     }
 
     auto json = req->getJsonObject();
     double amount = (*json)["amount"].asDouble();
 
-    if (amount <= 0) {
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k400BadRequest);
-        resp->setBody("Invalid amount");
-        callback(resp);
+    if (!validAmount(amount)) {
+        callback(ResponseCache::get(CannedResponse::InvalidAmount));
+        return;
+    }
+    auto s = RequestScope::make<AccountScope>(std::move(callback), account, amount);
+    s->flights = flights_.get();
+    s->audit = audit_.get();
+
+    if (engine_) {
+        engine_->deposit(account, amount, [s](BalanceEngine::Status status, double balance) {
+            auto resp = engineResponse(status, "new_balance", balance, CannedResponse::AccountNotFound);
+            if (status != BalanceEngine::Status::Ok) {
+                s->respond(resp);
+                return;
+            }
+            audited(s->audit, {"deposit", s->account, {}, s->amount, balance}, std::move(resp),
+                    [s](const HttpResponsePtr &r) { s->respond(r); });
+        });
         return;
     }
 
-    dbClient_->execSqlAsync(
+    shards_->forAccount(account)->write(
         "UPDATE users SET balance = balance + $1 WHERE account_number=$2 RETURNING balance",
-        [callback, account, amount](const drogon::orm::Result &r) {
+        [s](const drogon::orm::Result &r) {
+            balanceChanged(s->flights, s->account);
             if (r.empty()) {
-                auto resp = HttpResponse::newHttpResponse();
-                resp->setStatusCode(k404NotFound);
-                resp->setBody("Account not found");
-                callback(resp);
-                spdlog::warn("Deposit failed for {}", account);
+                s->respond(ResponseCache::get(CannedResponse::AccountNotFound));
+                spdlog::warn("Deposit failed for {}", s->account.c_str());
                 return;
             }
             double newBalance = r[0]["balance"].as<double>();
-            Json::Value j;
-            j["new_balance"] = newBalance;
-            callback(HttpResponse::newHttpJsonResponse(j));
-            spdlog::info("Deposited {} to {}, new balance {}", amount, account, newBalance);
+            JsonWriter j;
+            j.field("new_balance", newBalance);
+            audited(s->audit, {"deposit", s->account, {}, s->amount, newBalance}, j.toResponse(),
+                    [s](const HttpResponsePtr &resp) { s->respond(resp); });
+            spdlog::info("Deposited {} to {}, new balance {}", s->amount, s->account.c_str(), newBalance);
         },
-        [callback, account](const drogon::orm::DrogonDbException &e) {
-            auto resp = HttpResponse::newHttpResponse();
-            resp->setStatusCode(k500InternalServerError);
-            resp->setBody(std::string("Internal error: ") + e.base().what());
-            callback(resp);
-            spdlog::error("Deposit failed for {}: {}", account, e.base().what());
+        [s](const drogon::orm::DrogonDbException &e) {
+            internalError(*s, e.base().what());
+            spdlog::error("Deposit failed for {}: {}", s->account.c_str(), e.base().what());
         },
-        amount, account
+        amount, s->account.c_str()
     );
 }
 
 void BankController::withdraw(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
-    auto authHeader = req->getHeader("Authorization");
-    std::string token = authHeader.substr(7);
     std::string account;
-    if (!verifyJWT(token, jwtSecret_, account)) {
-        {
-            auto resp = HttpResponse::newHttpResponse();
-            resp->setStatusCode(k401Unauthorized);
-            resp->setBody("Unauthorized");
-            callback(resp);
-        }
+    if (!authenticate(req, account)) {
+        callback(ResponseCache::get(CannedResponse::Unauthorized));
         return;
     }
 
     auto json = req->getJsonObject();
     double amount = (*json)["amount"].asDouble();
 
-    dbClient_->execSqlAsync(
+    // A negative withdrawal would be a deposit that skips every deposit check
+    if (!validAmount(amount)) {
+        callback(ResponseCache::get(CannedResponse::InvalidAmount));
+        return;
+    }
+    auto s = RequestScope::make<AccountScope>(std::move(callback), account, amount);
+    s->flights = flights_.get();
+    s->audit = audit_.get();
+
+    if (engine_) {
+        engine_->withdraw(account, amount, [s](BalanceEngine::Status status, double balance) {
+            auto resp = engineResponse(status, "new_balance", balance, CannedResponse::InsufficientBalance);
+            if (status != BalanceEngine::Status::Ok) {
+                s->respond(resp);
+                return;
+            }
+            audited(s->audit, {"withdraw", s->account, {}, s->amount, balance}, std::move(resp),
+                    [s](const HttpResponsePtr &r) { s->respond(r); });
+        });
+        return;
+    }
+
+    shards_->forAccount(account)->write(
         "UPDATE users SET balance = balance - $1 WHERE account_number=$2 AND balance >= $1 RETURNING balance",
-        [callback, account, amount](const drogon::orm::Result &r) {
+        [s](const drogon::orm::Result &r) {
+            balanceChanged(s->flights, s->account);
             if (r.empty()) {
-                auto resp = HttpResponse::newHttpResponse();
-                resp->setStatusCode(k400BadRequest);
-                resp->setBody("Insufficient balance");
-                callback(resp);
-                spdlog::warn("Withdraw failed for {}: insufficient balance", account);
+                s->respond(ResponseCache::get(CannedResponse::InsufficientBalance));
+                spdlog::warn("Withdraw failed for {}: insufficient balance", s->account.c_str());
                 return;
             }
             double newBalance = r[0]["balance"].as<double>();
-            Json::Value j;
-            j["new_balance"] = newBalance;
-            callback(HttpResponse::newHttpJsonResponse(j));
-            spdlog::info("Withdrew {} from {}, new balance {}", amount, account, newBalance);
+            JsonWriter j;
+            j.field("new_balance", newBalance);
+            audited(s->audit, {"withdraw", s->account, {}, s->amount, newBalance}, j.toResponse(),
+                    [s](const HttpResponsePtr &resp) { s->respond(resp); });
+            spdlog::info("Withdrew {} from {}, new balance {}", s->amount, s->account.c_str(), newBalance);
         },
-        [callback, account](const drogon::orm::DrogonDbException &e) {
-            auto resp = HttpResponse::newHttpResponse();
-            resp->setStatusCode(k500InternalServerError);
-            resp->setBody(std::string("Internal error: ") + e.base().what());
-            callback(resp);
-            spdlog::error("Withdraw failed for {}: {}", account, e.base().what());
+        [s](const drogon::orm::DrogonDbException &e) {
+            internalError(*s, e.base().what());
+            spdlog::error("Withdraw failed for {}: {}", s->account.c_str(), e.base().what());
         },
-        amount, account
+        amount, s->account.c_str()
     );
 }
 
 void BankController::transfer(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
-    auto authHeader = req->getHeader("Authorization");
-    std::string token = authHeader.substr(7);
     std::string fromAccount;
-    if (!verifyJWT(token, jwtSecret_, fromAccount)) {
-        {
-            auto resp = HttpResponse::newHttpResponse();
-            resp->setStatusCode(k401Unauthorized);
-            resp->setBody("Unauthorized");
-            callback(resp);
-        }
+    if (!authenticate(req, fromAccount)) {
+        callback(ResponseCache::get(CannedResponse::Unauthorized));
         return;
     }
 
     auto json = req->getJsonObject();
-    std::string toAccount = (*json)["to_account"].asString();
+    const auto &toValue = (*json)["to_account"];
+    std::string_view toAccount;
+    if (toValue.isString()) {
+        const char *begin = nullptr, *end = nullptr;
+        toValue.getString(&begin, &end);
+        toAccount = std::string_view(begin, static_cast<size_t>(end - begin));
+    }
     double amount = (*json)["amount"].asDouble();
 
-    if (amount <= 0) {
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k400BadRequest);
-        resp->setBody("Invalid amount");
-        callback(resp);
+    if (!AccountNumber::valid(toAccount)) {
+        callback(ResponseCache::get(CannedResponse::InvalidAccountNumber));
+        return;
+    }
+    if (!validAmount(amount)) {
+        callback(ResponseCache::get(CannedResponse::InvalidAmount));
+        return;
+    }
+    auto s = RequestScope::make<TransferScope>(std::move(callback), fromAccount, toAccount, amount);
+    s->flights = flights_.get();
+    s->audit = audit_.get();
+
+    if (engine_) {
+        engine_->transfer(fromAccount, std::string(toAccount), amount, [s](BalanceEngine::Status status, double) {
+            auto resp = engineResponse(status, nullptr, 0, CannedResponse::AccountNotFound);
+            if (status != BalanceEngine::Status::Ok) {
+                s->respond(resp);
+                return;
+            }
+            audited(s->audit, {"transfer", s->from, s->to, s->amount}, std::move(resp),
+                    [s](const HttpResponsePtr &r) { s->respond(r); });
+        });
         return;
     }
 
-    dbClient_->execSqlAsync(
-        "BEGIN;"
-        "UPDATE users SET balance = balance - $1 WHERE account_number=$2 AND balance >= $1;"
-        "UPDATE users SET balance = balance + $1 WHERE account_number=$3;"
-        "COMMIT;",
-        [callback, fromAccount, toAccount, amount](const drogon::orm::Result &r) {
-            Json::Value j;
-            j["status"] = "success";
-            callback(HttpResponse::newHttpJsonResponse(j));
-            spdlog::info("Transferred {} from {} to {}", amount, fromAccount, toAccount);
+    if (shards_->shardOf(fromAccount) != shards_->shardOf(toAccount)) {
+        transferAcrossShards(fromAccount, std::string(toAccount), amount,
+                             [s](const HttpResponsePtr &resp) { s->respond(resp); });
+        return;
+    }
+
+    // Two statements in one transaction; a multi-statement string cannot run
+    // inside the writer's group commit, and the debit has to be checked anyway.
+    shards_->forAccount(fromAccount)->transaction(
+        [s](const TransactionPtr &trans, std::function<void(bool)> finish) {
+            DbRouter::exec(trans,
+                "UPDATE users SET balance = balance - $1 WHERE account_number=$2 AND balance >= $1 RETURNING balance",
+                [s, trans, finish](const drogon::orm::Result &r) {
+                    if (r.empty()) {
+                        s->insufficient = true;
+                        finish(false);
+                        return;
+                    }
+                    DbRouter::exec(trans,
+                        "UPDATE users SET balance = balance + $1 WHERE account_number=$2 RETURNING balance",
+                        [s, finish](const drogon::orm::Result &r2) {
+                            s->missingTarget = r2.empty();
+                            finish(!r2.empty());
+                        },
+                        [s, finish](const drogon::orm::DrogonDbException &e) { abortTransfer(*s, finish, e); },
+                        s->amount, s->to.c_str());
+                },
+                [s, finish](const drogon::orm::DrogonDbException &e) { abortTransfer(*s, finish, e); },
+                s->amount, s->from.c_str());
         },
-        [callback, fromAccount](const drogon::orm::DrogonDbException &e) {
-            auto resp = HttpResponse::newHttpResponse();
-            resp->setStatusCode(k500InternalServerError);
-            resp->setBody(std::string("Internal error: ") + e.base().what());
-            callback(resp);
-            spdlog::error("Transfer failed for {}: {}", fromAccount, e.base().what());
+        [s](bool committed) {
+            if (committed) {
+                balanceChanged(s->flights, s->from);
+                balanceChanged(s->flights, s->to);
+                JsonWriter j;
+                j.field("status", "success");
+                audited(s->audit, {"transfer", s->from, s->to, s->amount}, j.toResponse(),
+                        [s](const HttpResponsePtr &resp) { s->respond(resp); });
+                spdlog::info("Transferred {} from {} to {}", s->amount, s->from.c_str(), s->to.c_str());
+            } else if (s->insufficient) {
+                s->respond(ResponseCache::get(CannedResponse::InsufficientBalance));
+                spdlog::warn("Transfer failed for {}: insufficient balance", s->from.c_str());
+            } else if (s->missingTarget) {
+                s->respond(ResponseCache::get(CannedResponse::AccountNotFound));
+                spdlog::warn("Transfer failed for {}: target {} not found", s->from.c_str(), s->to.c_str());
+            } else {
+                internalError(*s, s->error.empty() ? "transaction not committed" : s->error.c_str());
+                spdlog::error("Transfer failed for {}: {}", s->from.c_str(), s->error);
+            }
+        });
+}
+
+void BankController::transferAcrossShards(const std::string &fromAccount, const std::string &toAccount, double amount,
+                                          std::function<void(const HttpResponsePtr &)> &&callback) {
+    TransferSaga::start(shards_, fromAccount, toAccount, amount,
+        [callback = std::move(callback), flights = flights_.get(), audit = audit_.get(), fromAccount, toAccount,
+         amount](TransferSaga::Result result, const std::string &id) {
+            balanceChanged(flights, fromAccount);
+            balanceChanged(flights, toAccount);
+            switch (result) {
+            case TransferSaga::Result::Completed: {
+                JsonWriter j;
+                j.field("status", "success");
+                audited(audit, {"transfer", fromAccount, toAccount, amount, NAN, id}, j.toResponse(), callback);
+                spdlog::info("Transferred {} from {} to {} across shards ({})", amount, fromAccount, toAccount, id);
+                break;
+            }
+            case TransferSaga::Result::Pending: {
+                // Debited and durably logged; recovery completes or refunds it
+                JsonWriter j;
+                j.field("status", "pending").field("transfer_id", id);
+                audited(audit, {"transfer", fromAccount, toAccount, amount, NAN, id, "pending"},
+                        j.toResponse(k202Accepted), callback);
+                spdlog::warn("Transfer {} from {} to {} left pending", id, fromAccount, toAccount);
+                break;
+            }
+            case TransferSaga::Result::Refunded:
+                audited(audit, {"transfer", fromAccount, toAccount, amount, NAN, id, "refunded"},
+                        ResponseCache::get(CannedResponse::AccountNotFound), callback);
+                spdlog::warn("Transfer failed for {}: target {} not found, refunded ({})", fromAccount, toAccount, id);
+                break;
+            case TransferSaga::Result::Insufficient:
+                callback(ResponseCache::get(CannedResponse::InsufficientBalance));
+                spdlog::warn("Transfer failed for {}: insufficient balance", fromAccount);
+                break;
+            case TransferSaga::Result::Failed:
+                callback(ResponseCache::get(CannedResponse::DatabaseError));
+                spdlog::error("Transfer failed for {}: debit not committed", fromAccount);
+                break;
+            }
+        });
+}
+
+
+void BankController::transferBatch(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+    using Status = TransferBatch::Status;
+    std::string fromAccount;
+    if (!authenticate(req, fromAccount)) {
+        callback(ResponseCache::get(CannedResponse::Unauthorized));
+        return;
+    }
+
+    // Either a bare array or {"transfers": [...]}
+    auto json = req->getJsonObject();
+    if (!json) {
+        callback(ResponseCache::get(CannedResponse::InvalidJson));
+        return;
+    }
+    const Json::Value &list = json->isArray() ? *json : (*json)["transfers"];
+    if (list.isArray() && list.size() > RuntimeConfig::current().maxBatchItems) {
+        callback(ResponseCache::get(CannedResponse::BatchTooLarge));
+        return;
+    }
+    auto s = RequestScope::make<BatchScope>(std::move(callback), fromAccount);
+    if (!TransferBatch::parse(list, s->batch.items)) {
+        s->respond(ResponseCache::get(CannedResponse::InvalidJson));
+        return;
+    }
+    s->flights = flights_.get();
+    s->audit = audit_.get();
+    size_t sourceShard = shards_->shardOf(fromAccount);
+    for (auto &item : s->batch.items) {
+        if (item.status != Status::Pending) continue;
+        if (!validAmount(item.amount))
+            item.status = Status::InvalidAmount;
+        else if (shards_->shardOf(item.to) != sourceShard)
+            item.status = Status::OtherShard;
+    }
+    if (s->batch.count(Status::Pending) == 0) {
+        s->respond(batchResponse(s->batch));
+        return;
+    }
+
+    // The engine checks each transfer on its own; items go in back to back
+    if (engine_) {
+        s->outstanding = s->batch.count(Status::Pending);
+        for (auto &item : s->batch.items) {
+            if (item.status != Status::Pending) continue;
+            engine_->transfer(fromAccount, item.to, item.amount, [s, &item](BalanceEngine::Status status, double) {
+                switch (status) {
+                case BalanceEngine::Status::Ok: item.status = Status::Ok; break;
+                case BalanceEngine::Status::NotFound: item.status = Status::AccountNotFound; break;
+                case BalanceEngine::Status::Insufficient: item.status = Status::Insufficient; break;
+                case BalanceEngine::Status::Error: item.status = Status::Failed; break;
+                }
+                if (--s->outstanding == 0) finishBatch(s);
+            });
+        }
+        return;
+    }
+
+    const auto &shard = shards_->shard(sourceShard);
+    s->forUpdate = shard->writer()->type() != drogon::orm::ClientType::Sqlite3;
+    shard->transaction(
+        [s](const TransactionPtr &trans, std::function<void(bool)> finish) {
+            // The writer batcher may run this again; start from the parsed items
+            for (auto &item : s->batch.items)
+                if (item.status == Status::AccountNotFound) item.status = Status::Pending;
+            s->existing.clear();
+            s->chunks = s->batch.lockChunks(s->from);
+            lockBatch(s, trans, finish, 0);
         },
-        amount, fromAccount, toAccount
-    );
+        [s](bool committed) {
+            if (committed) {
+                s->batch.settle(Status::Ok);
+                finishBatch(s);
+            } else if (s->missingSource) {
+                s->respond(ResponseCache::get(CannedResponse::AccountNotFound));
+            } else if (s->insufficient) {
+                spdlog::warn("Batch from {} rejected: insufficient balance for {}", s->from.c_str(),
+                             s->batch.pendingTotal());
+                s->batch.settle(Status::Insufficient);
+                s->respond(batchResponse(s->batch));
+            } else if (s->error.empty()) {
+                s->respond(batchResponse(s->batch)); // nothing left to apply
+            } else {
+                internalError(*s, s->error.c_str());
+                spdlog::error("Batch from {} failed: {}", s->from.c_str(), s->error);
+            }
+        });
 }
 
 
@@ -0,0 +1,162 @@
+#include "DebugController.h"
+#include "AllocStats.h"
+#include "CpuProfiler.h"
+#include "JsonWriter.h"
+#include "LoopLagMonitor.h"
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+
+void DebugController::allocations(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+    if (!AllocStats::kEnabled) {
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setStatusCode(k404NotFound);
+        resp->setBody("Allocation counting is not built in (configure with -DCPPAUTH_ALLOC_STATS=ON)");
+        callback(resp);
+        return;
+    }
+    auto t = AllocStats::totals();
+    double perRequest = t.requests ? static_cast<double>(t.allocations) / t.requests : 0.0;
+    double bytesPerRequest = t.requests ? static_cast<double>(t.bytes) / t.requests : 0.0;
+    JsonWriter j;
+    j.field("allocations", static_cast<int64_t>(t.allocations))
+        .field("bytes", static_cast<int64_t>(t.bytes))
+        .field("requests", static_cast<int64_t>(t.requests))
+        .field("allocations_per_request", perRequest)
+        .field("bytes_per_request", bytesPerRequest);
+    callback(j.toResponse());
+}
+
+void DebugController::sql(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+    if (!sqlStats_) {
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setStatusCode(k404NotFound);
+        resp->setBody("SQL stats are disabled");
+        callback(resp);
+        return;
+    }
+
+    using Row = SqlStats::Row;
+    std::string sort = req->getParameter("sort");
+    double (*key)(const Row &) = [](const Row &r) { return static_cast<double>(r.totalNs); };
+    if (sort == "count") key = [](const Row &r) { return static_cast<double>(r.count); };
+    else if (sort == "mean") key = [](const Row &r) { return r.meanMs(); };
+    else if (sort == "max") key = [](const Row &r) { return static_cast<double>(r.maxNs); };
+    else if (sort == "rows") key = [](const Row &r) { return static_cast<double>(r.rows); };
+    else if (sort == "errors") key = [](const Row &r) { return static_cast<double>(r.errors); };
+    else sort = "total";
+
+    long limit = 20;
+    if (auto l = req->getParameter("limit"); !l.empty()) limit = std::max(1L, std::atol(l.c_str()));
+
+    auto rows = sqlStats_->snapshot();
+    auto top = rows.begin() + std::min<size_t>(rows.size(), static_cast<size_t>(limit));
+    std::partial_sort(rows.begin(), top, rows.end(), [key](const Row &a, const Row &b) { return key(a) > key(b); });
+
+    Json::Value out;
+    out["sort"] = sort;
+    out["fingerprints"] = static_cast<Json::UInt64>(rows.size());
+    Json::Value list(Json::arrayValue);
+    for (auto it = rows.begin(); it != top; ++it) {
+        Json::Value r;
+        r["sql"] = it->fingerprint ? it->fingerprint->text : "(other)";
+        r["count"] = static_cast<Json::UInt64>(it->count);
+        r["total_ms"] = it->totalMs();
+        r["mean_ms"] = it->meanMs();
+        r["max_ms"] = it->maxMs();
+        r["rows"] = static_cast<Json::UInt64>(it->rows);
+        r["errors"] = static_cast<Json::UInt64>(it->errors);
+        list.append(r);
+    }
+    out["top"] = list;
+    callback(HttpResponse::newHttpJsonResponse(out));
+}
+
+void DebugController::profile(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+    double seconds = 30;
+    int hz = 99;
+    if (auto v = req->getParameter("seconds"); !v.empty()) seconds = std::clamp(std::atof(v.c_str()), 1.0, 120.0);
+    if (auto v = req->getParameter("hz"); !v.empty()) hz = std::clamp(std::atoi(v.c_str()), 1, 1000);
+
+    if (!CpuProfiler::tryAcquire()) {
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setStatusCode(k409Conflict);
+        resp->setBody("A profile is already running");
+        callback(resp);
+        return;
+    }
+
+    // The run sleeps for `seconds`; keep that off the IO loop.
+    std::thread([seconds, hz, callback = std::move(callback)] {
+        std::string folded = CpuProfiler::profile(seconds, hz);
+        CpuProfiler::release();
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setContentTypeCode(CT_TEXT_PLAIN);
+        resp->setBody(std::move(folded));
+        callback(resp);
+    }).detach();
+}
+
+void DebugController::loops(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+    Json::Value list(Json::arrayValue);
+    for (const auto &l : LoopLagMonitor::instance().snapshot()) {
+        Json::Value r;
+        r["loop"] = static_cast<Json::UInt64>(l.loop);
+        r["ticks"] = static_cast<Json::UInt64>(l.ticks);
+        r["lag_p50_us"] = static_cast<Json::UInt64>(l.p50Us);
+        r["lag_p99_us"] = static_cast<Json::UInt64>(l.p99Us);
+        r["lag_max_us"] = static_cast<Json::UInt64>(l.maxUs);
+        r["stalls"] = static_cast<Json::UInt64>(l.stalls);
+        list.append(r);
+    }
+    Json::Value out;
+    out["loops"] = list;
+    callback(HttpResponse::newHttpJsonResponse(out));
+}
+
+void DebugController::admission(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+    Json::Value out;
+    out["enabled"] = admission_ != nullptr;
+    if (admission_) {
+        auto group = [this](AdmissionControl::Group g) {
+            Json::Value v;
+            v["limit"] = admission_->limit(g).limit();
+            v["inflight"] = static_cast<Json::Int64>(admission_->limit(g).inflight());
+            v["shed"] = static_cast<Json::UInt64>(admission_->shed(g));
+            return v;
+        };
+        out["auth"] = group(AdmissionControl::Group::Auth);
+        out["bank"] = group(AdmissionControl::Group::Bank);
+    }
+    callback(HttpResponse::newHttpJsonResponse(out));
+}
+
+void DebugController::singleflight(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+    Json::Value out;
+    out["enabled"] = flights_ != nullptr;
+    if (flights_) {
+        auto s = flights_->stats();
+        out["queries"] = static_cast<Json::UInt64>(s.queries);
+        out["joined"] = static_cast<Json::UInt64>(s.joined);
+        out["overflow"] = static_cast<Json::UInt64>(s.overflow);
+    }
+    callback(HttpResponse::newHttpJsonResponse(out));
+}
+
+void DebugController::tls(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+    Json::Value out;
+    out["enabled"] = tls_ != nullptr;
+    if (tls_) {
+        auto s = tls_->stats();
+        uint64_t completed = s.full + s.resumed;
+        out["full"] = static_cast<Json::UInt64>(s.full);
+        out["resumed"] = static_cast<Json::UInt64>(s.resumed);
+        out["failed"] = static_cast<Json::UInt64>(s.failed);
+        out["resumption_ratio"] = completed ? static_cast<double>(s.resumed) / completed : 0.0;
+        out["tickets_issued"] = static_cast<Json::UInt64>(s.ticketsIssued);
+        out["tickets_renewed"] = static_cast<Json::UInt64>(s.ticketsRenewed);
+        out["tickets_unknown"] = static_cast<Json::UInt64>(s.ticketsUnknown);
+        out["cached_sessions"] = static_cast<Json::UInt64>(s.cachedSessions);
+    }
+    callback(HttpResponse::newHttpJsonResponse(out));
+}
@@ -0,0 +1,20 @@
+#include "HealthController.h"
+#include "JsonWriter.h"
+#include "Readiness.h"
+
+void HealthController::liveness(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+    JsonWriter j;
+    j.field("status", "alive")
+        .field("uptime_ms", static_cast<int64_t>(Readiness::instance().uptimeMs()));
+    callback(j.toResponse());
+}
+
+void HealthController::readiness(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+    auto &r = Readiness::instance();
+    bool ready = r.ready();
+    JsonWriter j;
+    j.field("ready", ready).field("stage", r.stage());
+    if (ready)
+        j.field("ready_after_ms", static_cast<int64_t>(r.readyAfterMs()));
+    callback(j.toResponse(ready ? k200OK : k503ServiceUnavailable));
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <drogon/HttpController.h>
+
+using namespace drogon;
+
+class AdminController : public drogon::HttpController<AdminController, false> {
+public:
+    AdminController() = default;
+
+    METHOD_LIST_BEGIN
+    ADD_METHOD_TO(AdminController::reloadConfig, "/admin/reload", Post, "AdminFilter");
+    METHOD_LIST_END
+
+    // Re-reads .env/environment into a new RuntimeConfig snapshot (same as SIGHUP)
+    void reloadConfig(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
+};
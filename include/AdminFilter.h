@@ -0,0 +1,31 @@
+#pragma once
+#include <drogon/HttpFilter.h>
+#include <openssl/crypto.h>
+#include "RuntimeConfig.h"
+
+// Guards /admin/* and /debug/* routes with the ADMIN_TOKEN shared secret,
+// passed as "X-Admin-Token". With no ADMIN_TOKEN configured every admin
+// route answers 403.
+class AdminFilter : public drogon::HttpFilter<AdminFilter>
+{
+public:
+    AdminFilter() = default;
+
+    void doFilter(const drogon::HttpRequestPtr &req,
+                  drogon::FilterCallback &&fcb,
+                  drogon::FilterChainCallback &&fccb) override
+    {
+        const std::string expected = RuntimeConfig::current().adminToken;
+        const std::string &given = req->getHeader("X-Admin-Token");
+        if (expected.empty() || given.size() != expected.size() ||
+            CRYPTO_memcmp(given.data(), expected.data(), expected.size()) != 0)
+        {
+            auto resp = drogon::HttpResponse::newHttpResponse();
+            resp->setStatusCode(drogon::k403Forbidden);
+            resp->setBody("Forbidden");
+            fcb(resp);
+            return;
+        }
+        fccb();
+    }
+};
@@ -0,0 +1,210 @@
+#pragma once
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include "ResponseCache.h"
+
+// Concurrency limit that follows latency, in the style of Netflix's gradient
+// limiters: the best recent response time is the baseline, and every ~100ms
+// window the limit is scaled by tolerance * baseline / recent latency (never
+// below half, never above one) plus a sqrt(limit) allowance for queueing.
+// When latency rises because requests are queueing, the limit shrinks until
+// it stops rising.
+class AdaptiveLimit
+{
+public:
+    struct Options
+    {
+        double initial = 64;
+        double min = 4;
+        double max = 2000;
+        double tolerance = 1.5; // recent/baseline ratio accepted without backing off
+        double smoothing = 0.2;
+    };
+
+    explicit AdaptiveLimit(Options options)
+        : options_(options), limit_(options.initial) {}
+
+    bool tryAcquire()
+    {
+        int64_t cur = inflight_.load(std::memory_order_relaxed);
+        do
+        {
+            if (cur >= static_cast<int64_t>(limit_.load(std::memory_order_relaxed)))
+                return false;
+        } while (!inflight_.compare_exchange_weak(cur, cur + 1, std::memory_order_relaxed));
+        return true;
+    }
+
+    void release(std::chrono::nanoseconds rtt)
+    {
+        int64_t wasInflight = inflight_.fetch_sub(1, std::memory_order_relaxed);
+        sumNs_.fetch_add(static_cast<uint64_t>(rtt.count()), std::memory_order_relaxed);
+        samples_.fetch_add(1, std::memory_order_relaxed);
+        uint64_t maxSeen = peakInflight_.load(std::memory_order_relaxed);
+        while (static_cast<uint64_t>(wasInflight) > maxSeen &&
+               !peakInflight_.compare_exchange_weak(maxSeen, wasInflight, std::memory_order_relaxed))
+        {
+        }
+
+        auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+        if (now - windowStart_.load(std::memory_order_relaxed) >= kWindowNs)
+            closeWindow(now);
+    }
+
+    // A request that was admitted but never completed normally.
+    void abandon() { inflight_.fetch_sub(1, std::memory_order_relaxed); }
+
+    double limit() const { return limit_.load(std::memory_order_relaxed); }
+    int64_t inflight() const { return inflight_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int64_t kWindowNs = 100 * 1000 * 1000;
+    static constexpr uint64_t kMinSamples = 10;
+
+    void closeWindow(int64_t now)
+    {
+        std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+        if (!lock.owns_lock() || samples_.load(std::memory_order_relaxed) < kMinSamples)
+            return;
+        uint64_t n = samples_.exchange(0, std::memory_order_relaxed);
+        uint64_t sum = sumNs_.exchange(0, std::memory_order_relaxed);
+        uint64_t peak = peakInflight_.exchange(0, std::memory_order_relaxed);
+        windowStart_.store(now, std::memory_order_relaxed);
+
+        double recent = static_cast<double>(sum) / n;
+        // Baseline: the best window seen, creeping up ~2% a second so a
+        // lasting shift (slower disks, bigger rows) is eventually accepted.
+        baseline_ = baseline_ == 0 ? recent : std::min(recent, baseline_ * 1.002);
+
+        double limit = limit_.load(std::memory_order_relaxed);
+        double gradient = std::clamp(options_.tolerance * baseline_ / recent, 0.5, 1.0);
+        double target = limit * gradient + std::sqrt(limit);
+        // Only grow while the limit is actually being used
+        if (target > limit && peak < limit / 2)
+            return;
+        limit = limit * (1 - options_.smoothing) + target * options_.smoothing;
+        limit_.store(std::clamp(limit, options_.min, options_.max), std::memory_order_relaxed);
+    }
+
+    Options options_;
+    std::atomic<double> limit_;
+    std::atomic<int64_t> inflight_{0};
+
+    std::atomic<uint64_t> sumNs_{0};
+    std::atomic<uint64_t> samples_{0};
+    std::atomic<uint64_t> peakInflight_{0};
+    std::atomic<int64_t> windowStart_{0};
+
+    std::mutex mutex_;
+    double baseline_ = 0; // guarded by mutex_
+};
+
+// Admission control for the auth and bank route groups, run as a sync
+// advice so rejected requests get a 503 before routing, filters, or any
+// JSON parsing. Each group has its own AdaptiveLimit: a login storm
+// (bcrypt-bound) can exhaust the auth limit without taking balance and
+// transfer capacity with it. Admin, debug and health routes are never shed.
+class AdmissionControl
+{
+public:
+    enum class Group { Auth, Bank, Count };
+
+    static bool enabled()
+    {
+        const char *v = std::getenv("ADMISSION_CONTROL");
+        return !v || std::string(v) != "0";
+    }
+
+    AdmissionControl()
+    {
+        AdaptiveLimit::Options auth;
+        auth.initial = envDouble("ADMISSION_AUTH_INITIAL", 32);
+        auth.max = envDouble("ADMISSION_AUTH_MAX", 512);
+        AdaptiveLimit::Options bank;
+        bank.initial = envDouble("ADMISSION_BANK_INITIAL", 128);
+        bank.max = envDouble("ADMISSION_BANK_MAX", 4096);
+        limits_[0] = std::make_unique<AdaptiveLimit>(auth);
+        limits_[1] = std::make_unique<AdaptiveLimit>(bank);
+    }
+
+    // nullptr to let the request through, or the 503 to send.
+    drogon::HttpResponsePtr admit(const drogon::HttpRequestPtr &req)
+    {
+        int g = groupOf(req->path());
+        if (g < 0)
+            return nullptr;
+        AdaptiveLimit &limit = *limits_[g];
+        if (!limit.tryAcquire())
+        {
+            shed_[g].fetch_add(1, std::memory_order_relaxed);
+            return ResponseCache::get(CannedResponse::Overloaded);
+        }
+        req->attributes()->insert(kAttribute, std::make_shared<Ticket>(limit));
+        return nullptr;
+    }
+
+    // Pre-sending advice: the admitted request is done.
+    void finished(const drogon::HttpRequestPtr &req)
+    {
+        auto attrs = req->attributes();
+        if (!attrs->find(kAttribute))
+            return;
+        attrs->get<std::shared_ptr<Ticket>>(kAttribute)->complete();
+    }
+
+    const AdaptiveLimit &limit(Group g) const { return *limits_[static_cast<int>(g)]; }
+    uint64_t shed(Group g) const { return shed_[static_cast<int>(g)].load(std::memory_order_relaxed); }
+
+private:
+    static constexpr const char *kAttribute = "admission";
+
+    // Releases its slot exactly once: on completion with a latency sample,
+    // or without one when the request is dropped unanswered.
+    struct Ticket
+    {
+        explicit Ticket(AdaptiveLimit &l) : limit(l), start(std::chrono::steady_clock::now()) {}
+        ~Ticket()
+        {
+            if (!done) limit.abandon();
+        }
+        void complete()
+        {
+            if (done) return;
+            done = true;
+            limit.release(std::chrono::steady_clock::now() - start);
+        }
+
+        AdaptiveLimit &limit;
+        std::chrono::steady_clock::time_point start;
+        bool done = false;
+    };
+
+    static int groupOf(std::string_view path)
+    {
+        if (path == "/login" || path == "/register" || path == "/refresh")
+            return 0;
+        if (path == "/balance" || path == "/deposit" || path == "/withdraw" || path == "/transfer" ||
+            path == "/transfers/batch" || path == "/api/profile")
+            return 1;
+        return -1;
+    }
+
+    static double envDouble(const char *name, double fallback)
+    {
+        const char *v = std::getenv(name);
+        return v ? std::atof(v) : fallback;
+    }
+
+    std::unique_ptr<AdaptiveLimit> limits_[static_cast<int>(Group::Count)];
+    std::atomic<uint64_t> shed_[static_cast<int>(Group::Count)]{};
+};
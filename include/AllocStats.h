@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Process-wide heap allocation counters, fed by the operator new replacement
+// in main.cc, which is only built with -DCPPAUTH_ALLOC_STATS=ON. Each thread
+// bumps its own cache line (slots are handed out round-robin), so counting
+// costs two uncontended relaxed adds; totals are summed on read. Nothing here
+// may allocate.
+class AllocStats
+{
+public:
+#ifdef CPPAUTH_ALLOC_STATS
+    static constexpr bool kEnabled = true;
+#else
+    static constexpr bool kEnabled = false;
+#endif
+    struct Totals
+    {
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+        uint64_t requests = 0;
+    };
+
+    static void record(std::size_t bytes) noexcept
+    {
+        Slot &s = slot();
+        s.allocations.fetch_add(1, std::memory_order_relaxed);
+        s.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // One per response sent; the denominator for allocations per request.
+    static void requestDone() noexcept
+    {
+        slot().requests.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static Totals totals() noexcept
+    {
+        Totals t;
+        for (auto &s : slots())
+        {
+            t.allocations += s.allocations.load(std::memory_order_relaxed);
+            t.bytes += s.bytes.load(std::memory_order_relaxed);
+            t.requests += s.requests.load(std::memory_order_relaxed);
+        }
+        return t;
+    }
+
+private:
+    static constexpr std::size_t kSlots = 128;
+
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> requests{0};
+    };
+
+    static Slot (&slots() noexcept)[kSlots]
+    {
+        static Slot table[kSlots];
+        return table;
+    }
+
+    static Slot &slot() noexcept
+    {
+        static std::atomic<std::size_t> next{0};
+        thread_local std::size_t index = next.fetch_add(1, std::memory_order_relaxed) % kSlots;
+        return slots()[index];
+    }
+};
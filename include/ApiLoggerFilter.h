@@ -24,12 +24,8 @@ public:
     {
         auto start = std::chrono::steady_clock::now();
 
-        auto method = req->methodString();
-        auto path = req->path();
-        auto query = req->getParameters();
-
         // Log incoming request
-        logger_->info("Incoming request: {} {}", method, path);
+        logger_->info("Incoming request: {} {}", req->methodString(), req->path());
 
         // Call the next handler
         fcb([this, req, start](drogon::ReqResult result, const drogon::HttpResponsePtr &resp) {
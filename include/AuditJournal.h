@@ -0,0 +1,252 @@
+#pragma once
+#include <openssl/evp.h>
+#include <spdlog/spdlog.h>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include "GroupCommitLog.h"
+#include "JsonWriter.h"
+
+// Hash-chained, fsynced record of every money movement:
+//
+//   AUDIT_JOURNAL     0 turns it off
+//   AUDIT_DIR         segment directory (default ./audit, ./audit/w<N> per worker)
+//   AUDIT_STRICT      1 answers a movement only once its record is on disk
+//   AUDIT_SEGMENT_MB  size at which a new segment is started (default 64)
+//
+// Records go through a GroupCommitLog, so a burst of movements costs one
+// write() and one fdatasync(). Each payload is the SHA-256 of the previous
+// payload followed by a JSON object ({"seq":..,"ts":..,"op":..,...}).
+// Editing, dropping or reordering a record breaks every link after it, which
+// cppAuth_auditverify reports. The head hash also goes to the main log at
+// each rotation and at shutdown, so rewriting the whole chain still leaves a
+// mismatch. Segments are never deleted here.
+//
+// Without strict mode, record() answers at once and the record is durable
+// within one batch; with it, the completion runs after the fdatasync.
+//
+// A failed write fences the journal: the log runs in stop-on-error mode, so
+// nothing is written after the failed batch (which is cut off the segment),
+// and later records go to the error log only. The chain on disk stays
+// intact up to the last durable record; a restart picks it up from there.
+class AuditJournal
+{
+public:
+    static constexpr size_t kHashSize = 32;
+    using Hash = std::array<unsigned char, kHashSize>;
+
+    struct Options
+    {
+        std::string dir = "./audit";
+        bool strict = false;
+        size_t segmentBytes = 64u << 20;
+
+        static bool enabled()
+        {
+            const char *v = std::getenv("AUDIT_JOURNAL");
+            return !v || std::string(v) != "0";
+        }
+
+        static Options fromEnv(size_t workerId, size_t workers)
+        {
+            Options o;
+            if (const char *v = std::getenv("AUDIT_DIR")) o.dir = v;
+            if (workers > 1) o.dir += "/w" + std::to_string(workerId);
+            if (const char *v = std::getenv("AUDIT_STRICT")) o.strict = std::string(v) == "1";
+            if (const char *v = std::getenv("AUDIT_SEGMENT_MB")) o.segmentBytes = std::strtoull(v, nullptr, 10) << 20;
+            return o;
+        }
+    };
+
+    // One movement. Empty strings and a NaN balance are left out.
+    struct Entry
+    {
+        const char *op;           // "deposit", "withdraw", "transfer"
+        std::string_view account; // the account debited or credited; transfer source
+        std::string_view to;      // transfer target
+        double amount = 0;
+        double balance = NAN;     // balance after the movement, when known
+        std::string_view ref;     // transfer id
+        std::string_view result;  // "pending"/"refunded" for unfinished transfers
+    };
+
+    explicit AuditJournal(Options options)
+        : options_(std::move(options)), log_(options_.dir, "audit") {}
+
+    ~AuditJournal() { stop(); }
+
+    static Hash hash(std::string_view payload)
+    {
+        Hash h{};
+        unsigned int len = 0;
+        EVP_Digest(payload.data(), payload.size(), h.data(), &len, EVP_sha256(), nullptr);
+        return h;
+    }
+
+    static std::string hex(const Hash &h)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string out;
+        for (unsigned char c : h)
+        {
+            out.push_back(digits[c >> 4]);
+            out.push_back(digits[c & 15]);
+        }
+        return out;
+    }
+
+    // "seq" of a payload, or 0 if it has none.
+    static uint64_t sequenceOf(std::string_view payload)
+    {
+        constexpr std::string_view prefix = "{\"seq\":";
+        if (payload.size() < kHashSize + prefix.size() || payload.substr(kHashSize, prefix.size()) != prefix)
+            return 0;
+        uint64_t seq = 0;
+        const char *p = payload.data() + kHashSize + prefix.size();
+        std::from_chars(p, payload.data() + payload.size(), seq);
+        return seq;
+    }
+
+    // Picks the chain up from the existing segments and starts the writer.
+    void open()
+    {
+        size_t records = log_.replay([this](std::string_view payload) {
+            head_ = hash(payload);
+            seq_ = sequenceOf(payload);
+        });
+        durableHead_ = head_;
+        durableSeq_ = seq_;
+        log_.setStopOnError(true);
+        log_.open();
+        spdlog::info("Audit journal {}: {} records, seq {}, head {}{}", options_.dir, records, seq_, hex(head_),
+                     options_.strict ? " (strict)" : "");
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_) return;
+        stopped_ = true;
+        log_.stop();
+        // The writer has stopped, so the durable position is settled
+        spdlog::info("Audit journal closed at seq {}, head {}", durableSeq_, hex(durableHead_));
+    }
+
+    // `done(true)` once the record is accepted (strict: once it is durable);
+    // `done(false)` if a strict write failed or the journal is fenced. A record that could not be
+    // written goes to the error log, so the movement is not lost with it.
+    void record(const Entry &e, std::function<void(bool)> done)
+    {
+        int64_t ts = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::string payload(reinterpret_cast<const char *>(head_.data()), kHashSize);
+            payload.append("{\"seq\":");
+            appendNumber(payload, static_cast<int64_t>(seq_ + 1));
+            payload.append(",\"ts\":");
+            appendNumber(payload, ts);
+            appendString(payload, "op", e.op);
+            appendString(payload, "account", e.account);
+            appendString(payload, "to", e.to);
+            payload.append(",\"amount\":");
+            appendNumber(payload, e.amount);
+            if (!std::isnan(e.balance))
+            {
+                payload.append(",\"balance\":");
+                appendNumber(payload, e.balance);
+            }
+            appendString(payload, "ref", e.ref);
+            appendString(payload, "result", e.result);
+            payload.push_back('}');
+
+            if (stopped_ || failed_.load())
+            {
+                spdlog::error("Audit journal {}, record not written: {}", stopped_ ? "closed" : "fenced",
+                              std::string_view(payload).substr(kHashSize));
+                if (done) done(!options_.strict);
+                return;
+            }
+            ++seq_;
+            head_ = hash(payload);
+            segmentBytes_ += payload.size() + 8;
+            auto json = payload.substr(kHashSize);
+            // Completions run in file order on the writer thread
+            log_.append(std::move(payload),
+                        [this, seq = seq_, head = head_, json = std::move(json),
+                         done = options_.strict ? std::move(done) : nullptr](bool ok) {
+                            if (ok)
+                            {
+                                durableSeq_ = seq;
+                                durableHead_ = head;
+                            }
+                            else
+                            {
+                                if (!failed_.exchange(true))
+                                    spdlog::error("Audit journal fenced after a failed write at seq {}; the chain "
+                                                  "on disk ends at seq {}, restart to resume",
+                                                  seq, durableSeq_);
+                                spdlog::error("Audit record not written: {}", json);
+                            }
+                            if (done) done(ok);
+                        });
+
+            if (segmentBytes_ >= options_.segmentBytes)
+            {
+                segmentBytes_ = 0;
+                log_.rotate([] { return std::vector<std::string>(); },
+                            [seq = seq_, head = hex(head_)](uint64_t segment) {
+                                if (segment)
+                                    spdlog::info("Audit journal segment {} started after seq {}, head {}", segment,
+                                                 seq, head);
+                            });
+            }
+        }
+        if (!options_.strict && done) done(true);
+    }
+
+private:
+    static void appendNumber(std::string &out, int64_t v)
+    {
+        char tmp[24];
+        auto res = std::to_chars(tmp, tmp + sizeof(tmp), v);
+        out.append(tmp, res.ptr);
+    }
+
+    static void appendNumber(std::string &out, double v)
+    {
+        char tmp[32];
+        auto res = std::to_chars(tmp, tmp + sizeof(tmp), v);
+        out.append(tmp, res.ptr);
+    }
+
+    static void appendString(std::string &out, std::string_view key, std::string_view value)
+    {
+        if (value.empty()) return;
+        out.append(",\"");
+        out.append(key);
+        out.append("\":\"");
+        JsonWriter::appendEscaped(out, value);
+        out.push_back('"');
+    }
+
+    Options options_;
+    GroupCommitLog log_;
+    std::mutex mutex_; // orders seq and the chain the same way as the log
+    Hash head_{};
+    uint64_t seq_ = 0;
+    size_t segmentBytes_ = 0;
+    bool stopped_ = false;
+    std::atomic<bool> failed_{false}; // a write failed; set on the writer thread
+    Hash durableHead_{};              // last record on disk; writer thread only
+    uint64_t durableSeq_ = 0;
+};
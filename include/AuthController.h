@@ -6,6 +6,11 @@
 #include <mutex>
 #include <cstdlib> // for getenv
 #include <string>
+#include <memory>
+#include "ShardMap.h"
+#include "IdAllocator.h"
+#include "SessionStore.h"
+#include "SingleFlight.h"
 
 using namespace drogon;
 
@@ -13,7 +18,9 @@ class AuthController : public drogon::HttpController<AuthController, false> {
 public:
     AuthController(); // default constructor declaration
     // Constructor used when creating controller with injected dependencies
-    AuthController(drogon::orm::DbClientPtr dbClient, const std::string &jwtSecret);
+    AuthController(std::shared_ptr<ShardMap> shards, std::shared_ptr<IdAllocator> accountIds,
+                   std::shared_ptr<SingleFlight> flights = nullptr,
+                   std::shared_ptr<SessionStore> sessions = nullptr);
 
     METHOD_LIST_BEGIN
     ADD_METHOD_TO(AuthController::registerUser, "/register", Post);
@@ -28,10 +35,15 @@ public:
     void getProfile(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
 
 private:
-    std::unordered_map<std::string, std::string> refreshTokens; // username -> refresh token
-    std::mutex refreshMutex;
-    std::string jwtSecret; // no longer hardcoded
+    struct CredentialsScope;
 
-    std::string generateAccessToken(const std::string &username);
-    std::string generateRefreshToken(const std::string &username);
+    std::shared_ptr<ShardMap> shards_; // users rows live on their account's shard
+    std::shared_ptr<IdAllocator> accountIds_; // sequence behind new account numbers
+    std::shared_ptr<SingleFlight> flights_; // coalesces concurrent profile reads; null when disabled
+    std::shared_ptr<SessionStore> sessions_; // current refresh token per user; in memory unless injected
+    // JWT secret and token lifetimes come from RuntimeConfig::current()
+
+    // `account` goes into the "acct" claim the bank endpoints act on
+    std::string generateAccessToken(const std::string &username, const std::string &account);
+    std::string generateRefreshToken(const std::string &username, const std::string &account);
 };
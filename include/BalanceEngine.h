@@ -0,0 +1,771 @@
+#pragma once
+#include <drogon/orm/DbClient.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "GroupCommitLog.h"
+#include "MpscRing.h"
+#include "ShardMap.h"
+
+// In-memory balance engine, enabled with BALANCE_ENGINE=1:
+//
+//   ENGINE_PARTITIONS    writer threads, accounts hashed over them (default 4)
+//   ENGINE_RING_SIZE     per-partition queue slots (default 65536)
+//   ENGINE_JOURNAL_DIR   journal segments (default ./journal)
+//   ENGINE_FLUSH_MS      write-back interval to the users table (default 1000)
+//
+// Each partition owns its accounts outright: one thread drains an MpscRing
+// of operations and applies them to a flat table with no locks. Every change
+// is appended to a GroupCommitLog as an after-image ("account now has X") and
+// acknowledged once the journal batch holding it is fsynced. Balances are
+// written back to `users` in the background; after a round lands, the
+// journal segments it covers are deleted.
+//
+// Startup loads `users`, replays the journal over it (after-images make the
+// replay idempotent) and settles transfers a crash left half done.
+//
+// A transfer is two steps on two partitions: the source debits and journals
+// D(id), the target credits and journals C(id). If the target does not exist
+// it journals A(id) and the source refunds with R(id). Transfers that are
+// open when the journal rotates are carried into the new segment.
+//
+// A change is applied in memory before its journal record is durable. If a
+// journal write fails, that change cannot be taken back (later after-images
+// may already include it), so the engine fences itself: the journal stops
+// accepting records, every further operation answers Error, and nothing more
+// is written back. A restart rebuilds the balances from `users` and the
+// records that did reach the disk. Write-back itself waits for a journal
+// sync, so `users` never gets a balance whose record could still fail.
+//
+// The engine assumes it is the only writer of `users.balance`, so it refuses
+// to run with WORKERS > 1. Reads see applied-but-not-yet-fsynced changes of
+// other requests, as with any write-ahead log; nothing is acknowledged early.
+class BalanceEngine : public std::enable_shared_from_this<BalanceEngine>
+{
+public:
+    enum class Status
+    {
+        Ok,
+        NotFound,
+        Insufficient,
+        Error
+    };
+    using Callback = std::function<void(Status, double balance)>;
+
+    struct Options
+    {
+        size_t partitions = 4;
+        size_t ringSize = 65536;
+        std::string journalDir = "journal";
+        double flushSeconds = 1.0;
+
+        static bool enabled()
+        {
+            const char *v = std::getenv("BALANCE_ENGINE");
+            return v && std::string(v) == "1";
+        }
+
+        static Options fromEnv()
+        {
+            Options o;
+            if (const char *v = std::getenv("ENGINE_PARTITIONS"); v && std::atol(v) > 0)
+                o.partitions = static_cast<size_t>(std::atol(v));
+            if (const char *v = std::getenv("ENGINE_RING_SIZE"); v && std::atol(v) > 0)
+                o.ringSize = static_cast<size_t>(std::atol(v));
+            if (const char *v = std::getenv("ENGINE_JOURNAL_DIR"); v && *v)
+                o.journalDir = v;
+            if (const char *v = std::getenv("ENGINE_FLUSH_MS"); v && std::atol(v) > 0)
+                o.flushSeconds = std::atol(v) / 1000.0;
+            return o;
+        }
+    };
+
+    BalanceEngine(std::shared_ptr<ShardMap> shards, Options opts)
+        : shards_(std::move(shards)), opts_(std::move(opts)), log_(opts_.journalDir, "balances")
+    {
+        for (size_t i = 0; i < opts_.partitions; ++i)
+            partitions_.emplace_back(new Partition(opts_.ringSize));
+    }
+
+    ~BalanceEngine() { stop(); }
+
+    double flushSeconds() const { return opts_.flushSeconds; }
+
+    // Loads balances, replays the journal and starts the partition threads.
+    // Throws if the database or the journal cannot be read.
+    void start()
+    {
+        for (size_t s = 0; s < shards_->size(); ++s)
+        {
+            auto r = shards_->shard(s)->reader()->execSqlSync(
+                "SELECT account_number, balance FROM users WHERE account_number IS NOT NULL");
+            for (const auto &row : r)
+                set(row["account_number"].as<std::string>(), row["balance"].as<double>(), false);
+        }
+
+        uint64_t maxId = 0;
+        size_t records = log_.replay([this, &maxId](std::string_view rec) { replayRecord(rec, maxId); });
+        nextTransferId_ = maxId + 1;
+
+        log_.setObserver([this](std::string_view rec) { observe(rec); });
+        log_.setStopOnError(true);
+        log_.open();
+        settleOpenTransfers();
+
+        size_t accounts = 0;
+        for (auto &p : partitions_)
+            accounts += p->accounts.size();
+        spdlog::info("Balance engine: {} accounts, {} journal records replayed, {} partitions",
+                     accounts, records, partitions_.size());
+
+        needFull_ = records > 0;
+        for (size_t i = 0; i < partitions_.size(); ++i)
+            partitions_[i]->thread = std::thread([this, i] { run(i); });
+        started_ = true;
+    }
+
+    void stop()
+    {
+        if (!started_.exchange(false))
+            return;
+        for (size_t i = 0; i < partitions_.size(); ++i)
+        {
+            Op op;
+            op.kind = Op::Stop;
+            submit(i, std::move(op));
+        }
+        for (auto &p : partitions_)
+            if (p->thread.joinable())
+                p->thread.join();
+        log_.stop();
+    }
+
+    void balance(const std::string &account, Callback cb) { submit(Op::Balance, account, {}, 0, std::move(cb)); }
+    void deposit(const std::string &account, double amount, Callback cb) { submit(Op::Deposit, account, {}, amount, std::move(cb)); }
+    void withdraw(const std::string &account, double amount, Callback cb) { submit(Op::Withdraw, account, {}, amount, std::move(cb)); }
+    void transfer(const std::string &from, const std::string &to, double amount, Callback cb)
+    {
+        submit(Op::Debit, from, to, amount, std::move(cb));
+    }
+
+    // One write-back round: rotate the journal, have every partition hand
+    // over its changed balances, write them to `users`, then drop the
+    // journal segments they cover. Call periodically.
+    void flush()
+    {
+        if (!started_ || failed_ || flushing_.exchange(true))
+            return;
+        if (appended_.exchange(0) == 0 && !needFull_)
+        {
+            flushing_ = false;
+            return;
+        }
+        auto self = shared_from_this();
+        log_.rotate(
+            [self] { return self->carry(); },
+            [self](uint64_t segment) {
+                if (segment == 0)
+                {
+                    self->flushing_ = false; // journal failed; nothing is written back
+                    return;
+                }
+                auto round = std::make_shared<Round>();
+                round->segment = segment;
+                round->pending = self->partitions_.size();
+                bool full = self->needFull_.exchange(false);
+                for (size_t i = 0; i < self->partitions_.size(); ++i)
+                {
+                    Op op;
+                    op.kind = Op::Snapshot;
+                    op.full = full;
+                    op.round = round;
+                    self->submit(i, std::move(op));
+                }
+            });
+    }
+
+private:
+    struct Round
+    {
+        uint64_t segment = 0;
+        std::atomic<size_t> pending{0};
+        std::atomic<bool> failed{false};
+    };
+
+    struct Op
+    {
+        enum Kind
+        {
+            Balance,
+            Deposit,
+            Withdraw,
+            Debit,  // transfer, source side
+            Credit, // transfer, target side
+            Refund, // transfer, back on the source
+            Snapshot,
+            Stop
+        } kind = Balance;
+        std::string account;
+        std::string other;
+        double amount = 0;
+        uint64_t id = 0;
+        Status status = Status::Ok;
+        bool full = false;
+        std::shared_ptr<Round> round;
+        Callback cb;
+    };
+
+    struct Account
+    {
+        double balance = 0;
+        bool dirty = false;
+    };
+
+    struct Partition
+    {
+        explicit Partition(size_t ringSize) : ring(ringSize) {}
+
+        MpscRing<Op> ring;
+        std::mutex overflowMutex; // partition-to-partition ops when the ring is full
+        std::deque<Op> overflow;
+        std::atomic<bool> hasOverflow{false};
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        std::atomic<bool> sleeping{false};
+        std::thread thread;
+
+        // Owned by the partition thread once it runs.
+        std::unordered_map<std::string, uint32_t> index;
+        std::vector<Account> accounts;
+        std::vector<std::string> names;
+        std::vector<uint32_t> dirty;
+    };
+
+    struct OpenTransfer
+    {
+        std::string from, to;
+        double amount = 0;
+        char stage = 'D'; // D: debited, A: credit aborted, refund owed
+    };
+
+    std::shared_ptr<ShardMap> shards_;
+    Options opts_;
+    GroupCommitLog log_;
+    std::vector<std::unique_ptr<Partition>> partitions_;
+    std::atomic<uint64_t> nextTransferId_{1};
+    std::atomic<uint64_t> appended_{0};
+    std::atomic<bool> needFull_{false};
+    std::atomic<bool> flushing_{false};
+    std::atomic<bool> started_{false};
+    std::atomic<bool> failed_{false}; // a journal write failed; see the top comment
+    std::unordered_map<uint64_t, OpenTransfer> open_; // journal writer thread only
+
+    static inline thread_local bool onPartitionThread_ = false;
+
+    size_t partitionOf(std::string_view account) const
+    {
+        return static_cast<size_t>(ShardMap::hash(account) % partitions_.size());
+    }
+
+    static std::string fmt(double v)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.17g", v);
+        return buf;
+    }
+
+    // ---------------------------------------------------------------- queueing
+
+    void submit(Op::Kind kind, const std::string &account, const std::string &other, double amount, Callback cb)
+    {
+        Op op;
+        op.kind = kind;
+        op.account = account;
+        op.other = other;
+        op.amount = amount;
+        op.cb = std::move(cb);
+        submit(partitionOf(account), std::move(op));
+    }
+
+    void submit(size_t i, Op op)
+    {
+        auto &p = *partitions_[i];
+        if (!p.ring.tryPush(op))
+        {
+            if (onPartitionThread_)
+            {
+                // Never block one partition on another's full ring.
+                std::lock_guard<std::mutex> lock(p.overflowMutex);
+                p.overflow.push_back(std::move(op));
+                p.hasOverflow = true;
+            }
+            else
+            {
+                while (!p.ring.tryPush(op))
+                    std::this_thread::yield();
+            }
+        }
+        if (p.sleeping.load())
+        {
+            std::lock_guard<std::mutex> lock(p.sleepMutex);
+            p.wake.notify_one();
+        }
+    }
+
+    bool pop(Partition &p, Op &op)
+    {
+        if (p.ring.tryPop(op))
+            return true;
+        if (!p.hasOverflow.load(std::memory_order_acquire))
+            return false;
+        std::lock_guard<std::mutex> lock(p.overflowMutex);
+        if (p.overflow.empty())
+        {
+            p.hasOverflow = false;
+            return false;
+        }
+        op = std::move(p.overflow.front());
+        p.overflow.pop_front();
+        p.hasOverflow = !p.overflow.empty();
+        return true;
+    }
+
+    void run(size_t i)
+    {
+        onPartitionThread_ = true;
+        auto &p = *partitions_[i];
+        unsigned idle = 0;
+        for (;;)
+        {
+            Op op;
+            if (!pop(p, op))
+            {
+                if (++idle < 256)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(p.sleepMutex);
+                p.sleeping = true;
+                if (!pop(p, op))
+                {
+                    p.wake.wait_for(lock, std::chrono::milliseconds(50));
+                    p.sleeping = false;
+                    continue;
+                }
+                p.sleeping = false;
+            }
+            idle = 0;
+            if (op.kind == Op::Stop)
+                return;
+            handle(p, op);
+        }
+    }
+
+    // ------------------------------------------------------------ account table
+
+    Account *lookup(Partition &p, const std::string &account)
+    {
+        auto it = p.index.find(account);
+        return it == p.index.end() ? nullptr : &p.accounts[it->second];
+    }
+
+    uint32_t insert(Partition &p, const std::string &account, double balance)
+    {
+        auto idx = static_cast<uint32_t>(p.accounts.size());
+        p.index.emplace(account, idx);
+        p.accounts.push_back(Account{balance, false});
+        p.names.push_back(account);
+        return idx;
+    }
+
+    // Accounts registered after startup are pulled in on first use. This is
+    // the only blocking call on a partition thread and happens once per
+    // account.
+    Account *find(Partition &p, const std::string &account, Status &status)
+    {
+        if (auto *a = lookup(p, account))
+            return a;
+        try
+        {
+            auto r = shards_->forAccount(account)->reader()->execSqlSync(
+                "SELECT balance FROM users WHERE account_number=$1", account);
+            if (r.empty())
+            {
+                status = Status::NotFound;
+                return nullptr;
+            }
+            return &p.accounts[insert(p, account, r[0]["balance"].as<double>())];
+        }
+        catch (const std::exception &e)
+        {
+            spdlog::error("Balance engine could not load {}: {}", account, e.what());
+            status = Status::Error;
+            return nullptr;
+        }
+    }
+
+    void markDirty(Partition &p, Account *a)
+    {
+        if (!a->dirty)
+        {
+            a->dirty = true;
+            p.dirty.push_back(static_cast<uint32_t>(a - p.accounts.data()));
+        }
+    }
+
+    // Used before the threads start.
+    void set(const std::string &account, double balance, bool dirty)
+    {
+        auto &p = *partitions_[partitionOf(account)];
+        Account *a = lookup(p, account);
+        if (!a)
+            a = &p.accounts[insert(p, account, balance)];
+        a->balance = balance;
+        if (dirty)
+            markDirty(p, a);
+    }
+
+    // ------------------------------------------------------------- operations
+
+    void journal(std::string record, std::function<void(bool)> done)
+    {
+        appended_.fetch_add(1, std::memory_order_relaxed);
+        log_.append(std::move(record), [this, done = std::move(done)](bool ok) {
+            if (!ok && !failed_.exchange(true))
+                spdlog::error("Balance journal write failed; the engine rejects all operations until restarted");
+            if (done)
+                done(ok);
+        });
+    }
+
+    void handle(Partition &p, Op &op)
+    {
+        Status status = Status::Ok;
+        if (failed_ && op.kind != Op::Snapshot && op.kind != Op::Stop)
+        {
+            if (op.cb)
+                op.cb(Status::Error, 0);
+            return;
+        }
+        switch (op.kind)
+        {
+        case Op::Balance:
+        {
+            Account *a = find(p, op.account, status);
+            op.cb(a ? Status::Ok : status, a ? a->balance : 0);
+            break;
+        }
+        case Op::Deposit:
+        case Op::Withdraw:
+        {
+            Account *a = find(p, op.account, status);
+            if (!a)
+            {
+                op.cb(status, 0);
+                break;
+            }
+            if (op.kind == Op::Withdraw && a->balance < op.amount)
+            {
+                op.cb(Status::Insufficient, a->balance);
+                break;
+            }
+            a->balance += op.kind == Op::Deposit ? op.amount : -op.amount;
+            markDirty(p, a);
+            double balance = a->balance;
+            journal("S " + op.account + " " + fmt(balance),
+                    [cb = std::move(op.cb), balance](bool ok) { cb(ok ? Status::Ok : Status::Error, balance); });
+            break;
+        }
+        case Op::Debit:
+        {
+            Account *a = find(p, op.account, status);
+            if (!a)
+            {
+                op.cb(status == Status::NotFound ? Status::Insufficient : status, 0);
+                break;
+            }
+            if (a->balance < op.amount)
+            {
+                op.cb(Status::Insufficient, a->balance);
+                break;
+            }
+            a->balance -= op.amount;
+            markDirty(p, a);
+            op.id = nextTransferId_.fetch_add(1);
+            journal("D " + std::to_string(op.id) + " " + op.account + " " + fmt(a->balance) + " " +
+                        op.other + " " + fmt(op.amount),
+                    nullptr);
+            op.kind = Op::Credit;
+            std::swap(op.account, op.other); // account = to, other = from
+            submit(partitionOf(op.account), std::move(op));
+            break;
+        }
+        case Op::Credit:
+        {
+            Account *a = find(p, op.account, status);
+            if (!a)
+            {
+                journal("A " + std::to_string(op.id), nullptr);
+                op.kind = Op::Refund;
+                op.status = status;
+                std::swap(op.account, op.other); // account = from
+                submit(partitionOf(op.account), std::move(op));
+                break;
+            }
+            a->balance += op.amount;
+            markDirty(p, a);
+            journal("C " + std::to_string(op.id) + " " + op.account + " " + fmt(a->balance),
+                    [cb = std::move(op.cb)](bool ok) { cb(ok ? Status::Ok : Status::Error, 0); });
+            break;
+        }
+        case Op::Refund:
+        {
+            Account *a = find(p, op.account, status);
+            if (!a)
+            {
+                // Debited here moments ago, so this cannot happen short of a bug.
+                spdlog::error("Refund of transfer {} found no account {}", op.id, op.account);
+                op.cb(Status::Error, 0);
+                break;
+            }
+            a->balance += op.amount;
+            markDirty(p, a);
+            journal("R " + std::to_string(op.id) + " " + op.account + " " + fmt(a->balance),
+                    [cb = std::move(op.cb), result = op.status](bool ok) { cb(ok ? result : Status::Error, 0); });
+            break;
+        }
+        case Op::Snapshot:
+            writeBack(p, op);
+            break;
+        case Op::Stop:
+            break;
+        }
+    }
+
+    // -------------------------------------------------------------- write-back
+
+    void writeBack(Partition &p, Op &op)
+    {
+        std::vector<std::pair<std::string, double>> rows;
+        if (op.full)
+        {
+            rows.reserve(p.accounts.size());
+            for (size_t i = 0; i < p.accounts.size(); ++i)
+                rows.emplace_back(p.names[i], p.accounts[i].balance);
+            for (auto &a : p.accounts)
+                a.dirty = false;
+        }
+        else
+        {
+            rows.reserve(p.dirty.size());
+            for (uint32_t idx : p.dirty)
+            {
+                rows.emplace_back(p.names[idx], p.accounts[idx].balance);
+                p.accounts[idx].dirty = false;
+            }
+        }
+        p.dirty.clear();
+
+        // Every balance in `rows` has its record appended already; once the
+        // journal is synced up to here none of them can still be rolled back.
+        auto self = shared_from_this();
+        log_.sync([self, round = op.round, rows = std::move(rows)](bool ok) {
+            if (!ok)
+            {
+                round->failed = true;
+                self->finishRound(round);
+                return;
+            }
+            round->pending += rows.size();
+            for (const auto &[account, balance] : rows)
+            {
+                self->shards_->forAccount(account)->write(
+                    "UPDATE users SET balance = $1 WHERE account_number = $2",
+                    [self, round](const drogon::orm::Result &) { self->finishRound(round); },
+                    [self, round, account = account](const drogon::orm::DrogonDbException &e) {
+                        spdlog::error("Balance write-back failed for {}: {}", account, e.base().what());
+                        round->failed = true;
+                        self->finishRound(round);
+                    },
+                    balance, account);
+            }
+            self->finishRound(round);
+        });
+    }
+
+    void finishRound(const std::shared_ptr<Round> &round)
+    {
+        if (round->pending.fetch_sub(1) != 1)
+            return;
+        if (round->failed)
+        {
+            // Keep the journal and write everything next round.
+            needFull_ = true;
+        }
+        else
+        {
+            log_.dropBefore(round->segment);
+        }
+        flushing_ = false;
+    }
+
+    // ------------------------------------------------------- journal contents
+
+    // Writer thread: track transfers that are not finished yet.
+    void observe(std::string_view rec)
+    {
+        std::istringstream in{std::string(rec)};
+        char type = 0;
+        uint64_t id = 0;
+        in >> type >> id;
+        switch (type)
+        {
+        case 'D':
+        {
+            OpenTransfer t;
+            double balance = 0;
+            in >> t.from >> balance >> t.to >> t.amount;
+            open_[id] = std::move(t);
+            break;
+        }
+        case 'A':
+            if (auto it = open_.find(id); it != open_.end())
+                it->second.stage = 'A';
+            break;
+        case 'C':
+        case 'R':
+            open_.erase(id);
+            break;
+        default:
+            break;
+        }
+    }
+
+    std::vector<std::string> carry() const
+    {
+        std::vector<std::string> out;
+        out.reserve(open_.size());
+        for (const auto &[id, t] : open_)
+            out.push_back("O " + std::to_string(id) + " " + t.from + " " + t.to + " " + fmt(t.amount) + " " + t.stage);
+        return out;
+    }
+
+    void replayRecord(std::string_view rec, uint64_t &maxId)
+    {
+        std::istringstream in{std::string(rec)};
+        char type = 0;
+        in >> type;
+        if (type == 'S')
+        {
+            std::string account;
+            double balance = 0;
+            in >> account >> balance;
+            set(account, balance, true);
+            return;
+        }
+        uint64_t id = 0;
+        in >> id;
+        maxId = std::max(maxId, id);
+        switch (type)
+        {
+        case 'D':
+        {
+            OpenTransfer t;
+            double balance = 0;
+            in >> t.from >> balance >> t.to >> t.amount;
+            set(t.from, balance, true);
+            open_[id] = std::move(t);
+            break;
+        }
+        case 'C':
+        case 'R':
+        {
+            std::string account;
+            double balance = 0;
+            in >> account >> balance;
+            set(account, balance, true);
+            open_.erase(id);
+            break;
+        }
+        case 'A':
+            if (auto it = open_.find(id); it != open_.end())
+                it->second.stage = 'A';
+            break;
+        case 'O':
+        {
+            OpenTransfer t;
+            in >> t.from >> t.to >> t.amount >> t.stage;
+            open_.emplace(id, std::move(t));
+            break;
+        }
+        default:
+            spdlog::warn("Unknown balance journal record '{}'", std::string(rec));
+            break;
+        }
+    }
+
+    // Finishes transfers the previous run left open, before serving traffic.
+    void settleOpenTransfers()
+    {
+        if (open_.empty())
+            return;
+        std::vector<std::pair<uint64_t, OpenTransfer>> pending(open_.begin(), open_.end());
+        std::promise<bool> durable;
+        auto remaining = std::make_shared<std::atomic<size_t>>(0);
+        auto allOk = std::make_shared<std::atomic<bool>>(true);
+        std::vector<std::string> records;
+
+        for (auto &[id, t] : pending)
+        {
+            auto &to = *partitions_[partitionOf(t.to)];
+            Account *target = t.stage == 'D' ? lookup(to, t.to) : nullptr;
+            if (target)
+            {
+                target->balance += t.amount;
+                markDirty(to, target);
+                records.push_back("C " + std::to_string(id) + " " + t.to + " " + fmt(target->balance));
+                continue;
+            }
+            auto &from = *partitions_[partitionOf(t.from)];
+            Account *source = lookup(from, t.from);
+            if (!source)
+            {
+                spdlog::error("Open transfer {} refers to unknown account {}", id, t.from);
+                continue;
+            }
+            if (t.stage == 'D')
+                records.push_back("A " + std::to_string(id));
+            source->balance += t.amount;
+            markDirty(from, source);
+            records.push_back("R " + std::to_string(id) + " " + t.from + " " + fmt(source->balance));
+        }
+
+        *remaining = records.size();
+        for (auto &rec : records)
+            journal(std::move(rec), [remaining, allOk, &durable](bool ok) {
+                if (!ok)
+                    *allOk = false;
+                if (remaining->fetch_sub(1) == 1)
+                    durable.set_value(allOk->load());
+            });
+        if (!records.empty() && !durable.get_future().get())
+            throw std::runtime_error("could not journal settled transfers");
+        spdlog::warn("Balance engine settled {} transfers left open by the last run", pending.size());
+    }
+};
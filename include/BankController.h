@@ -1,26 +1,42 @@
 #include <drogon/HttpController.h>
+#include <memory>
+#include "AuditJournal.h"
+#include "BalanceEngine.h"
+#include "ShardMap.h"
+#include "SingleFlight.h"
 using namespace drogon;
 
 class BankController : public drogon::HttpController<BankController, false> {
 public:
-    BankController(drogon::orm::DbClientPtr db, const std::string &secret)
-        : dbClient_(db), jwtSecret_(secret) {}
+    explicit BankController(std::shared_ptr<ShardMap> shards,
+                            std::shared_ptr<BalanceEngine> engine = nullptr,
+                            std::shared_ptr<SingleFlight> flights = nullptr,
+                            std::shared_ptr<AuditJournal> audit = nullptr)
+        : shards_(std::move(shards)), engine_(std::move(engine)), flights_(std::move(flights)),
+          audit_(std::move(audit)) {}
 
     METHOD_LIST_BEGIN
     ADD_METHOD_TO(BankController::getBalance, "/balance", Get);
     ADD_METHOD_TO(BankController::deposit, "/deposit", Post);
     ADD_METHOD_TO(BankController::withdraw, "/withdraw", Post);
     ADD_METHOD_TO(BankController::transfer, "/transfer", Post);
+    ADD_METHOD_TO(BankController::transferBatch, "/transfers/batch", Post);
     METHOD_LIST_END
 
     void getBalance(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
     void deposit(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
     void withdraw(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
     void transfer(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
+    void transferBatch(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
 
 private:
-    drogon::orm::DbClientPtr dbClient_;
-    std::string jwtSecret_;
+    void transferAcrossShards(const std::string &fromAccount, const std::string &toAccount, double amount,
+                              std::function<void(const HttpResponsePtr &)> &&callback);
+
+    std::shared_ptr<ShardMap> shards_; // account_number -> shard; one shard unless DB_SHARDS is set
+    std::shared_ptr<BalanceEngine> engine_; // set when BALANCE_ENGINE=1; balances then live in memory
+    std::shared_ptr<SingleFlight> flights_; // coalesces concurrent balance reads; null when disabled
+    std::shared_ptr<AuditJournal> audit_; // movements are recorded here before they are answered
 };
 
 
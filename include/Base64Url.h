@@ -0,0 +1,130 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Unpadded base64url (RFC 4648 section 5), the JWT segment encoding.
+//
+// Branch-free in the inner loops: encoding turns each 3-byte group into four
+// alphabet lookups, and decoding ORs four pre-shifted 32-bit table entries
+// per quad. An invalid character sets bits no valid quad can have, so the
+// whole input is validated with one test at the end rather than one per
+// character.
+namespace Base64Url
+{
+namespace detail
+{
+constexpr char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+constexpr uint32_t kBad = 0x01FFFFFF;
+
+constexpr int valueOf(char c)
+{
+    for (int i = 0; i < 64; ++i)
+        if (kAlphabet[i] == c) return i;
+    return -1;
+}
+
+// Entry for character c at quad position pos, laid out so that OR-ing the
+// four entries gives the three decoded bytes in memory order.
+constexpr std::array<uint32_t, 256> decodeTable(int pos)
+{
+    std::array<uint32_t, 256> t{};
+    for (int c = 0; c < 256; ++c)
+    {
+        int v = valueOf(static_cast<char>(c));
+        if (v < 0)
+        {
+            t[c] = kBad;
+            continue;
+        }
+        uint32_t bits = static_cast<uint32_t>(v) << (18 - 6 * pos); // 24-bit big-endian group
+        t[c] = ((bits >> 16) & 0xFF) | (bits & 0xFF00) | ((bits & 0xFF) << 16);
+    }
+    return t;
+}
+
+inline constexpr std::array<uint32_t, 256> kD0 = decodeTable(0);
+inline constexpr std::array<uint32_t, 256> kD1 = decodeTable(1);
+inline constexpr std::array<uint32_t, 256> kD2 = decodeTable(2);
+inline constexpr std::array<uint32_t, 256> kD3 = decodeTable(3);
+} // namespace detail
+
+inline size_t encodedSize(size_t n) { return n / 3 * 4 + (n % 3 ? n % 3 + 1 : 0); }
+
+inline void encode(std::string_view in, std::string &out)
+{
+    using detail::kAlphabet;
+    size_t pos = out.size();
+    out.resize(pos + encodedSize(in.size()));
+    char *o = &out[pos];
+    auto p = reinterpret_cast<const uint8_t *>(in.data());
+    size_t n = in.size(), i = 0;
+    for (; i + 3 <= n; i += 3)
+    {
+        uint32_t v = (uint32_t(p[i]) << 16) | (uint32_t(p[i + 1]) << 8) | p[i + 2];
+        o[0] = kAlphabet[v >> 18];
+        o[1] = kAlphabet[(v >> 12) & 63];
+        o[2] = kAlphabet[(v >> 6) & 63];
+        o[3] = kAlphabet[v & 63];
+        o += 4;
+    }
+    if (n - i == 1)
+    {
+        o[0] = kAlphabet[p[i] >> 2];
+        o[1] = kAlphabet[(p[i] & 3) << 4];
+    }
+    else if (n - i == 2)
+    {
+        uint32_t v = (uint32_t(p[i]) << 8) | p[i + 1];
+        o[0] = kAlphabet[v >> 10];
+        o[1] = kAlphabet[(v >> 4) & 63];
+        o[2] = kAlphabet[(v & 15) << 2];
+    }
+}
+
+inline std::string encode(std::string_view in)
+{
+    std::string out;
+    encode(in, out);
+    return out;
+}
+
+// Appends the decoded bytes to `out`; false on a character outside the
+// alphabet, padding, or an impossible length.
+inline bool decode(std::string_view in, std::string &out)
+{
+    using namespace detail;
+    size_t n = in.size();
+    if (n % 4 == 1) return false;
+    size_t pos = out.size();
+    out.resize(pos + n / 4 * 3 + (n % 4 ? n % 4 - 1 : 0));
+    auto o = reinterpret_cast<uint8_t *>(&out[pos]);
+    auto p = reinterpret_cast<const uint8_t *>(in.data());
+
+    uint32_t bad = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        uint32_t v = kD0[p[i]] | kD1[p[i + 1]] | kD2[p[i + 2]] | kD3[p[i + 3]];
+        bad |= v;
+        o[0] = static_cast<uint8_t>(v);
+        o[1] = static_cast<uint8_t>(v >> 8);
+        o[2] = static_cast<uint8_t>(v >> 16);
+        o += 3;
+    }
+    if (n - i >= 2)
+    {
+        uint32_t v = kD0[p[i]] | kD1[p[i + 1]] | (n - i == 3 ? kD2[p[i + 2]] : 0);
+        bad |= v;
+        o[0] = static_cast<uint8_t>(v);
+        if (n - i == 3) o[1] = static_cast<uint8_t>(v >> 8);
+    }
+    if (bad >= 0x01000000)
+    {
+        out.resize(pos);
+        return false;
+    }
+    return true;
+}
+} // namespace Base64Url
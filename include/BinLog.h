@@ -0,0 +1,282 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Binary structured log. A record is a format-string id, a steady-clock
+// timestamp and the raw bytes of its arguments; nothing is formatted on the
+// server. Each call site interns its format string once, in a function-local
+// static, so the hot path is a memcpy into a shared buffer that a background
+// thread writes out. cppAuth_logcat turns the files back into text or NDJSON.
+//
+//   BINLOG_INFO(*log_, "{} {} => {} ({}ms)", method, path, status, ms);
+//
+// File layout (host byte order):
+//   header  "CABLOG01" i64 wall-minus-steady offset in ns
+//   'F'     u32 id, u8 level, u8 nargs, u16 len, format[len], type[nargs]
+//   'R'     u32 id, u64 steady ns, args
+// Argument types: 'i' i64, 'u' u64, 'd' f64, 'b' u8, 's' u32 len + bytes.
+// A format is defined ('F') in a file before its first record, so every
+// file, rotated or not, decodes on its own.
+//
+// After setProcessTag() (forked workers), logs/api.blog becomes
+// logs/api.<tag>.blog, so processes never share a file.
+class BinLog
+{
+public:
+    enum class Level : uint8_t { Info, Warn, Error };
+
+    static constexpr char kMagic[8] = {'C', 'A', 'B', 'L', 'O', 'G', '0', '1'};
+
+    struct Format
+    {
+        Level level;
+        std::string text;
+        std::string types;
+    };
+
+    // `path` rotates to path.1 ... path.<files> once it exceeds maxBytes.
+    BinLog(std::string path, size_t maxBytes, size_t files)
+        : path_(tagged(std::move(path))), maxBytes_(maxBytes), files_(files)
+    {
+        openFile();
+        flusher_ = std::thread([this] { run(); });
+    }
+
+    ~BinLog()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_one();
+        flusher_.join();
+        if (file_) std::fclose(file_);
+    }
+
+    BinLog(const BinLog &) = delete;
+    BinLog &operator=(const BinLog &) = delete;
+
+    // Call before any BinLog is created.
+    static void setProcessTag(std::string tag) { processTag() = std::move(tag); }
+
+    // The file a BinLog created with `path` writes to.
+    static std::string tagged(std::string path)
+    {
+        const std::string &tag = processTag();
+        if (tag.empty()) return path;
+        size_t slash = path.find_last_of('/');
+        size_t dot = path.find_last_of('.');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = path.size();
+        return path.insert(dot, "." + tag);
+    }
+
+    // Registers a call site's format; ids are process-wide.
+    static uint32_t intern(Level level, const char *text, const char *types)
+    {
+        std::lock_guard<std::mutex> lock(formatsMutex());
+        formats().push_back(Format{level, text, types});
+        return static_cast<uint32_t>(formats().size() - 1);
+    }
+
+    // Type codes for an argument pack, one static string per pack.
+    template <typename... Args>
+    static const char *typesOf(const Args &...)
+    {
+        static const char codes[] = {typeCode<Args>()..., '\0'};
+        return codes;
+    }
+
+    template <typename... Args>
+    void write(uint32_t id, const Args &...args)
+    {
+        auto now = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (id >= defined_.size() || !defined_[id])
+            define(id);
+        buffer_.push_back('R');
+        put(id);
+        put(now);
+        (encode(args), ...);
+        if (buffer_.size() >= kFlushBytes)
+            cv_.notify_one();
+    }
+
+    // Writes out everything logged so far. The buffer is swapped out under
+    // mutex_ and written outside it, so write() never waits on the disk.
+    void flush()
+    {
+        std::lock_guard<std::mutex> io(ioMutex_);
+        if (!file_) return;
+        bool full = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (buffer_.empty()) return;
+            buffer_.swap(spare_);
+            // Records logged from here on go to the next file, which has to
+            // define their formats again.
+            full = written_ + spare_.size() >= maxBytes_ && files_ > 0;
+            if (full) defined_.assign(defined_.size(), false);
+        }
+        written_ += std::fwrite(spare_.data(), 1, spare_.size(), file_);
+        std::fflush(file_);
+        spare_.clear();
+        if (full)
+            rotate();
+    }
+
+private:
+    static constexpr size_t kFlushBytes = 64 * 1024;
+    static constexpr auto kFlushInterval = std::chrono::milliseconds(200);
+
+    template <typename T>
+    static constexpr char typeCode()
+    {
+        using U = std::decay_t<T>;
+        if constexpr (std::is_same_v<U, bool>) return 'b';
+        else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) return 'i';
+        else if constexpr (std::is_integral_v<U>) return 'u';
+        else if constexpr (std::is_floating_point_v<U>) return 'd';
+        else if constexpr (std::is_enum_v<U>) return 'i';
+        else
+        {
+            static_assert(std::is_convertible_v<const T &, std::string_view>, "unsupported BinLog argument type");
+            return 's';
+        }
+    }
+
+    template <typename T>
+    void put(T v)
+    {
+        buffer_.append(reinterpret_cast<const char *>(&v), sizeof(v));
+    }
+
+    template <typename T>
+    void encode(const T &v)
+    {
+        constexpr char c = typeCode<T>();
+        if constexpr (c == 'b') put(static_cast<uint8_t>(v));
+        else if constexpr (c == 'i') put(static_cast<int64_t>(v));
+        else if constexpr (c == 'u') put(static_cast<uint64_t>(v));
+        else if constexpr (c == 'd') put(static_cast<double>(v));
+        else
+        {
+            std::string_view s(v);
+            put(static_cast<uint32_t>(s.size()));
+            buffer_.append(s.data(), s.size());
+        }
+    }
+
+    void define(uint32_t id)
+    {
+        Format f;
+        {
+            std::lock_guard<std::mutex> lock(formatsMutex());
+            f = formats()[id];
+        }
+        if (defined_.size() <= id) defined_.resize(id + 1, false);
+        defined_[id] = true;
+        buffer_.push_back('F');
+        put(id);
+        put(static_cast<uint8_t>(f.level));
+        put(static_cast<uint8_t>(f.types.size()));
+        put(static_cast<uint16_t>(f.text.size()));
+        buffer_.append(f.text);
+        buffer_.append(f.types);
+    }
+
+    void openFile()
+    {
+        file_ = std::fopen(path_.c_str(), "ab");
+        if (!file_) return;
+        written_ = static_cast<size_t>(std::ftell(file_));
+        // Each open starts a fresh segment with its own header and formats;
+        // the decoder accepts a header in the middle of a file.
+        auto wall = std::chrono::system_clock::now().time_since_epoch();
+        auto steady = std::chrono::steady_clock::now().time_since_epoch();
+        int64_t offset = std::chrono::duration_cast<std::chrono::nanoseconds>(wall).count() -
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(steady).count();
+        std::string header(kMagic, sizeof(kMagic));
+        header.append(reinterpret_cast<const char *>(&offset), sizeof(offset));
+        written_ += std::fwrite(header.data(), 1, header.size(), file_);
+    }
+
+    void rotate()
+    {
+        std::fclose(file_);
+        file_ = nullptr;
+        for (size_t i = files_; i > 0; --i)
+        {
+            std::string from = i == 1 ? path_ : path_ + "." + std::to_string(i - 1);
+            std::rename(from.c_str(), (path_ + "." + std::to_string(i)).c_str());
+        }
+        openFile();
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_)
+        {
+            cv_.wait_for(lock, kFlushInterval, [this] { return stopping_ || buffer_.size() >= kFlushBytes; });
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+        lock.unlock();
+        flush();
+    }
+
+    static std::string &processTag()
+    {
+        static std::string tag;
+        return tag;
+    }
+
+    static std::vector<Format> &formats()
+    {
+        static std::vector<Format> f;
+        return f;
+    }
+
+    static std::mutex &formatsMutex()
+    {
+        static std::mutex m;
+        return m;
+    }
+
+    std::string path_;
+    size_t maxBytes_;
+    size_t files_;
+
+    std::mutex ioMutex_; // file_, written_, spare_
+    std::FILE *file_ = nullptr;
+    size_t written_ = 0;
+    std::string spare_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::string buffer_;
+    std::vector<bool> defined_;
+    bool stopping_ = false;
+    std::thread flusher_;
+};
+
+#define BINLOG_AT(log, level, fmt, ...)                                                          \
+    do                                                                                           \
+    {                                                                                            \
+        static const uint32_t binlog_id_ = BinLog::intern(level, fmt, BinLog::typesOf(__VA_ARGS__)); \
+        (log).write(binlog_id_, __VA_ARGS__);                                                    \
+    } while (0)
+
+#define BINLOG_INFO(log, fmt, ...) BINLOG_AT(log, BinLog::Level::Info, fmt, __VA_ARGS__)
+#define BINLOG_WARN(log, fmt, ...) BINLOG_AT(log, BinLog::Level::Warn, fmt, __VA_ARGS__)
+#define BINLOG_ERROR(log, fmt, ...) BINLOG_AT(log, BinLog::Level::Error, fmt, __VA_ARGS__)
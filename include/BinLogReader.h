@@ -0,0 +1,194 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "BinLog.h"
+
+// Offline decoder for BinLog files; used by cppAuth_logcat and the log
+// archiver. Feed it a whole file (or a decompressed archive member) and it
+// calls back once per record in file order.
+class BinLogReader
+{
+public:
+    struct Arg
+    {
+        char type;        // see BinLog.h
+        std::string text; // rendered value
+    };
+
+    struct Record
+    {
+        int64_t wallNs;
+        uint8_t level;
+        const std::string &format;
+        std::vector<Arg> args;
+
+        // The format with its "{}" placeholders filled in.
+        std::string message() const
+        {
+            std::string out;
+            size_t next = 0;
+            for (size_t i = 0; i < format.size(); ++i)
+            {
+                if (format[i] == '{' && i + 1 < format.size() && format[i + 1] == '}' && next < args.size())
+                {
+                    out += args[next++].text;
+                    ++i;
+                }
+                else
+                    out += format[i];
+            }
+            return out;
+        }
+    };
+
+    static const char *levelName(uint8_t level)
+    {
+        switch (level)
+        {
+        case 0: return "info";
+        case 1: return "warn";
+        case 2: return "error";
+        }
+        return "unknown";
+    }
+
+    static bool isBinLog(std::string_view data)
+    {
+        return data.size() >= sizeof(BinLog::kMagic) &&
+               std::memcmp(data.data(), BinLog::kMagic, sizeof(BinLog::kMagic)) == 0;
+    }
+
+    explicit BinLogReader(std::string_view data) : data_(data) {}
+
+    // Returns false, with error() set, if the data is truncated or corrupt;
+    // every record before that point has been delivered.
+    bool read(const std::function<void(const Record &)> &onRecord)
+    {
+        while (pos_ < data_.size())
+        {
+            if (data_.compare(pos_, sizeof(BinLog::kMagic), std::string_view(BinLog::kMagic, sizeof(BinLog::kMagic))) == 0)
+            {
+                pos_ += sizeof(BinLog::kMagic);
+                if (!get(offset_)) return fail("truncated header");
+                formats_.clear();
+                continue;
+            }
+            char tag = data_[pos_++];
+            if (tag == 'F')
+            {
+                if (!readFormat()) return false;
+            }
+            else if (tag == 'R')
+            {
+                if (!readRecord(onRecord)) return false;
+            }
+            else
+                return fail("unknown record tag at offset " + std::to_string(pos_ - 1));
+        }
+        return true;
+    }
+
+    const std::string &error() const { return error_; }
+
+private:
+    struct Format
+    {
+        uint8_t level;
+        std::string text;
+        std::string types;
+    };
+
+    bool fail(std::string why)
+    {
+        error_ = std::move(why);
+        return false;
+    }
+
+    template <typename T>
+    bool get(T &v)
+    {
+        if (pos_ + sizeof(T) > data_.size()) return false;
+        std::memcpy(&v, data_.data() + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    bool bytes(size_t n, std::string &out)
+    {
+        if (pos_ + n > data_.size()) return false;
+        out.assign(data_.substr(pos_, n));
+        pos_ += n;
+        return true;
+    }
+
+    bool readFormat()
+    {
+        uint32_t id;
+        uint8_t level, nargs;
+        uint16_t len;
+        Format f;
+        if (!get(id) || !get(level) || !get(nargs) || !get(len) || !bytes(len, f.text) || !bytes(nargs, f.types))
+            return fail("truncated format definition");
+        f.level = level;
+        formats_[id] = std::move(f);
+        return true;
+    }
+
+    bool readRecord(const std::function<void(const Record &)> &onRecord)
+    {
+        uint32_t id;
+        uint64_t steady;
+        if (!get(id) || !get(steady)) return fail("truncated record");
+        auto it = formats_.find(id);
+        if (it == formats_.end())
+            return fail("record with undefined format " + std::to_string(id));
+        const Format &f = it->second;
+
+        Record rec{offset_ + static_cast<int64_t>(steady), f.level, f.text, {}};
+        rec.args.reserve(f.types.size());
+        for (char t : f.types)
+        {
+            Arg a{t, {}};
+            bool ok = true;
+            switch (t)
+            {
+            case 'i': { int64_t v = 0; ok = get(v); a.text = std::to_string(v); break; }
+            case 'u': { uint64_t v = 0; ok = get(v); a.text = std::to_string(v); break; }
+            case 'b': { uint8_t v = 0; ok = get(v); a.text = v ? "true" : "false"; break; }
+            case 'd':
+            {
+                double v = 0;
+                ok = get(v);
+                char buf[32];
+                std::snprintf(buf, sizeof(buf), "%g", v);
+                a.text = buf;
+                break;
+            }
+            case 's':
+            {
+                uint32_t n;
+                ok = get(n) && bytes(n, a.text);
+                break;
+            }
+            default:
+                return fail(std::string("unknown argument type '") + t + "'");
+            }
+            if (!ok) return fail("truncated record");
+            rec.args.push_back(std::move(a));
+        }
+        onRecord(rec);
+        return true;
+    }
+
+    std::string_view data_;
+    size_t pos_ = 0;
+    int64_t offset_ = 0;
+    std::unordered_map<uint32_t, Format> formats_;
+    std::string error_;
+};
@@ -0,0 +1,262 @@
+#pragma once
+#include <cxxabi.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+// Sampling CPU profiler for /debug/pprof/profile.
+//
+// Every thread in the process gets its own CPU-time timer (timer_create on
+// the thread's CPU clock, delivered to that thread with SIGEV_THREAD_ID), so
+// IO loops, DB, hashing and logging threads are all sampled in proportion to
+// the CPU they burn. The SIGPROF handler only copies a backtrace() into a
+// preallocated slot; symbolising and folding happen after the run. Between
+// runs no timer, handler or buffer exists.
+//
+// backtrace() is not formally async-signal-safe: its first call loads
+// libgcc's unwinder, so it is called once before any timer is armed. Threads
+// started during a run are not sampled. stop() waits for handlers still
+// running on other threads before the samples are read or freed.
+class CpuProfiler
+{
+public:
+    static constexpr int kMaxFrames = 32;
+
+    // Only one run at a time; false if one is already going.
+    static bool tryAcquire() { return !instance().busy_.exchange(true); }
+    static void release() { instance().busy_.store(false); }
+
+    // Samples for `seconds` at `hz` per thread-CPU-second and returns the
+    // folded stacks ("thread;outer;...;inner count" per line), ready for
+    // flamegraph.pl. Blocks the calling thread; call with tryAcquire() held.
+    static std::string profile(double seconds, int hz)
+    {
+        CpuProfiler &p = instance();
+        p.start(hz, seconds);
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        p.stop();
+        std::string out = p.fold();
+        p.samples_.reset();
+        return out;
+    }
+
+    // "function" for a code address, or "library+0xoffset" without symbols.
+    static std::string symbol(void *addr)
+    {
+        Dl_info info{};
+        if (dladdr(addr, &info) && info.dli_sname)
+        {
+            int status = 0;
+            char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+            std::free(demangled);
+            return name;
+        }
+        if (info.dli_fname)
+        {
+            const char *base = std::strrchr(info.dli_fname, '/');
+            char buf[64];
+            std::snprintf(buf, sizeof(buf), "+0x%lx",
+                          static_cast<unsigned long>(reinterpret_cast<uintptr_t>(addr) -
+                                                     reinterpret_cast<uintptr_t>(info.dli_fbase)));
+            return std::string(base ? base + 1 : info.dli_fname) + buf;
+        }
+        return "??";
+    }
+
+private:
+    struct Sample
+    {
+        pid_t tid;
+        int depth;
+        void *frames[kMaxFrames];
+    };
+
+    static CpuProfiler &instance()
+    {
+        static CpuProfiler p;
+        return p;
+    }
+
+    static pid_t gettid() { return static_cast<pid_t>(syscall(SYS_gettid)); }
+
+    static void onSignal(int, siginfo_t *, void *)
+    {
+        int saved = errno;
+        CpuProfiler &p = instance();
+        // Counted in before looking at armed_, so stop() either sees this
+        // handler in active_ or this handler sees armed_ cleared.
+        p.active_.fetch_add(1);
+        if (!p.armed_.load())
+        {
+            p.active_.fetch_sub(1);
+            errno = saved;
+            return;
+        }
+        size_t i = p.next_.fetch_add(1, std::memory_order_relaxed);
+        if (i < p.capacity_)
+        {
+            Sample &s = p.samples_[i];
+            s.tid = gettid();
+            s.depth = backtrace(s.frames, kMaxFrames);
+        }
+        else
+            p.dropped_.fetch_add(1, std::memory_order_relaxed);
+        p.active_.fetch_sub(1);
+        errno = saved;
+    }
+
+    static std::vector<pid_t> threads()
+    {
+        std::vector<pid_t> out;
+        if (DIR *d = opendir("/proc/self/task"))
+        {
+            while (dirent *e = readdir(d))
+                if (e->d_name[0] != '.') out.push_back(static_cast<pid_t>(std::atoi(e->d_name)));
+            closedir(d);
+        }
+        return out;
+    }
+
+    void start(int hz, double seconds)
+    {
+        void *warm[4];
+        backtrace(warm, 4);
+
+        auto tids = threads();
+        capacity_ = std::min<size_t>(static_cast<size_t>(hz * seconds * tids.size() * 1.1) + 64, kMaxSamples);
+        samples_.reset(new Sample[capacity_]);
+        next_.store(0);
+        dropped_.store(0);
+        unarmed_ = 0;
+        armed_.store(true);
+
+        struct sigaction sa{};
+        sa.sa_sigaction = onSignal;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGPROF, &sa, nullptr);
+
+        long intervalNs = 1000000000L / hz;
+        itimerspec spec{};
+        spec.it_interval.tv_sec = intervalNs / 1000000000L;
+        spec.it_interval.tv_nsec = intervalNs % 1000000000L;
+        spec.it_value = spec.it_interval;
+        pid_t self = gettid();
+        for (pid_t tid : tids)
+        {
+            if (tid == self) continue; // this thread only sleeps
+            sigevent ev{};
+            ev.sigev_notify = SIGEV_THREAD_ID;
+            ev.sigev_signo = SIGPROF;
+            ev.sigev_notify_thread_id = tid;
+            // The kernel's per-thread CPU clock id: CPUCLOCK_PERTHREAD | CPUCLOCK_SCHED
+            auto clock = static_cast<clockid_t>((~static_cast<unsigned>(tid) << 3) | 6);
+            timer_t timer;
+            if (timer_create(clock, &ev, &timer) != 0) continue; // thread already gone
+            if (timer_settime(timer, 0, &spec, nullptr) != 0)
+            {
+                timer_delete(timer);
+                ++unarmed_;
+                continue;
+            }
+            timers_.push_back(timer);
+        }
+    }
+
+    void stop()
+    {
+        for (timer_t t : timers_)
+            timer_delete(t);
+        timers_.clear();
+        // Ignore rather than restore the default: a signal still queued
+        // would otherwise terminate the process.
+        signal(SIGPROF, SIG_IGN);
+        armed_.store(false);
+        while (active_.load() != 0)
+            std::this_thread::yield();
+    }
+
+    static std::string threadName(pid_t tid)
+    {
+        std::ifstream in("/proc/self/task/" + std::to_string(tid) + "/comm");
+        std::string name;
+        std::getline(in, name);
+        return name.empty() ? "thread-" + std::to_string(tid) : name;
+    }
+
+    std::string fold()
+    {
+        size_t n = std::min(next_.load(), capacity_);
+        std::unordered_map<void *, std::string> symbols;
+        std::unordered_map<pid_t, std::string> names;
+        std::map<std::string, uint64_t> stacks;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            const Sample &s = samples_[i];
+            auto nameIt = names.find(s.tid);
+            if (nameIt == names.end()) nameIt = names.emplace(s.tid, threadName(s.tid)).first;
+            std::string key = nameIt->second;
+            // frames[0] is the handler and frames[1] the signal trampoline
+            for (int f = s.depth - 1; f >= 2; --f)
+            {
+                auto it = symbols.find(s.frames[f]);
+                if (it == symbols.end())
+                {
+                    std::string sym = symbol(s.frames[f]);
+                    for (auto &c : sym)
+                        if (c == ';' || c == ' ') c = '_';
+                    it = symbols.emplace(s.frames[f], std::move(sym)).first;
+                }
+                key += ';';
+                key += it->second;
+            }
+            ++stacks[key];
+        }
+
+        std::string out;
+        for (const auto &[stack, count] : stacks)
+            out += stack + ' ' + std::to_string(count) + '\n';
+        if (uint64_t d = dropped_.load())
+            out += "[dropped] " + std::to_string(d) + '\n';
+        if (unarmed_)
+            out += "[unsampled_threads] " + std::to_string(unarmed_) + '\n';
+        return out;
+    }
+
+    static constexpr size_t kMaxSamples = 50000;
+
+    std::atomic<bool> busy_{false};
+    std::unique_ptr<Sample[]> samples_;
+    size_t capacity_ = 0;
+    std::atomic<size_t> next_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<bool> armed_{false};  // handlers may write samples_
+    std::atomic<int> active_{0};      // handlers currently running
+    size_t unarmed_ = 0;              // threads whose timer could not be set
+    std::vector<timer_t> timers_;
+};
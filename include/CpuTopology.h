@@ -0,0 +1,129 @@
+#pragma once
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+// How the cores this process may run on are split between IO loops, the
+// password-hashing pool and the logging thread. Built from env:
+//
+//   THREAD_NUM    IO loop count, "auto"/0 = every core left after the pools
+//   HASH_THREADS  bcrypt workers (default: cores / 8, at least 1)
+//   LOG_THREADS   async log writer threads (default 1)
+//   CPU_PINNING   1 to pin each group to its own cores (default 0)
+//   WORKERS       SO_REUSEPORT worker processes (default 1); each worker gets
+//                 an equal, disjoint slice of the cores
+//
+// With pinning on the three groups never share a core. If a slice is too
+// small to give each group its own core the pools are left unpinned.
+struct CpuLayout
+{
+    size_t ioThreads = 1;
+    size_t hashThreads = 1;
+    size_t logThreads = 1;
+    bool pinning = false;
+    std::vector<int> ioCpus;
+    std::vector<int> hashCpus;
+    std::vector<int> logCpus;
+
+    static std::vector<int> availableCpus()
+    {
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        {
+            for (int i = 0; i < CPU_SETSIZE; ++i)
+                if (CPU_ISSET(i, &set))
+                    cpus.push_back(i);
+        }
+        if (cpus.empty())
+        {
+            unsigned n = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned i = 0; i < n; ++i)
+                cpus.push_back(static_cast<int>(i));
+        }
+        return cpus;
+    }
+
+    static size_t envSize(const char *name, size_t fallback)
+    {
+        const char *v = std::getenv(name);
+        if (!v || !*v || std::string(v) == "auto")
+            return fallback;
+        long n = std::atol(v);
+        return n > 0 ? static_cast<size_t>(n) : fallback;
+    }
+
+    static size_t workerCount()
+    {
+        return envSize("WORKERS", 1);
+    }
+
+    // Layout for worker `worker` of `workers` processes.
+    static CpuLayout fromEnv(size_t worker = 0, size_t workers = 1)
+    {
+        auto all = availableCpus();
+        workers = std::max<size_t>(1, std::min(workers, all.size()));
+        size_t per = all.size() / workers;
+        size_t begin = (worker % workers) * per;
+        std::vector<int> slice(all.begin() + begin, all.begin() + begin + per);
+
+        CpuLayout l;
+        l.pinning = std::getenv("CPU_PINNING") && std::string(std::getenv("CPU_PINNING")) == "1";
+        l.hashThreads = envSize("HASH_THREADS", std::max<size_t>(1, slice.size() / 8));
+        l.logThreads = envSize("LOG_THREADS", 1);
+
+        size_t reserved = l.hashThreads + l.logThreads;
+        size_t ioCores = slice.size() > reserved ? slice.size() - reserved : 0;
+        l.ioThreads = envSize("THREAD_NUM", std::max<size_t>(1, ioCores));
+
+        if (ioCores == 0)
+        {
+            // Not enough cores for disjoint groups; pin only the IO loops.
+            l.ioCpus = slice;
+            return l;
+        }
+        l.ioCpus.assign(slice.begin(), slice.begin() + ioCores);
+        l.hashCpus.assign(slice.begin() + ioCores, slice.begin() + ioCores + l.hashThreads);
+        l.logCpus.assign(slice.begin() + ioCores + l.hashThreads, slice.end());
+        return l;
+    }
+
+    std::string describe() const
+    {
+        auto list = [](const std::vector<int> &v) {
+            std::string s;
+            for (size_t i = 0; i < v.size(); ++i)
+                s += (i ? "," : "") + std::to_string(v[i]);
+            return s.empty() ? std::string("-") : s;
+        };
+        return "io=" + std::to_string(ioThreads) + "[" + list(ioCpus) + "]" +
+               " hash=" + std::to_string(hashThreads) + "[" + list(hashCpus) + "]" +
+               " log=" + std::to_string(logThreads) + "[" + list(logCpus) + "]" +
+               (pinning ? " pinned" : " unpinned");
+    }
+};
+
+// Pins the calling thread to one core out of `cpus` (round-robin on `index`),
+// or to the whole set when `index` is negative. No-op on an empty set.
+inline bool pinCurrentThread(const std::vector<int> &cpus, int index = -1)
+{
+    if (cpus.empty())
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (index < 0)
+    {
+        for (int c : cpus)
+            CPU_SET(c, &set);
+    }
+    else
+    {
+        CPU_SET(cpus[static_cast<size_t>(index) % cpus.size()], &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
@@ -10,14 +10,16 @@ public:
     explicit DbLoggerJSON(drogon::orm::DbClientPtr client)
         : client_(client) {}
 
+    // Callbacks are taken by value and moved into the wrappers, so each is
+    // stored once instead of copied at every layer.
     void execSqlAsync(const std::string &sql,
-                      const drogon::orm::ResultCallback &rcb,
-                      const drogon::orm::ExceptionCallback &ecb = nullptr)
+                      drogon::orm::ResultCallback rcb,
+                      drogon::orm::ExceptionCallback ecb = nullptr)
     {
         auto start = std::chrono::steady_clock::now();
         auto req = drogon::app().getCurrentHttpRequest();
 
-        auto wrappedRcb = [req, start, sql, rcb](const drogon::orm::Result &r) {
+        auto wrappedRcb = [req, start, sql, rcb = std::move(rcb)](const drogon::orm::Result &r) {
             auto end = std::chrono::steady_clock::now();
             auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
             if (req)
@@ -28,7 +30,7 @@ public:
             rcb(r);
         };
 
-        auto wrappedEcb = [req, start, sql, ecb](const drogon::orm::DrogonDbException &ex) {
+        auto wrappedEcb = [req, start, sql, ecb = std::move(ecb)](const drogon::orm::DrogonDbException &ex) {
             auto end = std::chrono::steady_clock::now();
             auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
             if (req)
@@ -40,7 +42,7 @@ public:
                 ecb(ex);
         };
 
-        client_->execSqlAsync(sql, wrappedRcb, wrappedEcb);
+        client_->execSqlAsync(sql, std::move(wrappedRcb), std::move(wrappedEcb));
     }
 
     drogon::orm::Result execSqlSync(const std::string &sql)
@@ -0,0 +1,207 @@
+#pragma once
+#include <drogon/orm/DbClient.h>
+#include <drogon/orm/Exception.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SqlFingerprint.h"
+#include "SqliteWriteBatcher.h"
+
+// One finished statement, as seen by a QueryObserver. The fingerprint and
+// paramTypes live for the whole process and may be kept.
+struct QueryEvent
+{
+    const SqlFingerprint::Entry *fingerprint;
+    const std::string &paramTypes;
+    std::chrono::nanoseconds elapsed;
+    size_t rows;
+    const char *error; // nullptr on success
+};
+
+// Hooks statements run through DbRouter::exec(). Called on the DB callback
+// thread before the caller's own callback, so implementations must be cheap
+// and thread-safe.
+class QueryObserver
+{
+public:
+    virtual ~QueryObserver() = default;
+    virtual void onQuery(const QueryEvent &event) = 0;
+};
+
+// Decides which DB client a statement goes to. By default a single client
+// serves everything, which is how Postgres deployments run. In SQLite
+// concurrent mode (see SqliteTuning.h), reads go to a pool of read-only WAL
+// connections and writes are funnelled through one group-committing writer.
+//
+// The read pool may be several clients (one connection each, so each can be
+// configured on its own); reader() then takes the next one with an idle
+// connection, round-robin.
+class DbRouter
+{
+public:
+    explicit DbRouter(drogon::orm::DbClientPtr client)
+        : writer_(client), readers_{std::move(client)} {}
+
+    DbRouter(drogon::orm::DbClientPtr writer,
+             drogon::orm::DbClientPtr readers,
+             std::shared_ptr<SqliteWriteBatcher> batcher)
+        : writer_(std::move(writer)), readers_{std::move(readers)}, batcher_(std::move(batcher)) {}
+
+    DbRouter(drogon::orm::DbClientPtr writer,
+             std::vector<drogon::orm::DbClientPtr> readers,
+             std::shared_ptr<SqliteWriteBatcher> batcher)
+        : writer_(std::move(writer)), readers_(std::move(readers)), batcher_(std::move(batcher)) {}
+
+    const drogon::orm::DbClientPtr &writer() const { return writer_; }
+
+    const drogon::orm::DbClientPtr &reader() const
+    {
+        if (readers_.size() == 1)
+            return readers_[0];
+        size_t start = nextReader_.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i < readers_.size(); ++i)
+        {
+            const auto &client = readers_[(start + i) % readers_.size()];
+            if (client->hasAvailableConnections())
+                return client;
+        }
+        return readers_[start % readers_.size()];
+    }
+
+    // Observers are registered at startup, before any query runs, and are
+    // never removed; with none registered exec() adds nothing to a query.
+    static void addObserver(std::shared_ptr<QueryObserver> observer)
+    {
+        observers().push_back(std::move(observer));
+    }
+
+    // execSqlAsync() on a client or transaction, timed and reported to the
+    // observers. Statements inside transaction() should go through here too.
+    template <typename Client, typename... Args>
+    static void exec(const std::shared_ptr<Client> &client,
+                     const std::string &sql,
+                     drogon::orm::ResultCallback rcb,
+                     drogon::orm::ExceptionCallback ecb,
+                     Args &&...args)
+    {
+        if (observers().empty())
+        {
+            client->execSqlAsync(sql, std::move(rcb), std::move(ecb), std::forward<Args>(args)...);
+            return;
+        }
+        static const std::string types = SqlFingerprint::paramTypes<std::decay_t<Args>...>();
+        const SqlFingerprint::Entry *fp = SqlFingerprint::of(sql);
+        auto start = std::chrono::steady_clock::now();
+        client->execSqlAsync(
+            sql,
+            [fp, start, rcb = std::move(rcb)](const drogon::orm::Result &r) {
+                notify(fp, types, start, r.size(), nullptr);
+                rcb(r);
+            },
+            [fp, start, ecb = std::move(ecb)](const drogon::orm::DrogonDbException &e) {
+                notify(fp, types, start, 0, e.base().what());
+                if (ecb) ecb(e);
+            },
+            std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    void read(const std::string &sql,
+              drogon::orm::ResultCallback rcb,
+              drogon::orm::ExceptionCallback ecb,
+              Args &&...args)
+    {
+        exec(reader(), sql, std::move(rcb), std::move(ecb), std::forward<Args>(args)...);
+    }
+
+    // A single write statement. Through the batcher, `rcb` only fires once
+    // the group commit holding this statement has committed.
+    template <typename... Args>
+    void write(const std::string &sql,
+               drogon::orm::ResultCallback rcb,
+               drogon::orm::ExceptionCallback ecb,
+               Args &&...args)
+    {
+        if (!batcher_)
+        {
+            exec(writer_, sql, std::move(rcb), std::move(ecb), std::forward<Args>(args)...);
+            return;
+        }
+
+        struct State
+        {
+            drogon::orm::Result result{nullptr};
+            bool failed = false;
+        };
+        auto state = std::make_shared<State>();
+        WriteOp op;
+        op.work = [sql, state, ecb, args...](const TransactionPtr &trans, std::function<void(bool)> finish) {
+            exec(
+                trans,
+                sql,
+                [state, finish](const drogon::orm::Result &r) {
+                    state->result = r;
+                    finish(true);
+                },
+                [state, ecb, finish](const drogon::orm::DrogonDbException &e) {
+                    state->failed = true;
+                    if (ecb) ecb(e);
+                    finish(false);
+                },
+                args...);
+        };
+        op.done = [state, rcb = std::move(rcb), ecb](bool committed) {
+            if (committed)
+                rcb(state->result);
+            else if (!state->failed && ecb)
+                ecb(drogon::orm::Failure("write batch was not committed"));
+        };
+        batcher_->submit(std::move(op));
+    }
+
+    // Multi-statement write. `work` gets the transaction and must call
+    // finish(true) to commit or finish(false) to roll back; `done` reports
+    // whether the changes are durable.
+    void transaction(std::function<void(const TransactionPtr &, std::function<void(bool)>)> work,
+                     std::function<void(bool)> done)
+    {
+        if (batcher_)
+        {
+            batcher_->submit(WriteOp{std::move(work), std::move(done)});
+            return;
+        }
+        writer_->newTransactionAsync([work = std::move(work), done = std::move(done)](const TransactionPtr &trans) {
+            trans->setCommitCallback(done);
+            work(trans, [trans, done](bool commit) {
+                if (!commit)
+                {
+                    trans->rollback();
+                    done(false);
+                }
+            });
+        });
+    }
+
+private:
+    static std::vector<std::shared_ptr<QueryObserver>> &observers()
+    {
+        static std::vector<std::shared_ptr<QueryObserver>> list;
+        return list;
+    }
+
+    static void notify(const SqlFingerprint::Entry *fp, const std::string &types,
+                       std::chrono::steady_clock::time_point start, size_t rows, const char *error)
+    {
+        QueryEvent event{fp, types, std::chrono::steady_clock::now() - start, rows, error};
+        for (auto &o : observers())
+            o->onQuery(event);
+    }
+
+    drogon::orm::DbClientPtr writer_;
+    std::vector<drogon::orm::DbClientPtr> readers_;
+    mutable std::atomic<size_t> nextReader_{0};
+    std::shared_ptr<SqliteWriteBatcher> batcher_;
+};
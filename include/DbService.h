@@ -11,10 +11,10 @@ public:
         : dbLogger_(client) {}
 
     void execSqlAsync(const std::string &sql,
-                      const drogon::orm::ResultCallback &rcb,
-                      const drogon::orm::ExceptionCallback &ecb = nullptr)
+                      drogon::orm::ResultCallback rcb,
+                      drogon::orm::ExceptionCallback ecb = nullptr)
     {
-        dbLogger_.execSqlAsync(sql, rcb, ecb);
+        dbLogger_.execSqlAsync(sql, std::move(rcb), std::move(ecb));
     }
 
     drogon::orm::Result execSqlSync(const std::string &sql)
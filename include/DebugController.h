@@ -0,0 +1,57 @@
+#pragma once
+#include <drogon/HttpController.h>
+#include <memory>
+#include "AdmissionControl.h"
+#include "SingleFlight.h"
+#include "SqlStats.h"
+#include "TlsSessions.h"
+
+using namespace drogon;
+
+// Introspection endpoints; same X-Admin-Token guard as /admin.
+class DebugController : public drogon::HttpController<DebugController, false> {
+public:
+    explicit DebugController(std::shared_ptr<SqlStats> sqlStats = nullptr,
+                             std::shared_ptr<AdmissionControl> admission = nullptr,
+                             std::shared_ptr<SingleFlight> flights = nullptr,
+                             std::shared_ptr<TlsSessions> tls = nullptr)
+        : sqlStats_(std::move(sqlStats)), admission_(std::move(admission)), flights_(std::move(flights)),
+          tls_(std::move(tls)) {}
+
+    METHOD_LIST_BEGIN
+    ADD_METHOD_TO(DebugController::allocations, "/debug/allocs", Get, "AdminFilter");
+    ADD_METHOD_TO(DebugController::sql, "/debug/sql", Get, "AdminFilter");
+    ADD_METHOD_TO(DebugController::profile, "/debug/pprof/profile", Get, "AdminFilter");
+    ADD_METHOD_TO(DebugController::loops, "/debug/loops", Get, "AdminFilter");
+    ADD_METHOD_TO(DebugController::admission, "/debug/admission", Get, "AdminFilter");
+    ADD_METHOD_TO(DebugController::singleflight, "/debug/singleflight", Get, "AdminFilter");
+    ADD_METHOD_TO(DebugController::tls, "/debug/tls", Get, "AdminFilter");
+    METHOD_LIST_END
+
+    // Heap allocations since start, and per completed request
+    void allocations(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
+
+    // Top statement fingerprints; ?sort=total|count|mean|max|rows|errors&limit=N
+    void sql(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
+
+    // CPU profile of all threads as folded stacks; ?seconds=30&hz=99
+    void profile(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
+
+    // Timer lateness per IO loop, in microseconds, and stall counts
+    void loops(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
+
+    // Current concurrency limits, in-flight and shed counts per route group
+    void admission(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
+
+    // Balance/profile reads that ran a query vs. joined one already in flight
+    void singleflight(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
+
+    // TLS handshakes of this worker, full vs. resumed, and session-ticket use
+    void tls(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
+
+private:
+    std::shared_ptr<SqlStats> sqlStats_;
+    std::shared_ptr<AdmissionControl> admission_;
+    std::shared_ptr<SingleFlight> flights_;
+    std::shared_ptr<TlsSessions> tls_;
+};
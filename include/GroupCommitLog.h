@@ -0,0 +1,369 @@
+#pragma once
+#include <fcntl.h>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Append-only journal with group commit.
+//
+// Records are framed as [u32 length][u32 crc32][payload] in numbered segment
+// files <dir>/<prefix>.<n>.log. One writer thread takes everything appended
+// since its last write, writes it with a single write() and fdatasync(), and
+// only then runs the completions, so N concurrent appends cost one sync.
+// A torn tail (crash mid-write) fails its CRC and is cut off by replay().
+//
+// A failed write or sync is cut back off the segment (or, if that fails
+// too, left behind by moving on to a new segment), so later records never
+// follow a partial one. With setStopOnError() the log instead fails every
+// record after the first error; an owner whose records depend on earlier
+// ones (after-images) needs that.
+//
+// rotate() starts a new segment; dropBefore() deletes old ones once their
+// contents are safe elsewhere. The observer sees every record in file order
+// on the writer thread, which lets the owner keep state that a rotation has
+// to carry into the next segment.
+class GroupCommitLog
+{
+public:
+    using Completion = std::function<void(bool ok)>;
+    using Observer = std::function<void(std::string_view payload)>;
+    using Carry = std::function<std::vector<std::string>()>;
+
+    GroupCommitLog(std::string dir, std::string prefix)
+        : dir_(std::move(dir)), prefix_(std::move(prefix)) {}
+
+    ~GroupCommitLog() { stop(); }
+
+    static uint32_t crc32(std::string_view data)
+    {
+        static const auto table = [] {
+            std::vector<uint32_t> t(256);
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+        uint32_t c = 0xFFFFFFFFu;
+        for (unsigned char b : data)
+            c = table[(c ^ b) & 0xFF] ^ (c >> 8);
+        return c ^ 0xFFFFFFFFu;
+    }
+
+    static void frame(std::string &out, std::string_view payload)
+    {
+        uint32_t len = static_cast<uint32_t>(payload.size());
+        uint32_t crc = crc32(payload);
+        out.append(reinterpret_cast<const char *>(&len), 4);
+        out.append(reinterpret_cast<const char *>(&crc), 4);
+        out.append(payload);
+    }
+
+    // Segment numbers present on disk, oldest first.
+    std::vector<uint64_t> segments() const
+    {
+        std::vector<uint64_t> out;
+        std::error_code ec;
+        for (const auto &entry : std::filesystem::directory_iterator(dir_, ec))
+        {
+            std::string name = entry.path().filename().string();
+            unsigned long long n = 0;
+            char tail[8] = {};
+            if (name.compare(0, prefix_.size() + 1, prefix_ + ".") == 0 &&
+                std::sscanf(name.c_str() + prefix_.size() + 1, "%llu.%3s", &n, tail) == 2 &&
+                std::strcmp(tail, "log") == 0)
+                out.push_back(n);
+        }
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+
+    // Feeds every intact record of every segment to `fn`, oldest first, and
+    // truncates a torn tail. Call before open().
+    size_t replay(const std::function<void(std::string_view)> &fn) const
+    {
+        size_t records = 0;
+        for (uint64_t seg : segments())
+        {
+            std::string path = segmentPath(seg);
+            FILE *f = std::fopen(path.c_str(), "rb");
+            if (!f)
+                continue;
+            std::string payload;
+            long good = 0;
+            for (;;)
+            {
+                uint32_t hdr[2];
+                if (std::fread(hdr, 4, 2, f) != 2)
+                    break;
+                payload.resize(hdr[0]);
+                if (hdr[0] && std::fread(payload.data(), 1, hdr[0], f) != hdr[0])
+                    break;
+                if (crc32(payload) != hdr[1])
+                    break;
+                fn(payload);
+                ++records;
+                good = std::ftell(f);
+            }
+            bool torn = !std::feof(f) || std::ftell(f) != good;
+            std::fclose(f);
+            if (torn)
+            {
+                spdlog::warn("Journal {} has a torn tail, truncating at byte {}", path, good);
+                if (::truncate(path.c_str(), good) != 0)
+                    spdlog::error("Could not truncate {}: {}", path, std::strerror(errno));
+            }
+        }
+        return records;
+    }
+
+    void setObserver(Observer observer) { observer_ = std::move(observer); }
+
+    // Call before open().
+    void setStopOnError(bool stop) { stopOnError_ = stop; }
+
+    // Opens a fresh segment after the existing ones and starts the writer.
+    void open()
+    {
+        std::filesystem::create_directories(dir_);
+        auto segs = segments();
+        uint64_t seg = segs.empty() ? 1 : segs.back() + 1;
+        if (!switchTo(seg))
+            throw std::runtime_error("cannot open journal " + segmentPath(seg) + ": " + std::strerror(errno));
+        running_ = true;
+        writer_ = std::thread([this] { run(); });
+    }
+
+    void append(std::string payload, Completion done)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.push_back(Item{std::move(payload), std::move(done), nullptr, nullptr, false});
+        }
+        cv_.notify_one();
+    }
+
+    // `done(ok)` once every record appended before it is on disk. Only says
+    // something about earlier batches with setStopOnError().
+    void sync(Completion done)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.push_back(Item{{}, std::move(done), nullptr, nullptr, true});
+        }
+        cv_.notify_one();
+    }
+
+    // Starts a new segment whose first records are `carry()`, computed on the
+    // writer thread. `rotated(n)` runs once segment n is durable; every
+    // record appended before this call is in a segment older than n.
+    // `rotated(0)` means no new segment could be started.
+    void rotate(Carry carry, std::function<void(uint64_t)> rotated)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.push_back(Item{{}, nullptr, std::move(carry), std::move(rotated), false});
+        }
+        cv_.notify_one();
+    }
+
+    void dropBefore(uint64_t segment)
+    {
+        for (uint64_t seg : segments())
+            if (seg < segment)
+                std::filesystem::remove(segmentPath(seg));
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_)
+                return;
+            running_ = false;
+        }
+        cv_.notify_one();
+        if (writer_.joinable())
+            writer_.join();
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = -1;
+    }
+
+private:
+    struct Item
+    {
+        std::string payload;
+        Completion done;
+        Carry carry;                          // set for a rotation marker
+        std::function<void(uint64_t)> rotated;
+        bool barrier;                         // sync(): no payload, only `done`
+    };
+
+    std::string dir_;
+    std::string prefix_;
+    Observer observer_;
+    uint64_t segment_ = 0;
+    int fd_ = -1;
+    off_t offset_ = 0;        // end of the last record known to be on disk
+    bool broken_ = false;     // a write failed and has not been cut off yet
+    bool stopOnError_ = false;
+    bool failed_ = false;     // stopOnError_ and a write failed
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Item> pending_;
+    bool running_ = false;
+    std::thread writer_;
+
+    std::string segmentPath(uint64_t seg) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), ".%08llu.log", static_cast<unsigned long long>(seg));
+        return dir_ + "/" + prefix_ + name;
+    }
+
+    // Makes segment `seg` the one appended to. On failure the current one
+    // stays open and errno is set.
+    bool switchTo(uint64_t seg)
+    {
+        std::string path = segmentPath(seg);
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+        if (fd < 0)
+            return false;
+        off_t end = ::lseek(fd, 0, SEEK_END);
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = fd;
+        segment_ = seg;
+        offset_ = end < 0 ? 0 : end;
+        return true;
+    }
+
+    // After a failed write: cut the segment back to the last good record, or
+    // move on to a new segment if the file cannot be truncated.
+    bool recover()
+    {
+        if (!broken_)
+            return true;
+        if (::ftruncate(fd_, offset_) == 0 && ::fdatasync(fd_) == 0)
+        {
+            broken_ = false;
+            return true;
+        }
+        spdlog::error("Cannot truncate journal segment {}: {}", segment_, std::strerror(errno));
+        if (switchTo(segment_ + 1))
+        {
+            broken_ = false;
+            return true;
+        }
+        spdlog::error("Cannot start journal segment {}: {}", segment_ + 1, std::strerror(errno));
+        return false;
+    }
+
+    bool writeAll(const std::string &buf)
+    {
+        size_t off = 0;
+        while (off < buf.size())
+        {
+            ssize_t n = ::write(fd_, buf.data() + off, buf.size() - off);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            off += static_cast<size_t>(n);
+        }
+        return ::fdatasync(fd_) == 0;
+    }
+
+    // Writes the buffered records and runs their completions.
+    bool commit(std::string &buf, std::vector<Completion> &waiting)
+    {
+        if (waiting.empty() && buf.empty())
+            return true;
+        bool ok = !failed_ && recover() && writeAll(buf);
+        if (ok)
+        {
+            offset_ += static_cast<off_t>(buf.size());
+        }
+        else if (!failed_)
+        {
+            spdlog::error("Journal write failed: {}", std::strerror(errno));
+            broken_ = true;
+            recover();
+            failed_ = stopOnError_;
+        }
+        buf.clear();
+        for (auto &done : waiting)
+            if (done)
+                done(ok);
+        waiting.clear();
+        return ok;
+    }
+
+    void run()
+    {
+        std::vector<Item> batch;
+        std::vector<Completion> waiting;
+        std::string buf;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return !pending_.empty() || !running_; });
+                if (pending_.empty() && !running_)
+                    return;
+                batch.swap(pending_);
+            }
+            for (auto &item : batch)
+            {
+                if (item.barrier)
+                {
+                    waiting.push_back(std::move(item.done));
+                    continue;
+                }
+                if (item.carry)
+                {
+                    commit(buf, waiting);
+                    bool ok = !failed_ && switchTo(segment_ + 1);
+                    if (!ok)
+                        spdlog::error("Cannot rotate journal: {}", failed_ ? "an earlier write failed"
+                                                                           : std::strerror(errno));
+                    if (ok)
+                    {
+                        for (const auto &rec : item.carry())
+                            frame(buf, rec);
+                        ok = commit(buf, waiting);
+                    }
+                    if (item.rotated)
+                        item.rotated(ok ? segment_ : 0);
+                    continue;
+                }
+                frame(buf, item.payload);
+                if (observer_)
+                    observer_(item.payload);
+                waiting.push_back(std::move(item.done));
+            }
+            batch.clear();
+            commit(buf, waiting);
+        }
+    }
+};
@@ -0,0 +1,144 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// Log-linear latency histogram in the style of HdrHistogram: values are
+// bucketed by power of two, and each power of two is split into 2^(bits-1)
+// linear sub-buckets, so every recorded value keeps ~bits-1 significant
+// binary digits (bits = 7 gives < 1% relative error). Memory is fixed up
+// front and record() is a couple of shifts plus a relaxed atomic add, so it
+// can sit on hot paths and be read concurrently.
+class HdrHistogram
+{
+public:
+    explicit HdrHistogram(uint64_t highestTrackable = 3600ULL * 1000 * 1000, int subBucketBits = 7)
+        : bits_(subBucketBits),
+          half_(1ULL << (subBucketBits - 1)),
+          size_(indexOf(std::max<uint64_t>(highestTrackable, 2ULL << subBucketBits)) + 1),
+          highest_(highestTrackable),
+          counts_(new std::atomic<uint64_t>[size_])
+    {
+        reset();
+    }
+
+    HdrHistogram(const HdrHistogram &other)
+        : HdrHistogram(other.highest_, other.bits_)
+    {
+        merge(other);
+    }
+
+    HdrHistogram &operator=(const HdrHistogram &) = delete;
+
+    void record(uint64_t value, uint64_t n = 1)
+    {
+        value = std::min(value, highest_);
+        counts_[indexOf(value)].fetch_add(n, std::memory_order_relaxed);
+        total_.fetch_add(n, std::memory_order_relaxed);
+        sum_.fetch_add(value * n, std::memory_order_relaxed);
+        uint64_t cur = max_.load(std::memory_order_relaxed);
+        while (value > cur && !max_.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+        cur = min_.load(std::memory_order_relaxed);
+        while (value < cur && !min_.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+    }
+
+    void merge(const HdrHistogram &other)
+    {
+        for (size_t i = 0; i < other.size_; ++i)
+        {
+            uint64_t c = other.counts_[i].load(std::memory_order_relaxed);
+            if (c)
+                record(other.highestEquivalent(i), c);
+        }
+    }
+
+    void reset()
+    {
+        for (size_t i = 0; i < size_; ++i)
+            counts_[i].store(0, std::memory_order_relaxed);
+        total_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+        min_.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return total_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    uint64_t min() const
+    {
+        uint64_t m = min_.load(std::memory_order_relaxed);
+        return m == std::numeric_limits<uint64_t>::max() ? 0 : m;
+    }
+    double mean() const
+    {
+        uint64_t n = count();
+        return n ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / n : 0.0;
+    }
+
+    // Smallest recorded value such that `percentile` % of samples are <= it
+    // (reported as the top of its bucket, like HdrHistogram does).
+    uint64_t valueAtPercentile(double percentile) const
+    {
+        uint64_t n = count();
+        if (n == 0)
+            return 0;
+        percentile = std::min(std::max(percentile, 0.0), 100.0);
+        uint64_t target = static_cast<uint64_t>(percentile / 100.0 * n + 0.5);
+        target = std::max<uint64_t>(1, std::min(target, n));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < size_; ++i)
+        {
+            seen += counts_[i].load(std::memory_order_relaxed);
+            if (seen >= target)
+                return std::min(highestEquivalent(i), max());
+        }
+        return max();
+    }
+
+    // (value, count) for every non-empty bucket, for exporting the shape.
+    std::vector<std::pair<uint64_t, uint64_t>> buckets() const
+    {
+        std::vector<std::pair<uint64_t, uint64_t>> out;
+        for (size_t i = 0; i < size_; ++i)
+        {
+            uint64_t c = counts_[i].load(std::memory_order_relaxed);
+            if (c)
+                out.emplace_back(highestEquivalent(i), c);
+        }
+        return out;
+    }
+
+private:
+    int bits_;
+    uint64_t half_;
+    size_t size_;
+    uint64_t highest_;
+    std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+    std::atomic<uint64_t> total_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+    std::atomic<uint64_t> min_{std::numeric_limits<uint64_t>::max()};
+
+    size_t indexOf(uint64_t v) const
+    {
+        if (v < 2 * half_)
+            return static_cast<size_t>(v);
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - (bits_ - 1);
+        uint64_t sub = v >> shift;
+        return static_cast<size_t>(2 * half_ + (shift - 1) * half_ + (sub - half_));
+    }
+
+    uint64_t highestEquivalent(size_t idx) const
+    {
+        if (idx < 2 * half_)
+            return idx;
+        uint64_t rel = idx - 2 * half_;
+        int shift = static_cast<int>(rel / half_) + 1;
+        uint64_t sub = rel % half_ + half_;
+        return ((sub + 1) << shift) - 1;
+    }
+};
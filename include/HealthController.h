@@ -0,0 +1,19 @@
+#pragma once
+#include <drogon/HttpController.h>
+
+using namespace drogon;
+
+class HealthController : public drogon::HttpController<HealthController, false> {
+public:
+    HealthController() = default;
+
+    METHOD_LIST_BEGIN
+    ADD_METHOD_TO(HealthController::liveness, "/healthz", Get);
+    ADD_METHOD_TO(HealthController::readiness, "/readyz", Get);
+    METHOD_LIST_END
+
+    // 200 while the IO loop is answering at all
+    void liveness(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
+    // 200 once warmup has finished, 503 before that
+    void readiness(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
+};
@@ -0,0 +1,221 @@
+#pragma once
+#include <drogon/drogon.h>
+#include <drogon/orm/DbClient.h>
+#include <trantor/net/EventLoop.h>
+#include <spdlog/spdlog.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "DbRouter.h"
+
+// Account numbers are "ACCT", a sequence number zero-padded to 9 digits and
+// a Luhn check digit. The check digit catches every single-digit typo and
+// most transpositions, so a malformed number is refused without a query.
+namespace AccountNumber
+{
+    constexpr std::string_view kPrefix = "ACCT";
+    constexpr size_t kSequenceDigits = 9;
+
+    // Luhn digit for `digits` (which must be all 0-9), computed as if it
+    // were to be appended to the right.
+    inline int checkDigit(std::string_view digits)
+    {
+        int sum = 0;
+        bool dbl = true;
+        for (auto it = digits.rbegin(); it != digits.rend(); ++it, dbl = !dbl)
+        {
+            int d = *it - '0';
+            if (dbl && (d *= 2) > 9)
+                d -= 9;
+            sum += d;
+        }
+        return (10 - sum % 10) % 10;
+    }
+
+    inline std::string format(uint64_t sequence)
+    {
+        std::string digits = std::to_string(sequence);
+        if (digits.size() < kSequenceDigits)
+            digits.insert(0, kSequenceDigits - digits.size(), '0');
+        std::string out;
+        out.reserve(kPrefix.size() + digits.size() + 1);
+        out.append(kPrefix).append(digits);
+        out.push_back(static_cast<char>('0' + checkDigit(digits)));
+        return out;
+    }
+
+    inline bool valid(std::string_view s)
+    {
+        if (s.size() < kPrefix.size() + kSequenceDigits + 1 || s.substr(0, kPrefix.size()) != kPrefix)
+            return false;
+        std::string_view digits = s.substr(kPrefix.size());
+        for (char c : digits)
+            if (c < '0' || c > '9')
+                return false;
+        return checkDigit(digits.substr(0, digits.size() - 1)) == digits.back() - '0';
+    }
+}
+
+// Hands out unique sequence numbers without a round trip per id.
+//
+// The database row id_blocks(name) holds the next unreserved value; one
+// UPDATE ... RETURNING reserves `blockSize` of them at a time. Each IO thread
+// keeps its own block and serves ids from it with no locking, and fetches the
+// following block once half of the current one is used, so callers normally
+// never wait. Reserved ids that are never used (e.g. on restart) are simply
+// skipped; uniqueness never depends on retries.
+//
+// next() must be called on a drogon event loop thread; its callback runs on
+// that same thread.
+class IdAllocator : public std::enable_shared_from_this<IdAllocator>
+{
+public:
+    using IdCallback = std::function<void(uint64_t)>;
+    using ErrorCallback = std::function<void(const std::string &)>;
+
+    IdAllocator(std::shared_ptr<DbRouter> db, std::string name, uint64_t blockSize = 1000)
+        : db_(std::move(db)), name_(std::move(name)), blockSize_(blockSize ? blockSize : 1) {}
+
+    // Creates the block table and this sequence's row. Runs once at startup.
+    void ensureSchema(uint64_t firstValue = 1)
+    {
+        const auto &client = db_->writer();
+        client->execSqlSync("CREATE TABLE IF NOT EXISTS id_blocks ("
+                            "name VARCHAR(64) PRIMARY KEY, "
+                            "next_value BIGINT NOT NULL)");
+        client->execSqlSync("INSERT INTO id_blocks (name, next_value) VALUES ($1, $2) "
+                            "ON CONFLICT (name) DO NOTHING",
+                            name_, static_cast<int64_t>(firstValue));
+    }
+
+    void next(IdCallback cb, ErrorCallback onError)
+    {
+        auto *loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+        if (!loop)
+        {
+            // Not on an IO thread (e.g. a worker pool); hop to the main loop.
+            drogon::app().getLoop()->queueInLoop(
+                [self = shared_from_this(), cb = std::move(cb), onError = std::move(onError)]() mutable {
+                    self->next(std::move(cb), std::move(onError));
+                });
+            return;
+        }
+
+        auto &l = local();
+        if (l.next == l.end && l.spareNext != l.spareEnd)
+        {
+            l.next = l.spareNext;
+            l.end = l.spareEnd;
+            l.spareNext = l.spareEnd = 0;
+        }
+        if (l.next < l.end && l.waiters.empty())
+        {
+            uint64_t id = l.next++;
+            if (l.end - l.next < blockSize_ / 2 && l.spareNext == l.spareEnd && !l.fetching)
+                fetch(loop);
+            cb(id);
+            return;
+        }
+        l.waiters.push_back({std::move(cb), std::move(onError)});
+        if (!l.fetching)
+            fetch(loop);
+    }
+
+private:
+    std::shared_ptr<DbRouter> db_;
+    std::string name_;
+    uint64_t blockSize_;
+
+    struct Waiter
+    {
+        IdCallback cb;
+        ErrorCallback onError;
+    };
+
+    // Per-thread state; only ever touched on its own loop thread.
+    struct Local
+    {
+        uint64_t next = 0, end = 0;           // block being handed out
+        uint64_t spareNext = 0, spareEnd = 0; // prefetched block
+        bool fetching = false;
+        std::deque<Waiter> waiters;
+    };
+
+    Local &local()
+    {
+        thread_local std::unordered_map<const IdAllocator *, Local> states;
+        return states[this];
+    }
+
+    void fetch(trantor::EventLoop *loop)
+    {
+        local().fetching = true;
+        auto self = shared_from_this();
+        db_->write(
+            "UPDATE id_blocks SET next_value = next_value + $1 WHERE name = $2 RETURNING next_value",
+            [self, loop](const drogon::orm::Result &r) {
+                if (r.empty())
+                {
+                    loop->queueInLoop([self] { self->failWaiters("id sequence " + self->name_ + " missing"); });
+                    return;
+                }
+                uint64_t end = static_cast<uint64_t>(r[0]["next_value"].as<int64_t>());
+                loop->queueInLoop([self, end] { self->onBlock(end - self->blockSize_, end); });
+            },
+            [self, loop](const drogon::orm::DrogonDbException &e) {
+                std::string what = e.base().what();
+                loop->queueInLoop([self, what] { self->failWaiters(what); });
+            },
+            static_cast<int64_t>(blockSize_), name_);
+    }
+
+    void onBlock(uint64_t begin, uint64_t end)
+    {
+        auto &l = local();
+        l.fetching = false;
+        if (l.next == l.end)
+        {
+            l.next = begin;
+            l.end = end;
+        }
+        else
+        {
+            l.spareNext = begin;
+            l.spareEnd = end;
+        }
+        spdlog::info("Reserved {} ids [{}, {}) for {}", end - begin, begin, end, name_);
+
+        while (!l.waiters.empty())
+        {
+            if (l.next == l.end && l.spareNext != l.spareEnd)
+            {
+                l.next = l.spareNext;
+                l.end = l.spareEnd;
+                l.spareNext = l.spareEnd = 0;
+            }
+            if (l.next == l.end)
+                break;
+            auto w = std::move(l.waiters.front());
+            l.waiters.pop_front();
+            w.cb(l.next++);
+        }
+        if (!l.waiters.empty() || (l.end - l.next < blockSize_ / 2 && l.spareNext == l.spareEnd))
+            fetch(trantor::EventLoop::getEventLoopOfCurrentThread());
+    }
+
+    void failWaiters(const std::string &what)
+    {
+        auto &l = local();
+        l.fetching = false;
+        spdlog::error("Reserving a block of {} failed: {}", name_, what);
+        auto waiters = std::move(l.waiters);
+        l.waiters.clear();
+        for (auto &w : waiters)
+            if (w.onError)
+                w.onError(what);
+    }
+};
@@ -0,0 +1,173 @@
+#pragma once
+#include <drogon/HttpResponse.h>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Direct serializer for the small flat JSON bodies our handlers return
+// ({"new_balance":...}, token pairs, profile rows). Writes straight into a
+// per-thread scratch buffer instead of building a Json::Value tree and running
+// it through a StreamWriter; the only allocation left is the response body.
+//
+//   JsonWriter w;
+//   w.field("status", "success").field("new_balance", 42.5);
+//   callback(w.toResponse());
+//
+// One writer per thread at a time: the scratch buffer is shared, so finish a
+// writer (toResponse/str) before starting the next one on the same thread.
+class JsonWriter
+{
+public:
+    JsonWriter() : buf_(scratch())
+    {
+        buf_.clear();
+        buf_.push_back('{');
+    }
+
+    JsonWriter(const JsonWriter &) = delete;
+    JsonWriter &operator=(const JsonWriter &) = delete;
+
+    JsonWriter &field(std::string_view key, std::string_view value)
+    {
+        writeKey(key);
+        writeString(value);
+        return *this;
+    }
+
+    JsonWriter &field(std::string_view key, const char *value)
+    {
+        return field(key, std::string_view(value));
+    }
+
+    JsonWriter &field(std::string_view key, const std::string &value)
+    {
+        return field(key, std::string_view(value));
+    }
+
+    JsonWriter &field(std::string_view key, double value)
+    {
+        writeKey(key);
+        if (!std::isfinite(value))
+        {
+            buf_.append("null");
+            return *this;
+        }
+        char tmp[32];
+        auto res = std::to_chars(tmp, tmp + sizeof(tmp), value);
+        buf_.append(tmp, res.ptr);
+        return *this;
+    }
+
+    JsonWriter &field(std::string_view key, int64_t value)
+    {
+        writeKey(key);
+        char tmp[24];
+        auto res = std::to_chars(tmp, tmp + sizeof(tmp), value);
+        buf_.append(tmp, res.ptr);
+        return *this;
+    }
+
+    JsonWriter &field(std::string_view key, int value)
+    {
+        return field(key, static_cast<int64_t>(value));
+    }
+
+    JsonWriter &field(std::string_view key, bool value)
+    {
+        writeKey(key);
+        buf_.append(value ? "true" : "false");
+        return *this;
+    }
+
+    // Splices an already-serialized JSON value (array/object) under key.
+    JsonWriter &rawField(std::string_view key, std::string_view json)
+    {
+        writeKey(key);
+        buf_.append(json);
+        return *this;
+    }
+
+    // Finishes the object and returns a copy of the serialized text.
+    std::string str()
+    {
+        close();
+        return std::string(buf_);
+    }
+
+    drogon::HttpResponsePtr toResponse(drogon::HttpStatusCode code = drogon::k200OK)
+    {
+        close();
+        auto resp = drogon::HttpResponse::newHttpResponse(code, drogon::CT_APPLICATION_JSON);
+        resp->setBody(std::string(buf_));
+        return resp;
+    }
+
+    static void appendEscaped(std::string &out, std::string_view s)
+    {
+        static const char hex[] = "0123456789abcdef";
+        for (unsigned char c : s)
+        {
+            switch (c)
+            {
+            case '"': out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            default:
+                if (c < 0x20)
+                {
+                    out.append("\\u00");
+                    out.push_back(hex[c >> 4]);
+                    out.push_back(hex[c & 0xF]);
+                }
+                else
+                {
+                    out.push_back(static_cast<char>(c));
+                }
+            }
+        }
+    }
+
+private:
+    std::string &buf_;
+    bool first_ = true;
+    bool closed_ = false;
+
+    static std::string &scratch()
+    {
+        thread_local std::string buf = [] {
+            std::string s;
+            s.reserve(512);
+            return s;
+        }();
+        return buf;
+    }
+
+    void writeKey(std::string_view key)
+    {
+        if (!first_)
+            buf_.push_back(',');
+        first_ = false;
+        writeString(key);
+        buf_.push_back(':');
+    }
+
+    void writeString(std::string_view s)
+    {
+        buf_.push_back('"');
+        appendEscaped(buf_, s);
+        buf_.push_back('"');
+    }
+
+    void close()
+    {
+        if (!closed_)
+        {
+            buf_.push_back('}');
+            closed_ = true;
+        }
+    }
+};
@@ -1,23 +1,21 @@
 #pragma once
 #include <drogon/HttpFilter.h>
-#include <jwt-cpp/jwt.h>
+#include "jwt_utils.h"
 
 using namespace drogon;
 
 class JwtMiddleware : public HttpFilter<JwtMiddleware> {
 public:
-    JwtMiddleware() {
-        jwtSecret = "supersecretkey"; // same as in AuthController; move to env var in production
-    }
+    JwtMiddleware() = default;
 
     void doFilter(const HttpRequestPtr &req,
                   FilterCallback &&fcb,
                   FilterChainCallback &&fccb) override {
 
         // Get Authorization header
-        auto authHeader = req->getHeader("Authorization");
+        const auto &authHeader = req->getHeader("Authorization");
         if (authHeader.empty() || authHeader.find("Bearer ") != 0) {
-            auto resp = HttpResponse::newHttpResponse(k401Unauthorized);
+            auto resp = HttpResponse::newHttpResponse(k401Unauthorized, CT_TEXT_HTML);
             resp->setBody("Missing or invalid Authorization header");
             fcb(resp);
             return;
@@ -25,24 +23,18 @@ public:
 
         std::string token = authHeader.substr(7); // skip "Bearer "
 
-        try {
-            auto decoded = jwt::decode(token);
-            auto verifier = jwt::verify()
-                .allow_algorithm(jwt::algorithm::hs256{jwtSecret})
-                .with_issuer("my_cppAuth");
-            verifier.verify(decoded);
-
-            // Pass username to request attributes
-            req->attributes()["username"] = decoded.get_subject();
-            
-            fccb(); // proceed to the controller
-        } catch (const std::exception &e) {
-            auto resp = HttpResponse::newHttpResponse(k401Unauthorized);
+        // Same secrets as AuthController, including the previous key during a rotation
+        std::string username;
+        if (!verifyJWT(token, username)) {
+            auto resp = HttpResponse::newHttpResponse(k401Unauthorized, CT_TEXT_HTML);
             resp->setBody("Invalid or expired token");
             fcb(resp);
+            return;
         }
-    }
 
-private:
-    std::string jwtSecret;
+        // Pass username to request attributes
+        req->attributes()->insert("username", username);
+
+        fccb(); // proceed to the controller
+    }
 };
@@ -0,0 +1,325 @@
+#pragma once
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "Base64Url.h"
+#include "JsonWriter.h"
+
+// HS256 tokens without a JSON library in the loop.
+//
+// The header segment is encoded once; claims are written straight into a
+// buffer. HMAC keying (hashing the padded key into the inner and outer
+// SHA-256 states) happens once per thread and secret: each signature copies
+// the two keyed states instead of re-keying. Verification recomputes the
+// signature the same way and reads the claims with a parser that only
+// accepts the flat objects issued here.
+//
+// Tokens carry {"iss","sub","iat","exp"}, the same claims jwt-cpp's builder
+// produced, and tokens issued by it before the switch still verify. Tokens
+// from /login and /refresh also carry "acct", the user's account number,
+// which is what the bank endpoints act on. Access and refresh tokens issued
+// before "acct" was added have none: the bank endpoints answer them with 401
+// (and /refresh hands out tokens without it) until the user logs in again.
+class JwtSigner
+{
+public:
+    static constexpr const char *kIssuer = "my_cppAuth";
+
+    static std::string sign(std::string_view subject, std::chrono::seconds ttl, const std::string &secret,
+                            std::string_view account = {})
+    {
+        int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+        std::string &claims = scratch();
+        claims.assign("{\"iss\":\"");
+        claims.append(kIssuer);
+        claims.append("\",\"sub\":\"");
+        JsonWriter::appendEscaped(claims, subject);
+        if (!account.empty())
+        {
+            claims.append("\",\"acct\":\"");
+            JsonWriter::appendEscaped(claims, account);
+        }
+        claims.append("\",\"iat\":");
+        appendInt(claims, now);
+        claims.append(",\"exp\":");
+        appendInt(claims, now + ttl.count());
+        claims.push_back('}');
+
+        std::string token;
+        token.reserve(header().size() + Base64Url::encodedSize(claims.size()) + 2 + 43);
+        token.append(header());
+        token.push_back('.');
+        Base64Url::encode(claims, token);
+
+        unsigned char mac[32];
+        keyed(secret).mac(token, mac);
+        token.push_back('.');
+        Base64Url::encode(std::string_view(reinterpret_cast<const char *>(mac), sizeof(mac)), token);
+        return token;
+    }
+
+    enum class Result
+    {
+        Valid,
+        Invalid,
+        Unknown // well-formed but not in a shape issued here; use a general verifier
+    };
+
+    // Checks the signature against `secret`, then issuer, expiry and
+    // issued-at against the clock; on Valid, `subject` holds "sub" and
+    // `account`, if given, "acct" ("" without one).
+    static Result verify(std::string_view token, const std::string &secret, std::string &subject,
+                         std::string *account = nullptr)
+    {
+        size_t dot1 = token.find('.');
+        size_t dot2 = dot1 == std::string_view::npos ? dot1 : token.find('.', dot1 + 1);
+        if (dot2 == std::string_view::npos || token.find('.', dot2 + 1) != std::string_view::npos)
+            return Result::Invalid;
+        if (!knownHeader(token.substr(0, dot1)))
+            return Result::Unknown;
+
+        std::string &buf = scratch();
+        buf.clear();
+        if (!Base64Url::decode(token.substr(dot2 + 1), buf) || buf.size() != 32)
+            return Result::Invalid;
+        unsigned char mac[32];
+        keyed(secret).mac(token.substr(0, dot2), mac);
+        if (CRYPTO_memcmp(mac, buf.data(), sizeof(mac)) != 0)
+            return Result::Invalid;
+
+        buf.clear();
+        if (!Base64Url::decode(token.substr(dot1 + 1, dot2 - dot1 - 1), buf))
+            return Result::Invalid;
+        Claims c;
+        if (!parseClaims(buf, c))
+            return Result::Unknown;
+        int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+        if (!c.hasSub || c.iss != kIssuer || (c.hasExp && now > c.exp) || (c.hasIat && now < c.iat) ||
+            (c.hasNbf && now < c.nbf))
+            return Result::Invalid;
+        subject = std::move(c.sub);
+        if (account) *account = std::move(c.acct);
+        return Result::Valid;
+    }
+
+private:
+    struct Claims
+    {
+        std::string iss, sub, acct;
+        int64_t iat = 0, exp = 0, nbf = 0;
+        bool hasSub = false, hasIat = false, hasExp = false, hasNbf = false;
+    };
+
+    // A secret's keyed inner/outer SHA-256 states, per thread.
+    class Keyed
+    {
+    public:
+        Keyed() : inner_(EVP_MD_CTX_new()), outer_(EVP_MD_CTX_new()), work_(EVP_MD_CTX_new()) {}
+        ~Keyed()
+        {
+            EVP_MD_CTX_free(inner_);
+            EVP_MD_CTX_free(outer_);
+            EVP_MD_CTX_free(work_);
+        }
+        Keyed(const Keyed &) = delete;
+        Keyed &operator=(const Keyed &) = delete;
+
+        const std::string &secret() const { return secret_; }
+
+        void rekey(const std::string &secret)
+        {
+            unsigned char block[64] = {0};
+            if (secret.size() > sizeof(block))
+            {
+                unsigned int len = 0;
+                EVP_Digest(secret.data(), secret.size(), block, &len, EVP_sha256(), nullptr);
+            }
+            else
+                std::memcpy(block, secret.data(), secret.size());
+
+            unsigned char pad[64];
+            for (size_t i = 0; i < sizeof(pad); ++i) pad[i] = block[i] ^ 0x36;
+            EVP_DigestInit_ex(inner_, EVP_sha256(), nullptr);
+            EVP_DigestUpdate(inner_, pad, sizeof(pad));
+            for (size_t i = 0; i < sizeof(pad); ++i) pad[i] = block[i] ^ 0x5c;
+            EVP_DigestInit_ex(outer_, EVP_sha256(), nullptr);
+            EVP_DigestUpdate(outer_, pad, sizeof(pad));
+            OPENSSL_cleanse(block, sizeof(block));
+            OPENSSL_cleanse(pad, sizeof(pad));
+            secret_ = secret;
+        }
+
+        void mac(std::string_view data, unsigned char out[32])
+        {
+            unsigned char innerHash[32];
+            unsigned int len = 0;
+            EVP_MD_CTX_copy_ex(work_, inner_);
+            EVP_DigestUpdate(work_, data.data(), data.size());
+            EVP_DigestFinal_ex(work_, innerHash, &len);
+            EVP_MD_CTX_copy_ex(work_, outer_);
+            EVP_DigestUpdate(work_, innerHash, sizeof(innerHash));
+            EVP_DigestFinal_ex(work_, out, &len);
+        }
+
+    private:
+        EVP_MD_CTX *inner_;
+        EVP_MD_CTX *outer_;
+        EVP_MD_CTX *work_;
+        std::string secret_;
+    };
+
+    // Two slots cover the current and previous secret during a rotation.
+    static Keyed &keyed(const std::string &secret)
+    {
+        thread_local Keyed slots[2];
+        thread_local int next = 0;
+        for (Keyed &k : slots)
+            if (!k.secret().empty() && k.secret() == secret) return k;
+        Keyed &k = slots[next];
+        next ^= 1;
+        k.rekey(secret);
+        return k;
+    }
+
+    static std::string &scratch()
+    {
+        thread_local std::string buf = [] {
+            std::string s;
+            s.reserve(256);
+            return s;
+        }();
+        return buf;
+    }
+
+    static const std::string &header()
+    {
+        static const std::string h = Base64Url::encode(R"({"alg":"HS256","typ":"JWT"})");
+        return h;
+    }
+
+    // Our header, and the ones jwt-cpp wrote for HS256.
+    static bool knownHeader(std::string_view h)
+    {
+        static const std::string alt[] = {Base64Url::encode(R"({"alg":"HS256"})"),
+                                          Base64Url::encode(R"({"typ":"JWT","alg":"HS256"})")};
+        return h == header() || h == alt[0] || h == alt[1];
+    }
+
+    static void appendInt(std::string &out, int64_t v)
+    {
+        char tmp[24];
+        auto res = std::to_chars(tmp, tmp + sizeof(tmp), v);
+        out.append(tmp, res.ptr);
+    }
+
+    // Flat object of strings and integers; anything else is rejected.
+    static bool parseClaims(std::string_view s, Claims &c)
+    {
+        size_t i = 0;
+        auto ws = [&] {
+            while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\n' || s[i] == '\r')) ++i;
+        };
+        ws();
+        if (i >= s.size() || s[i++] != '{') return false;
+        ws();
+        if (i < s.size() && s[i] == '}') return true;
+        std::string key, str;
+        while (true)
+        {
+            ws();
+            if (!parseString(s, i, key)) return false;
+            ws();
+            if (i >= s.size() || s[i++] != ':') return false;
+            ws();
+            if (i >= s.size()) return false;
+            if (s[i] == '"')
+            {
+                if (!parseString(s, i, str)) return false;
+                if (key == "iss") c.iss = str;
+                else if (key == "sub") { c.sub = str; c.hasSub = true; }
+                else if (key == "acct") c.acct = str;
+            }
+            else
+            {
+                int64_t v = 0;
+                auto res = std::from_chars(s.data() + i, s.data() + s.size(), v);
+                if (res.ec != std::errc() || (res.ptr < s.data() + s.size() && (*res.ptr == '.' || *res.ptr == 'e' || *res.ptr == 'E')))
+                    return false;
+                i = static_cast<size_t>(res.ptr - s.data());
+                if (key == "iat") { c.iat = v; c.hasIat = true; }
+                else if (key == "exp") { c.exp = v; c.hasExp = true; }
+                else if (key == "nbf") { c.nbf = v; c.hasNbf = true; }
+            }
+            ws();
+            if (i >= s.size()) return false;
+            char sep = s[i++];
+            if (sep == '}') break;
+            if (sep != ',') return false;
+        }
+        ws();
+        return i == s.size();
+    }
+
+    static bool parseString(std::string_view s, size_t &i, std::string &out)
+    {
+        if (i >= s.size() || s[i] != '"') return false;
+        ++i;
+        out.clear();
+        while (i < s.size())
+        {
+            char ch = s[i++];
+            if (ch == '"') return true;
+            if (ch != '\\')
+            {
+                out.push_back(ch);
+                continue;
+            }
+            if (i >= s.size()) return false;
+            switch (s[i++])
+            {
+            case '"': out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '/': out.push_back('/'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u':
+            {
+                unsigned cp = 0;
+                if (i + 4 > s.size()) return false;
+                auto res = std::from_chars(s.data() + i, s.data() + i + 4, cp, 16);
+                if (res.ptr != s.data() + i + 4 || (cp >= 0xD800 && cp <= 0xDFFF)) return false; // no surrogates
+                i += 4;
+                if (cp < 0x80)
+                    out.push_back(static_cast<char>(cp));
+                else if (cp < 0x800)
+                {
+                    out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+                    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+                }
+                else
+                {
+                    out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+                    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+                }
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        return false;
+    }
+};
@@ -0,0 +1,403 @@
+#pragma once
+#include <drogon/utils/Utilities.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "BinLogReader.h"
+
+// On-disk layout of an archive's sidecar index, shared with cppAuth_logquery.
+//
+// <name>.gz is a series of gzip members, each a self-contained chunk of the
+// original file (text logs are cut at line boundaries every ~1MB, BinLog
+// files are one member). <name>.idx is a LogIndex::Header, one fixed-size
+// Entry per member, then the members' Bloom filters of request ids as
+// 64-bit words, so a reader can mmap it and decompress only the members
+// whose time range and filter match.
+namespace LogIndex
+{
+constexpr char kMagic[8] = {'C', 'A', 'I', 'D', 'X', '0', '0', '2'};
+
+struct Header
+{
+    char magic[8];
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct Entry
+{
+    uint64_t offset;      // of the gzip member in the .gz file
+    uint64_t length;      // compressed bytes
+    int64_t firstTs;      // unix seconds, earliest and latest timestamped line;
+    int64_t lastTs;       // 0 if the chunk had none
+    uint64_t bloomOffset; // in words, from the end of the entry table
+    uint32_t bloomWords;  // 0: no request ids in the chunk
+    uint32_t binary;      // 1 if the member is BinLog data
+};
+
+// About one byte of filter per id with four probes: ~2% false positives.
+constexpr int kProbes = 4;
+
+inline uint64_t hashId(std::string_view id)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : id)
+    {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+inline size_t bloomWordsFor(size_t ids) { return ids ? (ids + 7) / 8 : 0; }
+
+inline void bloomAdd(uint64_t *words, size_t nwords, uint64_t h)
+{
+    uint64_t bits = nwords * 64, step = (h >> 32) | 1;
+    for (int i = 0; i < kProbes; ++i)
+    {
+        uint64_t bit = (h + i * step) % bits;
+        words[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+}
+
+inline bool bloomMayContain(const uint64_t *words, size_t nwords, std::string_view id)
+{
+    if (!nwords) return false;
+    uint64_t h = hashId(id), bits = nwords * 64, step = (h >> 32) | 1;
+    for (int i = 0; i < kProbes; ++i)
+    {
+        uint64_t bit = (h + i * step) % bits;
+        if (!(words[bit / 64] & (uint64_t(1) << (bit % 64))))
+            return false;
+    }
+    return true;
+}
+
+// "[2026-10-19 14:03:11..." -> unix seconds (local time), or 0.
+inline int64_t lineTime(std::string_view line)
+{
+    if (line.size() < 20 || line[0] != '[') return 0;
+    std::tm tm{};
+    std::string stamp(line.substr(1, 19));
+    if (!strptime(stamp.c_str(), "%Y-%m-%d %H:%M:%S", &tm)) return 0;
+    tm.tm_isdst = -1;
+    return static_cast<int64_t>(std::mktime(&tm));
+}
+
+// Request ids are logged as REQ_ID=<id>.
+inline std::string_view requestId(std::string_view text)
+{
+    auto pos = text.find("REQ_ID=");
+    if (pos == std::string_view::npos) return {};
+    pos += 7;
+    auto end = text.find_first_of(" \t,]", pos);
+    return text.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+}
+} // namespace LogIndex
+
+// Moves rotated log files into logs/archive/ and compresses them on a
+// background thread running at idle priority, so history is kept for as
+// long as LOG_ARCHIVE_MAX_MB allows instead of the sinks' 3-5 files.
+//
+// Rotated files are found by polling: spdlog's logs/bank.1.log naming and
+// BinLog's logs/request.blog.1 naming are both recognised. A file is claimed
+// by renaming it into the archive directory first (atomic, and only one
+// worker process wins), then compressed and indexed, then deleted.
+class LogArchiver
+{
+public:
+    struct Options
+    {
+        std::vector<std::string> logs; // active log paths whose rotations are archived
+        std::string dir = "logs/archive";
+        uint64_t maxBytes = 1024ULL * 1024 * 1024;
+        double pollSeconds = 2.0;
+
+        static bool enabled()
+        {
+            const char *v = std::getenv("LOG_ARCHIVE");
+            return !v || std::string(v) != "0";
+        }
+
+        static Options fromEnv(std::vector<std::string> logs)
+        {
+            Options o;
+            o.logs = std::move(logs);
+            if (const char *v = std::getenv("LOG_ARCHIVE_DIR"))
+                o.dir = v;
+            if (const char *v = std::getenv("LOG_ARCHIVE_MAX_MB"))
+                o.maxBytes = std::strtoull(v, nullptr, 10) * 1024 * 1024;
+            return o;
+        }
+    };
+
+    explicit LogArchiver(Options options) : options_(std::move(options)) {}
+
+    ~LogArchiver() { stop(); }
+
+    void start()
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(options_.dir, ec);
+        thread_ = std::thread([this] { run(); });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_one();
+        if (thread_.joinable()) thread_.join();
+    }
+
+private:
+    static constexpr size_t kChunkBytes = 1024 * 1024;
+
+    static void lowerPriority()
+    {
+#ifdef SCHED_IDLE
+        sched_param param{};
+        pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+        setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+    }
+
+    void run()
+    {
+        lowerPriority();
+        // Anything claimed but not finished before a restart
+        for (const auto &p : pending())
+            archive(p);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_)
+        {
+            cv_.wait_for(lock, std::chrono::duration<double>(options_.pollSeconds), [this] { return stopping_; });
+            if (stopping_) break;
+            lock.unlock();
+            for (const auto &log : options_.logs)
+            {
+                for (const auto &rotated : rotations(log))
+                {
+                    std::string claimed = claim(rotated);
+                    if (!claimed.empty()) archive(claimed);
+                }
+            }
+            enforceBudget();
+            lock.lock();
+        }
+    }
+
+    // Rotated siblings of `log`, oldest (highest index) first.
+    static std::vector<std::filesystem::path> rotations(const std::string &log)
+    {
+        namespace fs = std::filesystem;
+        fs::path active(log);
+        std::string stem = active.stem().string();
+        std::string ext = active.extension().string();
+        std::string name = active.filename().string();
+
+        std::vector<std::pair<unsigned long, fs::path>> found;
+        std::error_code ec;
+        fs::path dir = active.has_parent_path() ? active.parent_path() : fs::path(".");
+        for (const auto &entry : fs::directory_iterator(dir, ec))
+        {
+            std::string f = entry.path().filename().string();
+            std::string digits;
+            if (f.size() > name.size() + 1 && f.compare(0, name.size() + 1, name + ".") == 0)
+                digits = f.substr(name.size() + 1); // request.blog.3
+            else if (f.size() > stem.size() + ext.size() + 1 && f.compare(0, stem.size() + 1, stem + ".") == 0 &&
+                     f.compare(f.size() - ext.size(), ext.size(), ext) == 0)
+                digits = f.substr(stem.size() + 1, f.size() - ext.size() - stem.size() - 1); // bank.3.log
+            if (digits.empty() || !std::all_of(digits.begin(), digits.end(), ::isdigit))
+                continue;
+            found.emplace_back(std::stoul(digits), entry.path());
+        }
+        std::sort(found.begin(), found.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+        std::vector<fs::path> out;
+        for (auto &f : found)
+            out.push_back(std::move(f.second));
+        return out;
+    }
+
+    // Renames a rotated file into the archive dir; "" if someone else got it.
+    std::string claim(const std::filesystem::path &rotated)
+    {
+        char stamp[32];
+        std::time_t now = std::time(nullptr);
+        std::tm tm{};
+        localtime_r(&now, &tm);
+        std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+        std::string target = options_.dir + "/" + rotated.filename().string() + "." + stamp + "." +
+                             std::to_string(++sequence_) + ".pending";
+        std::error_code ec;
+        std::filesystem::rename(rotated, target, ec);
+        return ec ? std::string() : target;
+    }
+
+    std::vector<std::string> pending() const
+    {
+        std::vector<std::string> out;
+        std::error_code ec;
+        for (const auto &entry : std::filesystem::directory_iterator(options_.dir, ec))
+            if (entry.path().extension() == ".pending")
+                out.push_back(entry.path().string());
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+
+    // <x>.pending -> <x>.gz + <x>.idx, written under temporary names and
+    // renamed into place so a reader never sees a half-written archive.
+    void archive(const std::string &pendingPath)
+    {
+        std::ifstream in(pendingPath, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+
+        std::string base = pendingPath.substr(0, pendingPath.size() - std::strlen(".pending"));
+        std::ofstream gz(base + ".gz.tmp", std::ios::binary | std::ios::trunc);
+        std::vector<LogIndex::Entry> entries;
+        std::vector<uint64_t> blooms;
+        uint64_t offset = 0;
+
+        auto emit = [&](std::string_view chunk, LogIndex::Entry e, std::vector<uint64_t> &ids) {
+            std::string member = drogon::utils::gzipCompress(chunk.data(), chunk.size());
+            gz.write(member.data(), static_cast<std::streamsize>(member.size()));
+            e.offset = offset;
+            e.length = member.size();
+            offset += member.size();
+
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+            e.bloomOffset = blooms.size();
+            e.bloomWords = static_cast<uint32_t>(LogIndex::bloomWordsFor(ids.size()));
+            blooms.resize(blooms.size() + e.bloomWords, 0);
+            for (uint64_t h : ids)
+                LogIndex::bloomAdd(blooms.data() + e.bloomOffset, e.bloomWords, h);
+            entries.push_back(e);
+        };
+        auto stamp = [](LogIndex::Entry &e, int64_t ts) {
+            e.firstTs = e.firstTs ? std::min(e.firstTs, ts) : ts;
+            e.lastTs = std::max(e.lastTs, ts);
+        };
+
+        if (BinLogReader::isBinLog(data))
+        {
+            LogIndex::Entry e{};
+            e.binary = 1;
+            std::vector<uint64_t> ids;
+            BinLogReader reader(data);
+            reader.read([&](const BinLogReader::Record &r) {
+                stamp(e, r.wallNs / 1000000000);
+                if (r.format.compare(0, 9, "REQ_ID={}") == 0 && !r.args.empty())
+                    ids.push_back(LogIndex::hashId(r.args[0].text));
+            });
+            emit(data, e, ids);
+        }
+        else
+        {
+            size_t start = 0;
+            while (start < data.size())
+            {
+                size_t end = std::min(data.size(), start + kChunkBytes);
+                if (end < data.size())
+                {
+                    size_t nl = data.find('\n', end);
+                    end = nl == std::string::npos ? data.size() : nl + 1;
+                }
+                std::string_view chunk(data.data() + start, end - start);
+                LogIndex::Entry e{};
+                std::vector<uint64_t> ids;
+                size_t line = 0;
+                while (line < chunk.size())
+                {
+                    size_t eol = chunk.find('\n', line);
+                    if (eol == std::string_view::npos) eol = chunk.size();
+                    std::string_view text = chunk.substr(line, eol - line);
+                    if (int64_t ts = LogIndex::lineTime(text))
+                        stamp(e, ts);
+                    auto id = LogIndex::requestId(text);
+                    if (!id.empty()) ids.push_back(LogIndex::hashId(id));
+                    line = eol + 1;
+                }
+                emit(chunk, e, ids);
+                start = end;
+            }
+        }
+        gz.close();
+
+        std::ofstream idx(base + ".idx.tmp", std::ios::binary | std::ios::trunc);
+        LogIndex::Header header{};
+        std::memcpy(header.magic, LogIndex::kMagic, sizeof(header.magic));
+        header.count = static_cast<uint32_t>(entries.size());
+        idx.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        idx.write(reinterpret_cast<const char *>(entries.data()),
+                  static_cast<std::streamsize>(entries.size() * sizeof(LogIndex::Entry)));
+        idx.write(reinterpret_cast<const char *>(blooms.data()),
+                  static_cast<std::streamsize>(blooms.size() * sizeof(uint64_t)));
+        idx.close();
+        if (!gz || !idx)
+        {
+            spdlog::error("Archiving {} failed; will retry after restart", pendingPath);
+            return;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(base + ".gz.tmp", base + ".gz", ec);
+        if (!ec) std::filesystem::rename(base + ".idx.tmp", base + ".idx", ec);
+        if (!ec) std::filesystem::remove(pendingPath, ec);
+        spdlog::info("Archived {} ({} -> {} bytes, {} chunks)", base, data.size(), offset, entries.size());
+    }
+
+    // Deletes the oldest archives until the directory fits the budget.
+    void enforceBudget()
+    {
+        namespace fs = std::filesystem;
+        std::vector<std::pair<fs::file_time_type, fs::path>> archives;
+        uint64_t total = 0;
+        std::error_code ec;
+        for (const auto &entry : fs::directory_iterator(options_.dir, ec))
+        {
+            if (entry.path().extension() != ".gz") continue;
+            total += entry.file_size(ec);
+            archives.emplace_back(entry.last_write_time(ec), entry.path());
+        }
+        std::sort(archives.begin(), archives.end());
+        for (const auto &a : archives)
+        {
+            if (total <= options_.maxBytes) break;
+            total -= fs::file_size(a.second, ec);
+            fs::remove(a.second, ec);
+            fs::path idx = a.second;
+            fs::remove(idx.replace_extension(".idx"), ec);
+        }
+    }
+
+    Options options_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    uint64_t sequence_ = 0;
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <pthread.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/rotating_file_sink.h>
+#ifdef SPDLOG_VER_MAJOR // the real spdlog, not the shim
+#include <spdlog/async.h>
+#define CPPAUTH_SPDLOG_ASYNC 1
+#endif
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "CpuTopology.h"
+
+// spdlog's async writer threads, on the logging cores of the CpuLayout.
+//
+// The pool threads are pinned by inheritance rather than through an spdlog
+// hook: the calling thread takes the log cores' affinity while
+// init_thread_pool() starts them, then gets its own mask back. The header
+// shim in external/spdlog has no async.h; with it, loggers are synchronous
+// and there are no threads to place.
+class LogThreads
+{
+public:
+    static void start(size_t queueSize, size_t threads, const std::vector<int> &cpus)
+    {
+#ifdef CPPAUTH_SPDLOG_ASYNC
+        cpu_set_t saved;
+        bool pinned = !cpus.empty() && pthread_getaffinity_np(pthread_self(), sizeof(saved), &saved) == 0 &&
+                      pinCurrentThread(cpus);
+        spdlog::init_thread_pool(queueSize, threads);
+        if (pinned)
+            pthread_setaffinity_np(pthread_self(), sizeof(saved), &saved);
+#else
+        (void)queueSize;
+        (void)threads;
+        (void)cpus;
+#endif
+    }
+
+    // A rotating file logger written from the pool.
+    static std::shared_ptr<spdlog::logger> rotating(const std::string &name, const std::string &file, size_t maxBytes,
+                                                    size_t files)
+    {
+#ifdef CPPAUTH_SPDLOG_ASYNC
+        return spdlog::rotating_logger_mt<spdlog::async_factory>(name, file, maxBytes, files);
+#else
+        return spdlog::rotating_logger_mt(name, file, maxBytes, files);
+#endif
+    }
+};
@@ -0,0 +1,249 @@
+#pragma once
+#include <drogon/HttpRequest.h>
+#include <trantor/net/EventLoop.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CpuProfiler.h"
+#include "HdrHistogram.h"
+
+// Watches every IO loop for work that blocks it.
+//
+// Each loop runs a LOOP_LAG_TICK_MS timer and records how late it fires into
+// a per-loop histogram (microseconds), served at /debug/loops. A watchdog
+// thread checks the loops' last tick; when one has not ticked for
+// LOOP_LAG_BLOCKED_MS it signals that thread, whose handler copies its own
+// backtrace into the loop's slot, and logs the stack together with the last
+// request dispatched on that loop. The ticks cost a few microseconds per
+// loop per second; the signal is only sent to a loop that is already stuck.
+class LoopLagMonitor
+{
+public:
+    struct Options
+    {
+        double tickMs = 10;
+        double blockedMs = 100;
+
+        static bool enabled()
+        {
+            const char *v = std::getenv("LOOP_LAG");
+            return !v || std::string(v) != "0";
+        }
+
+        static Options fromEnv()
+        {
+            Options o;
+            if (const char *v = std::getenv("LOOP_LAG_TICK_MS")) o.tickMs = std::atof(v);
+            if (const char *v = std::getenv("LOOP_LAG_BLOCKED_MS")) o.blockedMs = std::atof(v);
+            return o;
+        }
+    };
+
+    struct LoopStats
+    {
+        size_t loop;
+        uint64_t ticks;
+        uint64_t p50Us;
+        uint64_t p99Us;
+        uint64_t maxUs;
+        uint64_t stalls;
+    };
+
+    static LoopLagMonitor &instance()
+    {
+        static LoopLagMonitor m;
+        return m;
+    }
+
+    // Call from a beginning advice, once the IO loops exist.
+    void start(Options options, const std::vector<trantor::EventLoop *> &loops)
+    {
+        options_ = options;
+        count_ = loops.size();
+        loops_.reset(new Loop[count_]);
+
+        struct sigaction sa{};
+        sa.sa_sigaction = onSignal;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(captureSignal(), &sa, nullptr);
+        void *warm[4];
+        backtrace(warm, 4); // see CpuProfiler.h
+
+        for (size_t i = 0; i < count_; ++i)
+        {
+            Loop &l = loops_[i];
+            l.lastTickNs.store(nowNs());
+            loops[i]->queueInLoop([&l] {
+                current() = &l;
+                l.tid.store(static_cast<pid_t>(syscall(SYS_gettid)));
+                l.lastTickNs.store(nowNs());
+            });
+            loops[i]->runEvery(options_.tickMs / 1000.0, [&l, tickNs = static_cast<int64_t>(options_.tickMs * 1e6)] {
+                int64_t now = nowNs();
+                int64_t late = now - l.lastTickNs.exchange(now) - tickNs;
+                l.lag.record(late > 0 ? static_cast<uint64_t>(late / 1000) : 0);
+            });
+        }
+        watchdog_ = std::thread([this] { watch(); });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_one();
+        if (watchdog_.joinable()) watchdog_.join();
+    }
+
+    // Pre-handling advice: remembers what this loop is about to run.
+    void requestStarted(const drogon::HttpRequestPtr &req)
+    {
+        Loop *l = current();
+        if (!l) return;
+        l->seq.fetch_add(1, std::memory_order_acq_rel); // odd: writing
+        std::snprintf(l->request, sizeof(l->request), "%s %s", req->methodString(), req->path().c_str());
+        l->seq.fetch_add(1, std::memory_order_release);
+    }
+
+    std::vector<LoopStats> snapshot() const
+    {
+        std::vector<LoopStats> out;
+        for (size_t i = 0; i < count_; ++i)
+        {
+            const Loop &l = loops_[i];
+            out.push_back(LoopStats{i, l.lag.count(), l.lag.valueAtPercentile(50), l.lag.valueAtPercentile(99),
+                                    l.lag.max(), l.stalls.load(std::memory_order_relaxed)});
+        }
+        return out;
+    }
+
+private:
+    static constexpr int kMaxFrames = 32;
+
+    struct Loop
+    {
+        HdrHistogram lag{60ULL * 1000 * 1000}; // microseconds, up to a minute
+        std::atomic<int64_t> lastTickNs{0};
+        std::atomic<pid_t> tid{0};
+        std::atomic<uint64_t> stalls{0};
+
+        // Last request dispatched, behind a seqlock.
+        std::atomic<uint32_t> seq{0};
+        char request[160] = {0};
+
+        // Filled by the signal handler on the loop's own thread.
+        void *frames[kMaxFrames];
+        std::atomic<int> depth{-1};
+    };
+
+    static int captureSignal() { return SIGRTMIN + 2; }
+
+    static int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    static Loop *&current()
+    {
+        thread_local Loop *l = nullptr;
+        return l;
+    }
+
+    static void onSignal(int, siginfo_t *, void *)
+    {
+        int saved = errno;
+        if (Loop *l = current())
+            l->depth.store(backtrace(l->frames, kMaxFrames), std::memory_order_release);
+        errno = saved;
+    }
+
+    std::string lastRequest(const Loop &l) const
+    {
+        char copy[sizeof(l.request)];
+        for (int attempt = 0; attempt < 8; ++attempt)
+        {
+            uint32_t before = l.seq.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            std::memcpy(copy, l.request, sizeof(copy));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (l.seq.load(std::memory_order_relaxed) == before)
+            {
+                copy[sizeof(copy) - 1] = '\0';
+                return copy[0] ? copy : "(none)";
+            }
+        }
+        return "(busy)";
+    }
+
+    void watch()
+    {
+        auto period = std::chrono::duration<double, std::milli>(std::max(1.0, options_.blockedMs / 4));
+        int64_t blockedNs = static_cast<int64_t>((options_.blockedMs + options_.tickMs) * 1e6);
+        std::vector<int64_t> reported(count_, 0);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!cv_.wait_for(lock, period, [this] { return stopping_; }))
+        {
+            for (size_t i = 0; i < count_; ++i)
+            {
+                Loop &l = loops_[i];
+                int64_t last = l.lastTickNs.load();
+                int64_t stuck = nowNs() - last;
+                if (stuck < blockedNs || reported[i] == last) continue;
+                reported[i] = last; // once per stall
+                l.stalls.fetch_add(1, std::memory_order_relaxed);
+                report(i, l, stuck);
+            }
+        }
+    }
+
+    void report(size_t index, Loop &l, int64_t stuckNs)
+    {
+        std::string stack;
+        pid_t tid = l.tid.load();
+        if (tid)
+        {
+            l.depth.store(-1);
+            syscall(SYS_tgkill, getpid(), tid, captureSignal());
+            for (int i = 0; i < 50 && l.depth.load(std::memory_order_acquire) < 0; ++i)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            int depth = l.depth.load(std::memory_order_acquire);
+            for (int f = 2; f < depth; ++f) // skip the handler and the signal trampoline
+            {
+                if (!stack.empty()) stack += " <- ";
+                stack += CpuProfiler::symbol(l.frames[f]);
+            }
+        }
+        spdlog::warn("IO loop {} blocked for {}ms; last request: {}; stack: {}", index, stuckNs / 1000000,
+                     lastRequest(l), stack.empty() ? "(unavailable)" : stack);
+    }
+
+    Options options_;
+    std::unique_ptr<Loop[]> loops_;
+    size_t count_ = 0;
+    std::thread watchdog_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+};
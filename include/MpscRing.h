@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+// Bounded lock-free queue (Vyukov's array queue): any number of producers,
+// one consumer here. Each slot carries a sequence number that tells
+// producers and the consumer whose turn it is, so a push or pop is one CAS
+// on the shared index plus a release store on the slot. Capacity is rounded
+// up to a power of two.
+template <typename T>
+class MpscRing
+{
+public:
+    explicit MpscRing(size_t capacity)
+    {
+        size_t n = 2;
+        while (n < capacity)
+            n <<= 1;
+        mask_ = n - 1;
+        slots_.reset(new Slot[n]);
+        for (size_t i = 0; i < n; ++i)
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    // False if the ring is full; `value` is left untouched then.
+    bool tryPush(T &value)
+    {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot &s = slots_[pos & mask_];
+            size_t seq = s.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    s.value = std::move(value);
+                    s.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T &out)
+    {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        Slot &s = slots_[pos & mask_];
+        size_t seq = s.seq.load(std::memory_order_acquire);
+        if (static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1) < 0)
+            return false;
+        head_.store(pos + 1, std::memory_order_relaxed);
+        out = std::move(s.value);
+        s.value = T();
+        s.seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) std::atomic<size_t> head_{0};
+};
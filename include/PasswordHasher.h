@@ -0,0 +1,43 @@
+#pragma once
+#include <bcrypt/BCrypt.hpp>
+#include <functional>
+#include <string>
+#include "WorkerPool.h"
+
+// bcrypt on a dedicated pool so a login burst cannot stall the IO loops.
+// Callbacks run on a hashing thread; drogon response callbacks and DbClient
+// calls are safe to use from there.
+class PasswordHasher
+{
+public:
+    static PasswordHasher &instance()
+    {
+        static PasswordHasher hasher;
+        return hasher;
+    }
+
+    void start(size_t threads, const std::vector<int> &cpus = {})
+    {
+        pool_.start(threads, cpus);
+    }
+
+    void stop() { pool_.stop(); }
+
+    void hash(std::string password, std::function<void(std::string)> done)
+    {
+        pool_.submit([password = std::move(password), done = std::move(done)] {
+            done(BCrypt::generateHash(password));
+        });
+    }
+
+    void verify(std::string password, std::string hash, std::function<void(bool)> done)
+    {
+        pool_.submit([password = std::move(password), hash = std::move(hash), done = std::move(done)] {
+            done(BCrypt::validatePassword(password, hash));
+        });
+    }
+
+private:
+    PasswordHasher() = default;
+    WorkerPool pool_;
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+// Process lifecycle state behind /healthz and /readyz.
+class Readiness
+{
+public:
+    static Readiness &instance()
+    {
+        static Readiness r;
+        return r;
+    }
+
+    void setStage(const std::string &stage)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stage_ = stage;
+    }
+
+    std::string stage() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stage_;
+    }
+
+    // Returns the time since process start, in milliseconds.
+    long long markReady()
+    {
+        setStage("ready");
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now() - started_).count();
+        readyAfterMs_.store(ms, std::memory_order_relaxed);
+        ready_.store(true, std::memory_order_release);
+        return ms;
+    }
+
+    bool ready() const { return ready_.load(std::memory_order_acquire); }
+    long long readyAfterMs() const { return readyAfterMs_.load(std::memory_order_relaxed); }
+
+    long long uptimeMs() const
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - started_).count();
+    }
+
+private:
+    // First use happens at the top of main(), which makes this "process start".
+    Readiness() : started_(std::chrono::steady_clock::now()) {}
+
+    const std::chrono::steady_clock::time_point started_;
+    std::atomic<bool> ready_{false};
+    std::atomic<long long> readyAfterMs_{0};
+    mutable std::mutex mutex_;
+    std::string stage_ = "starting";
+};
@@ -1,12 +1,10 @@
 #pragma once
 #include <drogon/HttpFilter.h>
-#include <spdlog/spdlog.h>
-#include <spdlog/sinks/rotating_file_sink.h>
 #include <chrono>
-#include <sstream>
 #include <memory>
 #include <vector>
 #include <unordered_map>
+#include "BinLog.h"
 
 struct SqlEntry
 {
@@ -19,9 +17,8 @@ class RequestLoggerFilter : public drogon::HttpFilter<RequestLoggerFilter>
 public:
     RequestLoggerFilter()
     {
-        logger_ = spdlog::rotating_logger_mt("request_logger", "logs/request.log", 10485760, 5);
-        logger_->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] %v");
-        logger_->flush_on(spdlog::level::info);
+        // Binary records; read with cppAuth_logcat logs/request.blog
+        logger_ = std::make_shared<BinLog>("logs/request.blog", 10485760, 5);
     }
 
     void doFilter(const drogon::HttpRequestPtr &req,
@@ -40,36 +37,24 @@ public:
                 auto end = std::chrono::steady_clock::now();
                 auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
-                auto sqlLogsPtr = req->attributes()->get<std::vector<SqlEntry>>("sql_logs");
-                std::ostringstream oss;
-                oss << "REQ_ID=" << reqId
-                    << " " << req->methodString() << " " << req->path()
-                    << " STATUS=" << resp->statusCode()
-                    << " DURATION=" << duration << "ms";
+                const auto &sqlLogs = req->attributes()->get<std::vector<SqlEntry>>("sql_logs");
+                BINLOG_INFO(*logger_, "REQ_ID={} {} {} STATUS={} DURATION={}ms",
+                            reqId, req->methodString(), req->path(), resp->statusCode(), duration);
 
-                if (sqlLogsPtr && !sqlLogsPtr->empty())
-                {
-                    oss << " QUERIES=[";
-                    for (size_t i = 0; i < sqlLogsPtr->size(); ++i)
-                    {
-                        oss << "(" << sqlLogsPtr->at(i).durationMs << "ms) " << sqlLogsPtr->at(i).query;
-                        if (i + 1 < sqlLogsPtr->size())
-                            oss << ", ";
-                    }
-                    oss << "]";
-                }
+                // One record per query, tagged with the request id
+                for (const auto &q : sqlLogs)
+                    BINLOG_INFO(*logger_, "REQ_ID={} QUERY ({}ms) {}", reqId, q.durationMs, q.query);
 
-                logger_->info(oss.str());
                 callback(resp);
             });
         }
         catch (const std::exception &e)
         {
-            logger_->error("REQ_ID={} Exception: {}", reqId, e.what());
+            BINLOG_ERROR(*logger_, "REQ_ID={} Exception: {}", reqId, e.what());
             throw;
         }
     }
 
 private:
-    std::shared_ptr<spdlog::logger> logger_;
+    std::shared_ptr<BinLog> logger_;
 };
@@ -18,7 +18,7 @@ public:
                   drogon::FilterCallback &&fcb) override
     {
         auto start = std::chrono::system_clock::now();
-        auto respCallback = [this, req, start, fcb](const drogon::HttpResponsePtr &resp) {
+        auto respCallback = [this, req, start, fcb = std::move(fcb)](const drogon::HttpResponsePtr &resp) {
             logRequest(req, resp, start);
             fcb(resp);
         };
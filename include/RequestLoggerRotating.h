@@ -2,18 +2,17 @@
 #include <drogon/HttpFilter.h>
 #include <drogon/HttpRequest.h>
 #include <drogon/HttpResponse.h>
-#include <spdlog/spdlog.h>
-#include <spdlog/sinks/rotating_file_sink.h>
 #include <chrono>
+#include <memory>
+#include "BinLog.h"
 
 class RequestLoggerRotating : public drogon::HttpFilter<RequestLoggerRotating>
 {
 public:
     RequestLoggerRotating()
     {
-        logger_ = spdlog::rotating_logger_mt("api_logger", "logs/api.log", 1024*1024*5, 3);
-        logger_->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] %v");
-        logger_->flush_on(spdlog::level::info);
+        // Binary records; read with cppAuth_logcat logs/api.blog
+        logger_ = std::make_shared<BinLog>("logs/api.blog", 1024*1024*5, 3);
     }
 
     void doFilter(const drogon::HttpRequestPtr &req,
@@ -28,12 +27,12 @@ public:
             auto end = std::chrono::steady_clock::now();
             auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
-            logger_->info("{} {} => {} ({}ms)", method, path, static_cast<int>(resp->getStatusCode()), ms);
+            BINLOG_INFO(*logger_, "{} {} => {} ({}ms)", method, path, static_cast<int>(resp->getStatusCode()), ms);
 
             f(resp); // continue the chain
         });
     }
 
 private:
-    std::shared_ptr<spdlog::logger> logger_;
+    std::shared_ptr<BinLog> logger_;
 };
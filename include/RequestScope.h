@@ -0,0 +1,51 @@
+#pragma once
+#include <drogon/HttpResponse.h>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+// Everything an async handler needs after it returns, in one allocation.
+//
+// A handler derives a small struct from RequestScope for its own fields,
+// creates it once with RequestScope::make(), and its DB and hashing
+// callbacks capture only that shared_ptr. A lambda holding a single
+// shared_ptr fits std::function's inline buffer, so passing it on costs no
+// further heap allocation, and strings that outgrow SSO come from the
+// scope's inline arena instead of the heap. The response callback lives in
+// the scope too.
+//
+// The arena is monotonic: memory is released all at once when the last
+// callback drops the scope.
+class RequestScope
+{
+public:
+    using Callback = std::function<void(const drogon::HttpResponsePtr &)>;
+
+    explicit RequestScope(Callback &&callback)
+        : arena_(buffer_, sizeof(buffer_)), callback_(std::move(callback)) {}
+
+    RequestScope(const RequestScope &) = delete;
+    RequestScope &operator=(const RequestScope &) = delete;
+
+    template <typename Scope, typename... Args>
+    static std::shared_ptr<Scope> make(Callback &&callback, Args &&...args)
+    {
+        return std::make_shared<Scope>(std::move(callback), std::forward<Args>(args)...);
+    }
+
+    std::pmr::memory_resource *arena() { return &arena_; }
+
+    std::pmr::string string(std::string_view s) { return std::pmr::string(s, &arena_); }
+
+    void respond(const drogon::HttpResponsePtr &resp) const { callback_(resp); }
+
+private:
+    static constexpr std::size_t kInlineBytes = 256;
+
+    alignas(std::max_align_t) std::byte buffer_[kInlineBytes];
+    std::pmr::monotonic_buffer_resource arena_;
+    Callback callback_;
+};
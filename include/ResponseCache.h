@@ -0,0 +1,105 @@
+#pragma once
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpResponse.h>
+#include <array>
+#include <cstddef>
+
+// Constant error responses shared by the controllers.
+enum class CannedResponse : std::size_t
+{
+    InvalidJson,
+    Unauthorized,
+    InvalidAmount,
+    AccountNotFound,
+    InsufficientBalance,
+    UserNotFound,
+    ProfileNotFound,
+    InvalidPassword,
+    InvalidRefreshToken,
+    RefreshTokenExpired,
+    UsernameMissing,
+    ErrorCreatingUser,
+    ErrorLoggingIn,
+    DatabaseError,
+    InvalidAccountNumber,
+    Overloaded,
+    BatchTooLarge,
+    Count
+};
+
+// Pre-built HttpResponse objects for CannedResponse.
+//
+// Drogon renders a response with expiredTime >= 0 once and reuses the
+// header buffer afterwards, so handing the same object out again skips both
+// the allocation and the formatting. That cached buffer is patched in place
+// (Date header) by the loop that sends it, so a cached object may only be
+// used by one IO loop: each IO thread has its own, and on any other thread
+// (DB client, hasher, balance engine, journal) get() builds a fresh response.
+// Never mutate a response obtained from here.
+class ResponseCache
+{
+public:
+    static drogon::HttpResponsePtr get(CannedResponse which)
+    {
+        auto idx = static_cast<std::size_t>(which);
+        if (!onIoLoop())
+            return make(specs()[idx]);
+        thread_local std::array<drogon::HttpResponsePtr, kCount> cache;
+        auto &slot = cache[idx];
+        if (!slot)
+        {
+            slot = make(specs()[idx]);
+            slot->setExpiredTime(0);
+        }
+        return slot;
+    }
+
+private:
+    static constexpr std::size_t kCount = static_cast<std::size_t>(CannedResponse::Count);
+
+    struct Spec
+    {
+        drogon::HttpStatusCode code;
+        const char *body;
+    };
+
+    static drogon::HttpResponsePtr make(const Spec &spec)
+    {
+        auto resp = drogon::HttpResponse::newHttpResponse();
+        resp->setStatusCode(spec.code);
+        resp->setBody(spec.body);
+        return resp;
+    }
+
+    // The main loop and threads outside drogon get an index past the IO
+    // threads'.
+    static bool onIoLoop()
+    {
+        return drogon::app().getCurrentThreadIndex() < drogon::app().getThreadNum();
+    }
+
+    // Order must match CannedResponse.
+    static const std::array<Spec, kCount> &specs()
+    {
+        static const std::array<Spec, kCount> table{{
+            {drogon::k400BadRequest, "Invalid JSON"},
+            {drogon::k401Unauthorized, "Unauthorized"},
+            {drogon::k400BadRequest, "Invalid amount"},
+            {drogon::k404NotFound, "Account not found"},
+            {drogon::k400BadRequest, "Insufficient balance"},
+            {drogon::k401Unauthorized, "User not found"},
+            {drogon::k404NotFound, "User not found"},
+            {drogon::k401Unauthorized, "Invalid password"},
+            {drogon::k401Unauthorized, "Invalid refresh token"},
+            {drogon::k401Unauthorized, "Refresh token expired or invalid"},
+            {drogon::k401Unauthorized, "Username attribute missing"},
+            {drogon::k500InternalServerError, "Error creating user"},
+            {drogon::k500InternalServerError, "Error logging in"},
+            {drogon::k500InternalServerError, "Database error"},
+            {drogon::k400BadRequest, "Invalid account number"},
+            {drogon::k503ServiceUnavailable, "Server overloaded, retry later"},
+            {drogon::k413RequestEntityTooLarge, "Too many transfers in one batch"},
+        }};
+        return table;
+    }
+};
@@ -0,0 +1,174 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Everything a handler may need that can change without a restart.
+struct ConfigSnapshot
+{
+    uint64_t version = 0;
+    std::string jwtSecret;
+    // Still accepted when verifying, never used to sign. Set automatically to
+    // the outgoing secret on rotation, until every token it signed has
+    // expired, or explicitly via JWT_SECRET_PREVIOUS.
+    std::string previousJwtSecret;
+    std::chrono::steady_clock::time_point previousJwtSecretUntil = std::chrono::steady_clock::time_point::max();
+    std::chrono::seconds accessTokenTtl{15 * 60};
+    std::chrono::seconds refreshTokenTtl{7 * 24 * 3600};
+    // Largest amount accepted by a single deposit/withdraw/transfer, 0 = no cap.
+    double maxAmount = 0;
+    // Most items accepted by one POST /transfers/batch.
+    size_t maxBatchItems = 1000;
+    // Shared secret for /admin/* routes; empty disables them.
+    std::string adminToken;
+
+    // previousJwtSecret, or "" once it is no longer accepted.
+    const std::string &acceptedPreviousSecret() const
+    {
+        static const std::string none;
+        return std::chrono::steady_clock::now() < previousJwtSecretUntil ? previousJwtSecret : none;
+    }
+};
+
+// Read-copy-update holder for ConfigSnapshot.
+//
+// Readers do one acquire load of a raw pointer, no lock and no refcount.
+// Writers build a new snapshot and swap it in. Old snapshots are never freed
+// because a reader may still be looking at one; a reload costs a few hundred
+// bytes, which is fine for something driven by SIGHUP or an admin call.
+// Readers should copy out what they need rather than hold the reference
+// across an async hop.
+class RuntimeConfig
+{
+public:
+    static const ConfigSnapshot &current()
+    {
+        const ConfigSnapshot *snap = state().current.load(std::memory_order_acquire);
+        if (snap)
+            return *snap;
+        reloadFromEnv();
+        return *state().current.load(std::memory_order_acquire);
+    }
+
+    // Re-reads .env and the environment and publishes the result. A changed
+    // JWT_SECRET keeps the outgoing one as previousJwtSecret so tokens issued
+    // before the rotation stay valid until they expire.
+    //
+    // .env is parsed into a map that takes precedence over the environment,
+    // not loaded with setenv(): this runs on IO threads while others call
+    // getenv().
+    static const ConfigSnapshot &reloadFromEnv(const std::string &envFile = ".env")
+    {
+        return publish(fromEnv(readEnvFile(envFile)));
+    }
+
+    static const ConfigSnapshot &publish(ConfigSnapshot next)
+    {
+        auto &s = state();
+        std::lock_guard<std::mutex> lock(s.writeMutex);
+        const ConfigSnapshot *prev = s.current.load(std::memory_order_relaxed);
+        if (prev)
+        {
+            next.version = prev->version + 1;
+            auto now = std::chrono::steady_clock::now();
+            if (next.previousJwtSecret.empty() && prev->jwtSecret != next.jwtSecret)
+            {
+                next.previousJwtSecret = prev->jwtSecret;
+                next.previousJwtSecretUntil = now + std::max(prev->accessTokenTtl, prev->refreshTokenTtl);
+            }
+            else if (next.previousJwtSecret.empty() && now < prev->previousJwtSecretUntil)
+            {
+                next.previousJwtSecret = prev->previousJwtSecret;
+                next.previousJwtSecretUntil = prev->previousJwtSecretUntil;
+            }
+        }
+        else
+        {
+            next.version = 1;
+        }
+        s.all.push_back(std::make_unique<ConfigSnapshot>(std::move(next)));
+        const ConfigSnapshot *published = s.all.back().get();
+        s.current.store(published, std::memory_order_release);
+        return *published;
+    }
+
+    using EnvFile = std::map<std::string, std::string>;
+
+    static ConfigSnapshot fromEnv(const EnvFile &file = {})
+    {
+        ConfigSnapshot c;
+        c.jwtSecret = env(file, "JWT_SECRET", "changeme");
+        c.previousJwtSecret = env(file, "JWT_SECRET_PREVIOUS", "");
+        c.accessTokenTtl = std::chrono::seconds(envLong(file, "ACCESS_TOKEN_TTL", 15 * 60));
+        c.refreshTokenTtl = std::chrono::seconds(envLong(file, "REFRESH_TOKEN_TTL", 7 * 24 * 3600));
+        c.maxAmount = std::atof(env(file, "MAX_AMOUNT", "0").c_str());
+        c.maxBatchItems = static_cast<size_t>(envLong(file, "TRANSFER_BATCH_MAX", 1000));
+        c.adminToken = env(file, "ADMIN_TOKEN", "");
+        return c;
+    }
+
+    // KEY=VALUE lines of a dotenv file; blank lines, comments and an
+    // "export " prefix are skipped, one level of quotes is removed. A
+    // missing file gives an empty map.
+    static EnvFile readEnvFile(const std::string &path)
+    {
+        EnvFile out;
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            line = trim(line);
+            if (line.compare(0, 7, "export ") == 0) line = trim(line.substr(7));
+            size_t eq = line.find('=');
+            if (line.empty() || line[0] == '#' || eq == std::string::npos) continue;
+            std::string value = trim(line.substr(eq + 1));
+            if (value.size() >= 2 && (value.front() == '"' || value.front() == '\'') && value.back() == value.front())
+                value = value.substr(1, value.size() - 2);
+            out[trim(line.substr(0, eq))] = value;
+        }
+        return out;
+    }
+
+private:
+    struct State
+    {
+        std::atomic<const ConfigSnapshot *> current{nullptr};
+        std::mutex writeMutex;
+        std::vector<std::unique_ptr<ConfigSnapshot>> all;
+    };
+
+    static State &state()
+    {
+        static State s;
+        return s;
+    }
+
+    static std::string trim(const std::string &s)
+    {
+        size_t b = s.find_first_not_of(" \t\r");
+        if (b == std::string::npos) return {};
+        return s.substr(b, s.find_last_not_of(" \t\r") - b + 1);
+    }
+
+    static std::string env(const EnvFile &file, const char *name, const char *fallback)
+    {
+        auto it = file.find(name);
+        const char *v = it != file.end() ? it->second.c_str() : std::getenv(name);
+        return v && *v ? std::string(v) : std::string(fallback);
+    }
+
+    static long envLong(const EnvFile &file, const char *name, long fallback)
+    {
+        std::string v = env(file, name, "");
+        long n = std::atol(v.c_str());
+        return n > 0 ? n : fallback;
+    }
+};
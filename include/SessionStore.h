@@ -0,0 +1,410 @@
+#pragma once
+#include <drogon/orm/DbClient.h>
+#include <drogon/orm/DbListener.h>
+#include <openssl/evp.h>
+#include <spdlog/spdlog.h>
+#include <trantor/net/EventLoop.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include "DbRouter.h"
+
+// Where refresh tokens live. Each user has at most one current refresh
+// token; /login replaces it and /refresh rotates it.
+//
+//   SESSION_STORE     db (default) or memory
+//   SESSION_POLL_MS   SQLite only: how often other replicas' changes are
+//                     picked up (default 1000)
+//
+// "memory" is a map in this process: a restart logs everyone out and
+// replicas do not see each other's sessions. "db" is DbSessionStore below.
+class SessionStore
+{
+public:
+    enum class Result
+    {
+        Ok,
+        Rejected, // no such session, or not the current token
+        Error
+    };
+    using Done = std::function<void(Result)>;
+
+    struct Options
+    {
+        std::chrono::milliseconds pollInterval{1000};
+
+        static bool persistent()
+        {
+            const char *v = std::getenv("SESSION_STORE");
+            return !v || std::string(v) != "memory";
+        }
+
+        static Options fromEnv()
+        {
+            Options o;
+            if (const char *v = std::getenv("SESSION_POLL_MS"); v && std::atol(v) > 0)
+                o.pollInterval = std::chrono::milliseconds(std::atol(v));
+            return o;
+        }
+    };
+
+    virtual ~SessionStore() = default;
+
+    // Makes `token` the user's current refresh token.
+    virtual void put(const std::string &username, const std::string &token, std::chrono::seconds ttl, Done done) = 0;
+
+    // Ok if `token` is the user's current refresh token.
+    virtual void check(const std::string &username, const std::string &token, Done done) = 0;
+
+    // Replaces `oldToken` with `newToken` if `oldToken` is still current.
+    // Of two concurrent rotations of the same token only one gets Ok, on
+    // any replica.
+    virtual void rotate(const std::string &username, const std::string &oldToken, const std::string &newToken,
+                        std::chrono::seconds ttl, Done done) = 0;
+
+    // Starts background work (invalidation, expiry) on `loop`.
+    virtual void start(trantor::EventLoop *) {}
+
+    static std::string digest(const std::string &token)
+    {
+        static const char digits[] = "0123456789abcdef";
+        unsigned char h[32];
+        unsigned int len = 0;
+        EVP_Digest(token.data(), token.size(), h, &len, EVP_sha256(), nullptr);
+        std::string out;
+        out.reserve(2 * sizeof(h));
+        for (unsigned char c : h)
+        {
+            out.push_back(digits[c >> 4]);
+            out.push_back(digits[c & 15]);
+        }
+        return out;
+    }
+
+    static int64_t nowSeconds()
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+};
+
+// The original behaviour: one map, one mutex, nothing persisted.
+class MemorySessionStore : public SessionStore
+{
+public:
+    void put(const std::string &username, const std::string &token, std::chrono::seconds, Done done) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tokens_[username] = token;
+        }
+        done(Result::Ok);
+    }
+
+    void check(const std::string &username, const std::string &token, Done done) override
+    {
+        bool ok;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = tokens_.find(username);
+            ok = it != tokens_.end() && it->second == token;
+        }
+        done(ok ? Result::Ok : Result::Rejected);
+    }
+
+    void rotate(const std::string &username, const std::string &oldToken, const std::string &newToken,
+                std::chrono::seconds, Done done) override
+    {
+        bool ok = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = tokens_.find(username);
+            if (it != tokens_.end() && it->second == oldToken)
+            {
+                it->second = newToken;
+                ok = true;
+            }
+        }
+        done(ok ? Result::Ok : Result::Rejected);
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::string> tokens_; // username -> refresh token
+};
+
+// Sessions in the `sessions` table on the primary shard, with a cache of
+// what this replica last saw in front of it.
+//
+// Only SHA-256 digests of tokens are stored. check() answers from the cache
+// when it holds the user's current digest and goes to the database
+// otherwise, so a replica that has not seen a session yet, or saw an older
+// one, never rejects on stale data. rotate() is a compare-and-swap on the
+// stored digest, which keeps a refresh token single-use across replicas.
+//
+// Every write gives the row the next value of the one-row session_clock
+// table, bumped in the same transaction. The row lock orders the writes, so
+// versions grow in commit order and never go back, whatever expiry deletes.
+// Other replicas drop their cached copy when they learn of it: on Postgres
+// through NOTIFY on the cppauth_sessions channel (payload
+// "<replica>:<username>"), on SQLite by polling for versions newer than the
+// last one seen. Expired rows are deleted once a minute.
+class DbSessionStore : public SessionStore
+{
+public:
+    static constexpr const char *kChannel = "cppauth_sessions";
+
+    // `pgConnInfo` is set for Postgres, which enables LISTEN/NOTIFY.
+    DbSessionStore(std::shared_ptr<DbRouter> db, Options options, std::string pgConnInfo = {})
+        : db_(std::move(db)), options_(options), pgConnInfo_(std::move(pgConnInfo)),
+          replica_(std::to_string(::getpid()) + "-" + std::to_string(reinterpret_cast<uintptr_t>(this)))
+    {
+    }
+
+    static void ensureSchema(const DbRouter &db)
+    {
+        db.writer()->execSqlSync("CREATE TABLE IF NOT EXISTS sessions ("
+                                 "username VARCHAR(255) PRIMARY KEY, "
+                                 "token_hash VARCHAR(64) NOT NULL, "
+                                 "expires_at BIGINT NOT NULL, "
+                                 "version BIGINT NOT NULL)");
+        db.writer()->execSqlSync("CREATE TABLE IF NOT EXISTS session_clock ("
+                                 "id INTEGER PRIMARY KEY, "
+                                 "version BIGINT NOT NULL)");
+        db.writer()->execSqlSync("INSERT INTO session_clock (id, version) "
+                                 "SELECT 1, COALESCE(MAX(version), 0) FROM sessions WHERE true "
+                                 "ON CONFLICT (id) DO NOTHING");
+    }
+
+    void start(trantor::EventLoop *loop) override
+    {
+        if (!pgConnInfo_.empty())
+            listener_ = drogon::orm::DbListener::newPgListener(pgConnInfo_, loop);
+        if (listener_)
+        {
+            listener_->listen(kChannel, [this](const std::string &, const std::string &payload) {
+                size_t colon = payload.find(':');
+                if (colon == std::string::npos || payload.compare(0, colon, replica_) == 0) return;
+                std::lock_guard<std::mutex> lock(mutex_);
+                cache_.erase(payload.substr(colon + 1));
+            });
+            spdlog::info("Sessions in the database, invalidated through LISTEN {}", kChannel);
+        }
+        else
+        {
+            loop->runEvery(std::chrono::duration<double>(options_.pollInterval).count(), [this] { poll(); });
+            spdlog::info("Sessions in the database, changes polled every {} ms", options_.pollInterval.count());
+        }
+        loop->runEvery(60.0, [this] { expire(); });
+    }
+
+    void put(const std::string &username, const std::string &token, std::chrono::seconds ttl, Done done) override
+    {
+        auto digest = SessionStore::digest(token);
+        int64_t expiresAt = nowSeconds() + ttl.count();
+        writeVersioned(
+            "INSERT INTO sessions (version, username, token_hash, expires_at) VALUES ($1, $2, $3, $4) "
+            "ON CONFLICT (username) DO UPDATE SET token_hash = excluded.token_hash, "
+            "expires_at = excluded.expires_at, version = excluded.version RETURNING version",
+            [this, username, digest, expiresAt, done](const drogon::orm::Result &r) {
+                remember(username, digest, r.empty() ? 0 : r[0]["version"].as<int64_t>(), expiresAt, true);
+                done(Result::Ok);
+            },
+            [done](const std::string &error) {
+                spdlog::error("Session write failed: {}", error);
+                done(Result::Error);
+            },
+            username, digest, expiresAt);
+    }
+
+    void check(const std::string &username, const std::string &token, Done done) override
+    {
+        auto digest = SessionStore::digest(token);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = cache_.find(username);
+            if (it != cache_.end() && it->second.digest == digest && it->second.expiresAt > nowSeconds())
+            {
+                done(Result::Ok);
+                return;
+            }
+        }
+        db_->read(
+            "SELECT token_hash, expires_at, version FROM sessions WHERE username = $1",
+            [this, username, digest, done](const drogon::orm::Result &r) {
+                if (r.empty())
+                {
+                    forget(username);
+                    done(Result::Rejected);
+                    return;
+                }
+                auto stored = r[0]["token_hash"].as<std::string>();
+                auto expiresAt = r[0]["expires_at"].as<int64_t>();
+                remember(username, stored, r[0]["version"].as<int64_t>(), expiresAt, false);
+                done(stored == digest && expiresAt > nowSeconds() ? Result::Ok : Result::Rejected);
+            },
+            [done](const drogon::orm::DrogonDbException &e) {
+                spdlog::error("Session read failed: {}", e.base().what());
+                done(Result::Error);
+            },
+            username);
+    }
+
+    void rotate(const std::string &username, const std::string &oldToken, const std::string &newToken,
+                std::chrono::seconds ttl, Done done) override
+    {
+        auto digest = SessionStore::digest(newToken);
+        int64_t now = nowSeconds();
+        int64_t expiresAt = now + ttl.count();
+        writeVersioned(
+            "UPDATE sessions SET version = $1, token_hash = $2, expires_at = $3 "
+            "WHERE username = $4 AND token_hash = $5 AND expires_at > $6 RETURNING version",
+            [this, username, digest, expiresAt, done](const drogon::orm::Result &r) {
+                if (r.empty())
+                {
+                    forget(username);
+                    done(Result::Rejected);
+                    return;
+                }
+                remember(username, digest, r[0]["version"].as<int64_t>(), expiresAt, true);
+                done(Result::Ok);
+            },
+            [done](const std::string &error) {
+                spdlog::error("Session rotation failed: {}", error);
+                done(Result::Error);
+            },
+            digest, expiresAt, username, SessionStore::digest(oldToken), now);
+    }
+
+private:
+    struct Cached
+    {
+        std::string digest;
+        int64_t version = 0;
+        int64_t expiresAt = 0;
+    };
+
+    // Runs `sql` with the next session_clock value as $1 and `args` after
+    // it, in one transaction with the bump. `rcb` gets the statement's rows;
+    // an empty result (nothing matched) is rolled back and still reported
+    // through `rcb`.
+    template <typename... Args>
+    void writeVersioned(const char *sql, std::function<void(const drogon::orm::Result &)> rcb,
+                        std::function<void(const std::string &)> ecb, Args... args)
+    {
+        struct State
+        {
+            std::optional<drogon::orm::Result> result;
+            std::string error;
+        };
+        auto state = std::make_shared<State>();
+        db_->transaction(
+            [state, sql, args...](const TransactionPtr &trans, std::function<void(bool)> finish) {
+                auto fail = [state, finish](const drogon::orm::DrogonDbException &e) {
+                    state->error = e.base().what();
+                    finish(false);
+                };
+                DbRouter::exec(trans, "UPDATE session_clock SET version = version + 1 WHERE id = 1 RETURNING version",
+                    [state, trans, finish, fail, sql, args...](const drogon::orm::Result &clock) {
+                        if (clock.empty())
+                        {
+                            state->error = "session_clock has no row";
+                            finish(false);
+                            return;
+                        }
+                        DbRouter::exec(trans, sql,
+                            [state, finish](const drogon::orm::Result &r) {
+                                state->result = r;
+                                finish(!r.empty());
+                            },
+                            fail, clock[0]["version"].as<int64_t>(), args...);
+                    },
+                    fail);
+            },
+            [state, rcb = std::move(rcb), ecb = std::move(ecb)](bool committed) {
+                if (state->result && (committed || state->result->empty()))
+                    rcb(*state->result);
+                else
+                    ecb(state->error.empty() ? "transaction not committed" : state->error);
+            });
+    }
+
+    // Caches what this replica just wrote or read; a write is announced to
+    // the other replicas.
+    void remember(const std::string &username, const std::string &digest, int64_t version, int64_t expiresAt,
+                  bool written)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto &c = cache_[username];
+            c.digest = digest;
+            c.version = version;
+            c.expiresAt = expiresAt;
+        }
+        if (written && listener_)
+            db_->write("SELECT pg_notify($1, $2)", [](const drogon::orm::Result &) {},
+                       [](const drogon::orm::DrogonDbException &e) {
+                           spdlog::warn("Session NOTIFY failed: {}", e.base().what());
+                       },
+                       std::string(kChannel), replica_ + ":" + username);
+    }
+
+    void forget(const std::string &username)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cache_.erase(username);
+    }
+
+    // SQLite: drops cached sessions another replica has changed since the
+    // last poll.
+    void poll()
+    {
+        db_->read(
+            "SELECT username, version FROM sessions WHERE version > $1",
+            [this](const drogon::orm::Result &r) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (const auto &row : r)
+                {
+                    auto version = row["version"].as<int64_t>();
+                    auto it = cache_.find(row["username"].as<std::string>());
+                    if (it != cache_.end() && it->second.version != version) cache_.erase(it);
+                    if (version > seen_) seen_ = version;
+                }
+            },
+            [](const drogon::orm::DrogonDbException &e) {
+                spdlog::warn("Session poll failed: {}", e.base().what());
+            },
+            seenVersion());
+    }
+
+    int64_t seenVersion()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return seen_;
+    }
+
+    void expire()
+    {
+        db_->write("DELETE FROM sessions WHERE expires_at <= $1", [](const drogon::orm::Result &) {},
+                   [](const drogon::orm::DrogonDbException &e) {
+                       spdlog::warn("Session expiry failed: {}", e.base().what());
+                   },
+                   nowSeconds());
+    }
+
+    std::shared_ptr<DbRouter> db_;
+    Options options_;
+    std::string pgConnInfo_;
+    std::string replica_; // tags our own notifications so we skip them
+    drogon::orm::DbListenerPtr listener_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Cached> cache_; // username -> last digest seen here
+    int64_t seen_ = 0;                               // highest version polled
+};
@@ -0,0 +1,143 @@
+#pragma once
+#include <drogon/orm/DbClient.h>
+#include <spdlog/spdlog.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "DbRouter.h"
+
+// Accounts partitioned over several databases by a hash of account_number.
+//
+// Shard 0 is the primary database (id_blocks lives there); DB_SHARDS adds
+// more, see main.cc. Each shard holds the users rows of its own accounts, so
+// everything keyed by account number stays on one shard. The usernames table
+// on the primary keeps usernames unique across shards and says which shard
+// a username's row is on (readForUser). The shard of an account depends on
+// the shard count, so the set of shards must not change once accounts
+// exist — there is no rebalancing.
+class ShardMap
+{
+public:
+    explicit ShardMap(std::vector<std::shared_ptr<DbRouter>> shards)
+        : shards_(std::move(shards)) {}
+
+    size_t size() const { return shards_.size(); }
+
+    // 64-bit FNV-1a: cheap, stable across builds and platforms.
+    static uint64_t hash(std::string_view key)
+    {
+        uint64_t h = 14695981039346656037ULL;
+        for (unsigned char c : key)
+        {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    size_t shardOf(std::string_view account) const
+    {
+        return shards_.size() == 1 ? 0 : static_cast<size_t>(hash(account) % shards_.size());
+    }
+
+    const std::shared_ptr<DbRouter> &shard(size_t i) const { return shards_[i]; }
+    const std::shared_ptr<DbRouter> &primary() const { return shards_.front(); }
+    const std::shared_ptr<DbRouter> &forAccount(std::string_view account) const
+    {
+        return shards_[shardOf(account)];
+    }
+
+    // usernames (primary, sharded setups only): username -> account number.
+    // Its primary key is what keeps usernames unique across shards. Users
+    // that exist before the table does are copied in on first start.
+    void ensureSchema() const
+    {
+        if (shards_.size() == 1)
+            return;
+        const auto &client = primary()->writer();
+        client->execSqlSync("CREATE TABLE IF NOT EXISTS usernames ("
+                            "username VARCHAR(255) PRIMARY KEY, "
+                            "account_number VARCHAR(32) NOT NULL)");
+        if (!client->execSqlSync("SELECT username FROM usernames LIMIT 1").empty())
+            return;
+        for (const auto &shard : shards_)
+        {
+            for (const auto &row : shard->writer()->execSqlSync("SELECT username, account_number FROM users"))
+            {
+                auto username = row["username"].as<std::string>();
+                auto claimed = client->execSqlSync(kClaimSql, username, row["account_number"].as<std::string>());
+                if (claimed.empty())
+                    spdlog::warn("Username {} exists on more than one shard; only the first one can log in", username);
+            }
+        }
+    }
+
+    // Reserves `username` for `account` before its users row is written;
+    // done(false) if someone else has it.
+    void claimUsername(const std::string &username, const std::string &account,
+                       std::function<void(bool)> done, drogon::orm::ExceptionCallback ecb)
+    {
+        if (shards_.size() == 1)
+        {
+            done(true); // the users table's own constraint decides
+            return;
+        }
+        primary()->write(
+            kClaimSql,
+            [done = std::move(done)](const drogon::orm::Result &r) { done(!r.empty()); },
+            std::move(ecb),
+            username, account);
+    }
+
+    // Undoes claimUsername() when the users row could not be written.
+    void releaseUsername(const std::string &username, const std::string &account)
+    {
+        if (shards_.size() == 1)
+            return;
+        primary()->write(
+            "DELETE FROM usernames WHERE username=$1 AND account_number=$2",
+            [](const drogon::orm::Result &) {},
+            [username](const drogon::orm::DrogonDbException &e) {
+                spdlog::warn("Releasing username {} failed: {}", username, e.base().what());
+            },
+            username, account);
+    }
+
+    // Runs a read on the shard that holds `username`. A username nobody
+    // registered gets an empty result.
+    template <typename... Args>
+    void readForUser(const std::string &username,
+                     const std::string &sql,
+                     drogon::orm::ResultCallback rcb,
+                     drogon::orm::ExceptionCallback ecb,
+                     Args &&...args)
+    {
+        if (shards_.size() == 1)
+        {
+            shards_[0]->read(sql, std::move(rcb), std::move(ecb), std::forward<Args>(args)...);
+            return;
+        }
+        primary()->read(
+            "SELECT account_number FROM usernames WHERE username=$1",
+            [this, sql, rcb, ecb, args...](const drogon::orm::Result &r) {
+                if (r.empty())
+                {
+                    rcb(r);
+                    return;
+                }
+                forAccount(r[0]["account_number"].as<std::string>())->read(sql, rcb, ecb, args...);
+            },
+            ecb,
+            username);
+    }
+
+private:
+    static constexpr const char *kClaimSql =
+        "INSERT INTO usernames (username, account_number) VALUES ($1, $2) "
+        "ON CONFLICT (username) DO NOTHING RETURNING username";
+
+    std::vector<std::shared_ptr<DbRouter>> shards_;
+};
@@ -0,0 +1,175 @@
+#pragma once
+#include <drogon/orm/DbClient.h>
+#include <drogon/orm/Exception.h>
+#include <spdlog/spdlog.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Coalesces identical concurrent reads.
+//
+// The first request for a key (statement plus parameters) runs the query;
+// requests for the same key arriving while it is in flight attach to it and
+// get the same Result. A flight takes at most maxWaiters callers; the next
+// one starts a fresh query that later callers join instead.
+//
+// Writers call forget() for the keys they change once the write has
+// committed and before they respond. Reads that start after that never join
+// a query that may have run before the write, so a client always sees its
+// own writes; a read concurrent with the write may see either value, as it
+// could without coalescing.
+class SingleFlight
+{
+public:
+    struct Options
+    {
+        size_t maxWaiters = 64;
+
+        static bool enabled()
+        {
+            const char *v = std::getenv("SINGLEFLIGHT");
+            return !v || std::string(v) != "0";
+        }
+
+        static Options fromEnv()
+        {
+            Options o;
+            if (const char *v = std::getenv("SINGLEFLIGHT_MAX_WAITERS")) o.maxWaiters = std::strtoul(v, nullptr, 10);
+            if (o.maxWaiters == 0) o.maxWaiters = 1;
+            return o;
+        }
+    };
+
+    struct Stats
+    {
+        uint64_t queries;  // flights started
+        uint64_t joined;   // callers served by someone else's query
+        uint64_t overflow; // flights started because one was full
+    };
+
+    SingleFlight() : SingleFlight(Options()) {}
+    explicit SingleFlight(Options options) : options_(options) {}
+
+    // Statement and parameters joined with a separator no SQL text or
+    // account number contains.
+    static std::string key(std::string_view sql, std::initializer_list<std::string_view> params)
+    {
+        std::string k(sql);
+        for (auto p : params)
+        {
+            k += '\x1f';
+            k += p;
+        }
+        return k;
+    }
+
+    // Calls `launch(rcb, ecb)` to run the query unless one for `key` is
+    // already in flight; either way `rcb` or `ecb` is called exactly once.
+    template <typename Launch>
+    void run(std::string key, drogon::orm::ResultCallback rcb, drogon::orm::ExceptionCallback ecb, Launch &&launch)
+    {
+        Stripe &s = stripe(key);
+        auto flight = std::make_shared<Flight>();
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            auto it = s.flights.find(key);
+            if (it != s.flights.end())
+            {
+                if (it->second->waiters.size() < options_.maxWaiters)
+                {
+                    it->second->waiters.emplace_back(std::move(rcb), std::move(ecb));
+                    joined_.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                overflow_.fetch_add(1, std::memory_order_relaxed);
+                it->second = flight; // the full one still answers its own waiters
+            }
+            else
+                s.flights.emplace(key, flight);
+            flight->waiters.emplace_back(std::move(rcb), std::move(ecb));
+        }
+        queries_.fetch_add(1, std::memory_order_relaxed);
+
+        launch(
+            [this, key, flight](const drogon::orm::Result &r) {
+                for (auto &w : land(key, flight))
+                    deliver([&] { w.first(r); });
+            },
+            [this, key, flight](const drogon::orm::DrogonDbException &e) {
+                for (auto &w : land(key, flight))
+                    if (w.second) deliver([&] { w.second(e); });
+            });
+    }
+
+    // Later reads of `key` start a new query.
+    void forget(const std::string &key)
+    {
+        Stripe &s = stripe(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.flights.erase(key);
+    }
+
+    Stats stats() const
+    {
+        return Stats{queries_.load(std::memory_order_relaxed), joined_.load(std::memory_order_relaxed),
+                     overflow_.load(std::memory_order_relaxed)};
+    }
+
+private:
+    static constexpr size_t kStripes = 16;
+
+    using Waiter = std::pair<drogon::orm::ResultCallback, drogon::orm::ExceptionCallback>;
+
+    struct Flight
+    {
+        std::vector<Waiter> waiters; // guarded by the stripe's mutex
+    };
+
+    struct Stripe
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<Flight>> flights;
+    };
+
+    Stripe &stripe(const std::string &key) { return stripes_[std::hash<std::string>()(key) % kStripes]; }
+
+    // Closes the flight to new waiters and hands back everyone attached.
+    std::vector<Waiter> land(const std::string &key, const std::shared_ptr<Flight> &flight)
+    {
+        Stripe &s = stripe(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.flights.find(key);
+        if (it != s.flights.end() && it->second == flight) s.flights.erase(it);
+        return std::move(flight->waiters);
+    }
+
+    // One waiter's callback throwing must not cost the others their answer.
+    template <typename F>
+    static void deliver(F &&f)
+    {
+        try
+        {
+            f();
+        }
+        catch (const std::exception &e)
+        {
+            spdlog::error("Coalesced read callback threw: {}", e.what());
+        }
+    }
+
+    Options options_;
+    Stripe stripes_[kStripes];
+    std::atomic<uint64_t> queries_{0};
+    std::atomic<uint64_t> joined_{0};
+    std::atomic<uint64_t> overflow_{0};
+};
@@ -0,0 +1,151 @@
+#pragma once
+#include <drogon/orm/DbClient.h>
+#include <drogon/orm/Exception.h>
+#include <spdlog/spdlog.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "DbRouter.h"
+#include "JsonWriter.h"
+#include "LogThreads.h"
+
+// With SLOW_QUERY_MS set (the log is off by default), statements slower
+// than that go to logs/slow_query.log as one JSON line each, with their
+// fingerprint and bound parameter types; a random SLOW_QUERY_SAMPLE fraction
+// of the faster ones is logged too, as a baseline.
+// The first slow run of a fingerprint in every SLOW_QUERY_EXPLAIN_SECONDS
+// window also gets its plan captured (EXPLAIN QUERY PLAN on SQLite, EXPLAIN
+// (GENERIC_PLAN) on Postgres 16+) on a separate one-connection client, so
+// the EXPLAIN never queues behind the traffic it is diagnosing.
+//
+// A fast, unsampled statement costs one comparison and, with sampling on,
+// one xorshift step; nothing is locked or allocated.
+class SlowQueryLog : public QueryObserver
+{
+public:
+    struct Options
+    {
+        std::chrono::milliseconds threshold{200};
+        double sampleRate = 0.0;
+        std::chrono::seconds explainInterval{300};
+
+        // Off unless SLOW_QUERY_MS is set above 0.
+        static bool enabled()
+        {
+            const char *v = std::getenv("SLOW_QUERY_MS");
+            return v && std::atol(v) > 0;
+        }
+
+        static Options fromEnv()
+        {
+            Options o;
+            if (const char *v = std::getenv("SLOW_QUERY_MS"))
+                o.threshold = std::chrono::milliseconds(std::atol(v));
+            if (const char *v = std::getenv("SLOW_QUERY_SAMPLE"))
+                o.sampleRate = std::atof(v);
+            if (const char *v = std::getenv("SLOW_QUERY_EXPLAIN_SECONDS"))
+                o.explainInterval = std::chrono::seconds(std::atol(v));
+            return o;
+        }
+    };
+
+    // `explainClient` may be null, in which case no plans are captured.
+    SlowQueryLog(Options options, drogon::orm::DbClientPtr explainClient, bool sqlite)
+        : options_(options),
+          explainClient_(std::move(explainClient)),
+          explainPrefix_(sqlite ? "EXPLAIN QUERY PLAN " : "EXPLAIN (GENERIC_PLAN) "),
+          log_(LogThreads::rotating("slow_query", "logs/slow_query.log", 1024 * 1024 * 5, 3))
+    {
+    }
+
+    void onQuery(const QueryEvent &event) override
+    {
+        bool slow = event.elapsed >= options_.threshold;
+        if (!slow && !(options_.sampleRate > 0 && sampled()))
+            return;
+
+        JsonWriter w;
+        w.field("type", "query")
+            .field("fingerprint", hex(event.fingerprint->id))
+            .field("sql", event.fingerprint->text)
+            .field("params", event.paramTypes)
+            .field("ms", std::chrono::duration<double, std::milli>(event.elapsed).count())
+            .field("rows", static_cast<int64_t>(event.rows))
+            .field("slow", slow);
+        if (event.error)
+            w.field("error", event.error);
+        log_->info("{}", w.str());
+
+        if (slow && explainClient_ && explainDue(event.fingerprint->id))
+            explain(event.fingerprint, event.paramTypes);
+    }
+
+private:
+    static std::string hex(uint64_t id)
+    {
+        char buf[17];
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(id));
+        return buf;
+    }
+
+    bool sampled() const
+    {
+        thread_local uint64_t state = 0x9E3779B97F4A7C15ULL ^ reinterpret_cast<uintptr_t>(&state);
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return static_cast<double>(state >> 11) * 0x1.0p-53 < options_.sampleRate;
+    }
+
+    // At most one EXPLAIN per fingerprint per interval.
+    bool explainDue(uint64_t id)
+    {
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(explainMutex_);
+        auto it = lastExplain_.find(id);
+        if (it != lastExplain_.end() && now - it->second < options_.explainInterval)
+            return false;
+        lastExplain_[id] = now;
+        return true;
+    }
+
+    // Runs the statement's raw text (placeholders left unbound) through
+    // EXPLAIN; each plan row's last column is one line of the plan.
+    void explain(const SqlFingerprint::Entry *fp, const std::string &paramTypes)
+    {
+        auto log = log_;
+        explainClient_->execSqlAsync(
+            explainPrefix_ + fp->sample,
+            [log, fp, &paramTypes](const drogon::orm::Result &r) {
+                std::string plan;
+                for (const auto &row : r)
+                {
+                    if (!plan.empty()) plan += '\n';
+                    plan += row[row.size() - 1].as<std::string>();
+                }
+                JsonWriter w;
+                w.field("type", "plan")
+                    .field("fingerprint", hex(fp->id))
+                    .field("sql", fp->sample)
+                    .field("params", paramTypes)
+                    .field("plan", plan);
+                log->info("{}", w.str());
+            },
+            [fp](const drogon::orm::DrogonDbException &e) {
+                spdlog::warn("EXPLAIN failed for {}: {}", hex(fp->id), e.base().what());
+            });
+    }
+
+    Options options_;
+    drogon::orm::DbClientPtr explainClient_;
+    std::string explainPrefix_;
+    std::shared_ptr<spdlog::logger> log_;
+
+    std::mutex explainMutex_;
+    std::unordered_map<uint64_t, std::chrono::steady_clock::time_point> lastExplain_;
+};
@@ -0,0 +1,213 @@
+#pragma once
+#include <cctype>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+// Normalised shape of a SQL statement: literals and bind parameters become
+// '?', insignificant whitespace is dropped and everything is lower-cased, so
+//   SELECT balance FROM users WHERE account_number=$1
+//   select balance from users where account_number = 'ACCT0000000018'
+// share one fingerprint. Entries are interned for the life of the process;
+// of() caches the text -> entry lookup per thread, so after the first call
+// a statement costs one hash of its text.
+class SqlFingerprint
+{
+public:
+    struct Entry
+    {
+        uint64_t id;      // FNV-1a of `text`
+        uint32_t index;   // dense, in order of first sight
+        std::string text; // normalised statement
+        std::string sample; // first raw statement seen with this shape
+    };
+
+    static std::string normalize(std::string_view sql)
+    {
+        std::string out;
+        out.reserve(sql.size());
+        bool space = false;
+        for (size_t i = 0; i < sql.size();)
+        {
+            char c = sql[i];
+            if (std::isspace(static_cast<unsigned char>(c)))
+            {
+                space = !out.empty();
+                ++i;
+                continue;
+            }
+            auto emit = [&](std::string_view token) {
+                if (space && !out.empty() && isWord(out.back()) && isWord(token.front()))
+                    out.push_back(' ');
+                space = false;
+                out.append(token);
+            };
+            if (c == '\'')
+            {
+                // string literal, '' is an escaped quote
+                ++i;
+                while (i < sql.size())
+                {
+                    if (sql[i] == '\'' && i + 1 < sql.size() && sql[i + 1] == '\'')
+                        i += 2;
+                    else if (sql[i++] == '\'')
+                        break;
+                }
+                emit("?");
+            }
+            else if (c == '$' || c == '?')
+            {
+                // $1, ?1, ? placeholders
+                ++i;
+                while (i < sql.size() && std::isdigit(static_cast<unsigned char>(sql[i])))
+                    ++i;
+                emit("?");
+            }
+            else if (std::isdigit(static_cast<unsigned char>(c)) ||
+                     (c == '.' && i + 1 < sql.size() && std::isdigit(static_cast<unsigned char>(sql[i + 1]))))
+            {
+                while (i < sql.size() && (std::isalnum(static_cast<unsigned char>(sql[i])) || sql[i] == '.'))
+                    ++i;
+                emit("?");
+            }
+            else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_' || c == '"')
+            {
+                size_t start = i++;
+                while (i < sql.size() && (std::isalnum(static_cast<unsigned char>(sql[i])) || sql[i] == '_' ||
+                                          sql[i] == '"' || sql[i] == '.'))
+                    ++i;
+                std::string word(sql.substr(start, i - start));
+                for (auto &ch : word)
+                    ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+                emit(word);
+            }
+            else
+            {
+                char p[2] = {c, 0};
+                emit(std::string_view(p, 1));
+                ++i;
+            }
+        }
+        collapseLists(out);
+        return out;
+    }
+
+    static uint64_t hash(std::string_view s)
+    {
+        uint64_t h = 14695981039346656037ULL;
+        for (unsigned char c : s)
+        {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    // Interned entry for `sql`; the pointer stays valid forever.
+    static const Entry *of(const std::string &sql)
+    {
+        thread_local std::unordered_map<std::string, const Entry *> cache;
+        auto it = cache.find(sql);
+        if (it != cache.end())
+            return it->second;
+        const Entry *e = intern(normalize(sql), sql);
+        cache.emplace(sql, e);
+        return e;
+    }
+
+    // Every fingerprint seen so far, in index order.
+    static std::vector<const Entry *> all()
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        std::vector<const Entry *> out;
+        out.reserve(registry().entries.size());
+        for (const auto &e : registry().entries)
+            out.push_back(&e);
+        return out;
+    }
+
+    // "double, string" for the bound argument types of a statement.
+    template <typename... Args>
+    static std::string paramTypes()
+    {
+        std::string out;
+        ((out += (out.empty() ? "" : ", "), out += typeName<Args>()), ...);
+        return out;
+    }
+
+private:
+    // Whitespace is kept only where it separates two words.
+    static bool isWord(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '"' || c == '?';
+    }
+
+    // "in (?, ?, ?)" -> "in (?...)"
+    static void collapseLists(std::string &s)
+    {
+        const std::string many = "(?,?";
+        size_t pos = 0;
+        while ((pos = s.find(many, pos)) != std::string::npos)
+        {
+            size_t end = pos + 1;
+            while (end + 1 < s.size() && s[end] == '?' && s[end + 1] == ',')
+                end += 2;
+            if (end < s.size() && s[end] == '?')
+                s.replace(pos + 1, end + 1 - (pos + 1), "?...");
+            pos += 1;
+        }
+    }
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::deque<Entry> entries; // deque: stable addresses
+        std::unordered_map<std::string_view, const Entry *> byText;
+    };
+
+    static Registry &registry()
+    {
+        static Registry r;
+        return r;
+    }
+
+    static const Entry *intern(std::string text, const std::string &sample)
+    {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        auto it = r.byText.find(text);
+        if (it != r.byText.end())
+            return it->second;
+        uint64_t id = hash(text);
+        auto index = static_cast<uint32_t>(r.entries.size());
+        r.entries.push_back(Entry{id, index, std::move(text), sample});
+        const Entry *e = &r.entries.back();
+        r.byText.emplace(e->text, e);
+        return e;
+    }
+
+    template <typename T>
+    static const char *typeName()
+    {
+        using U = std::decay_t<T>;
+        if constexpr (std::is_same_v<U, std::string> || std::is_same_v<U, const char *> ||
+                      std::is_same_v<U, char *> || std::is_same_v<U, std::string_view>)
+            return "string";
+        else if constexpr (std::is_same_v<U, double> || std::is_same_v<U, float>)
+            return "double";
+        else if constexpr (std::is_same_v<U, bool>)
+            return "bool";
+        else if constexpr (std::is_integral_v<U>)
+            return "int";
+        else if constexpr (std::is_same_v<U, std::nullptr_t>)
+            return "null";
+        else
+            return typeid(U).name();
+    }
+};
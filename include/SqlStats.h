@@ -0,0 +1,118 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "DbRouter.h"
+#include "SqlFingerprint.h"
+
+// Per-fingerprint totals for every statement run through DbRouter::exec():
+// executions, total and max time, rows returned and errors.
+//
+// Each thread that completes queries owns a flat table indexed by
+// SqlFingerprint::Entry::index. Only the owner writes to it, so an update is
+// a handful of relaxed load/store pairs with no lock and no read-modify-write;
+// readers sum the tables of all threads. Fingerprints past kMaxFingerprints
+// share the last slot. Tables are never freed, so totals survive the threads
+// that produced them. Meant to be a single process-wide instance.
+class SqlStats : public QueryObserver
+{
+public:
+    static constexpr uint32_t kMaxFingerprints = 1024;
+
+    struct Row
+    {
+        const SqlFingerprint::Entry *fingerprint = nullptr; // null for the overflow slot
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+        uint64_t maxNs = 0;
+        uint64_t rows = 0;
+        uint64_t errors = 0;
+
+        double totalMs() const { return totalNs / 1e6; }
+        double meanMs() const { return count ? totalNs / 1e6 / count : 0.0; }
+        double maxMs() const { return maxNs / 1e6; }
+    };
+
+    void onQuery(const QueryEvent &event) override
+    {
+        Slot &s = table().slots[std::min(event.fingerprint->index, kMaxFingerprints - 1)];
+        auto ns = static_cast<uint64_t>(event.elapsed.count());
+        bump(s.count, 1);
+        bump(s.totalNs, ns);
+        bump(s.rows, event.rows);
+        if (event.error)
+            bump(s.errors, 1);
+        if (ns > s.maxNs.load(std::memory_order_relaxed))
+            s.maxNs.store(ns, std::memory_order_relaxed);
+    }
+
+    // Totals across threads, one row per fingerprint that has run.
+    std::vector<Row> snapshot() const
+    {
+        auto entries = SqlFingerprint::all();
+        std::vector<Row> rows(std::min<size_t>(entries.size(), kMaxFingerprints));
+        for (size_t i = 0; i < rows.size(); ++i)
+            rows[i].fingerprint = entries[i];
+        if (entries.size() > kMaxFingerprints)
+            rows.back().fingerprint = nullptr;
+
+        std::lock_guard<std::mutex> lock(tablesMutex_);
+        for (const Table *t : tables_)
+        {
+            for (size_t i = 0; i < rows.size(); ++i)
+            {
+                const Slot &s = t->slots[i];
+                rows[i].count += s.count.load(std::memory_order_relaxed);
+                rows[i].totalNs += s.totalNs.load(std::memory_order_relaxed);
+                rows[i].rows += s.rows.load(std::memory_order_relaxed);
+                rows[i].errors += s.errors.load(std::memory_order_relaxed);
+                rows[i].maxNs = std::max(rows[i].maxNs, s.maxNs.load(std::memory_order_relaxed));
+            }
+        }
+        rows.erase(std::remove_if(rows.begin(), rows.end(), [](const Row &r) { return r.count == 0; }),
+                   rows.end());
+        return rows;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> totalNs{0};
+        std::atomic<uint64_t> maxNs{0};
+        std::atomic<uint64_t> rows{0};
+        std::atomic<uint64_t> errors{0};
+    };
+
+    struct Table
+    {
+        Slot slots[kMaxFingerprints];
+    };
+
+    // Single writer per slot: a plain store is enough, readers see either
+    // the old or the new value.
+    static void bump(std::atomic<uint64_t> &a, uint64_t n)
+    {
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    Table &table()
+    {
+        thread_local Table *mine = nullptr;
+        if (!mine)
+        {
+            mine = new Table();
+            std::lock_guard<std::mutex> lock(tablesMutex_);
+            tables_.push_back(mine);
+        }
+        return *mine;
+    }
+
+    mutable std::mutex tablesMutex_;
+    std::vector<Table *> tables_;
+};
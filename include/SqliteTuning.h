@@ -0,0 +1,104 @@
+#pragma once
+#include <drogon/orm/DbClient.h>
+#include <spdlog/spdlog.h>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "DbRouter.h"
+#include "SqliteWriteBatcher.h"
+
+// SQLite high-concurrency mode, enabled with SQLITE_MODE=concurrent:
+//
+//   SQLITE_READERS      read-only connections (default 4)
+//   SQLITE_SYNCHRONOUS  OFF | NORMAL | FULL (default NORMAL, safe under WAL)
+//   SQLITE_MMAP_SIZE    bytes of the file to mmap (default 256MB)
+//   SQLITE_BATCH_MAX    most writes per group commit (default 256)
+//
+// The database is switched to WAL so readers never wait for the writer. One
+// writer connection takes every write through SqliteWriteBatcher, and reads
+// are spread over the reader pool. Drogon already keeps a prepared-statement
+// cache per SQLite connection, so repeated statements are compiled once per
+// connection.
+//
+// Every connection, writer and readers alike, is its own one-connection
+// client, so its pragmas can be set before it serves anything: drogon does
+// not say which connection of a pool runs a given statement.
+struct SqliteTuning
+{
+    size_t readers = 4;
+    std::string synchronous = "NORMAL";
+    long long mmapSize = 256LL * 1024 * 1024;
+    size_t batchMax = 256;
+
+    static bool enabled()
+    {
+        const char *mode = std::getenv("SQLITE_MODE");
+        return mode && std::string(mode) == "concurrent";
+    }
+
+    static SqliteTuning fromEnv()
+    {
+        SqliteTuning t;
+        if (const char *v = std::getenv("SQLITE_READERS"); v && std::atol(v) > 0)
+            t.readers = static_cast<size_t>(std::atol(v));
+        if (const char *v = std::getenv("SQLITE_SYNCHRONOUS"); v && *v)
+            t.synchronous = v;
+        if (const char *v = std::getenv("SQLITE_MMAP_SIZE"); v && *v)
+            t.mmapSize = std::atoll(v);
+        if (const char *v = std::getenv("SQLITE_BATCH_MAX"); v && std::atol(v) > 0)
+            t.batchMax = static_cast<size_t>(std::atol(v));
+        if (t.synchronous != "OFF" && t.synchronous != "NORMAL" && t.synchronous != "FULL")
+            t.synchronous = "NORMAL";
+        return t;
+    }
+
+    // Opens the writer and reader clients on `file` and returns a router
+    // over them.
+    std::shared_ptr<DbRouter> open(const std::string &file) const
+    {
+        auto writer = drogon::orm::DbClient::newSqlite3Client(file, 1);
+        // journal_mode is stored in the file, so once is enough.
+        apply(writer, "PRAGMA journal_mode=WAL");
+        configure(writer, false);
+
+        std::vector<drogon::orm::DbClientPtr> readers;
+        for (size_t i = 0; i < readerCount(); ++i)
+        {
+            readers.push_back(drogon::orm::DbClient::newSqlite3Client(file, 1));
+            configure(readers.back(), true);
+        }
+
+        spdlog::info("SQLite concurrent mode: WAL, synchronous={}, mmap_size={}, {} readers, batch<={}",
+                     synchronous, mmapSize, readerCount(), batchMax);
+        return std::make_shared<DbRouter>(writer, std::move(readers),
+                                          std::make_shared<SqliteWriteBatcher>(writer, batchMax));
+    }
+
+private:
+    size_t readerCount() const { return readers ? readers : 1; }
+
+    // Per-connection pragmas on a one-connection client, so every one of
+    // them reaches that connection before open() returns.
+    void configure(const drogon::orm::DbClientPtr &client, bool readOnly) const
+    {
+        apply(client, "PRAGMA synchronous=" + synchronous);
+        apply(client, "PRAGMA mmap_size=" + std::to_string(mmapSize));
+        apply(client, "PRAGMA busy_timeout=5000");
+        if (readOnly)
+            apply(client, "PRAGMA query_only=1");
+    }
+
+    static void apply(const drogon::orm::DbClientPtr &client, const std::string &pragma)
+    {
+        try
+        {
+            client->execSqlSync(pragma);
+        }
+        catch (const drogon::orm::DrogonDbException &e)
+        {
+            throw std::runtime_error(pragma + " failed: " + e.base().what());
+        }
+    }
+};
@@ -0,0 +1,161 @@
+#pragma once
+#include <drogon/orm/DbClient.h>
+#include <drogon/orm/Exception.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using TransactionPtr = std::shared_ptr<drogon::orm::Transaction>;
+
+// One unit of write work. `work` runs inside a transaction and must call
+// `finish(true)` to keep its changes or `finish(false)` to discard them;
+// `done(committed)` fires once the enclosing transaction has ended. Through
+// the batcher `work` may run more than once (see below), so it must not
+// rely on state left behind by an earlier attempt.
+struct WriteOp
+{
+    std::function<void(const TransactionPtr &, std::function<void(bool)>)> work;
+    std::function<void(bool)> done;
+};
+
+// Group commit for a single SQLite writer connection.
+//
+// Writes queue up while the current batch is being applied; when it commits,
+// everything that arrived meanwhile goes out as the next batch in one
+// transaction. Under load that turns N fsyncs into one, and with no load a
+// write still starts immediately (no timer). Callers only hear about success
+// after COMMIT.
+//
+// Each op runs inside its own SAVEPOINT, so an op that calls finish(false)
+// is rolled back alone. A failing statement is different: drogon rolls the
+// whole transaction back on any error. The op that hit it then fails, and
+// every other op of the batch is queued again at the front, to run in the
+// next batch. Each failure removes one op, so the queue always drains.
+class SqliteWriteBatcher : public std::enable_shared_from_this<SqliteWriteBatcher>
+{
+public:
+    explicit SqliteWriteBatcher(drogon::orm::DbClientPtr writer, size_t maxBatch = 256)
+        : writer_(std::move(writer)), maxBatch_(maxBatch) {}
+
+    void submit(WriteOp op)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(op));
+            if (inFlight_)
+                return;
+            inFlight_ = true;
+        }
+        startBatch();
+    }
+
+    const drogon::orm::DbClientPtr &writer() const { return writer_; }
+
+private:
+    drogon::orm::DbClientPtr writer_;
+    size_t maxBatch_;
+    std::mutex mutex_;
+    std::vector<WriteOp> queue_;
+    bool inFlight_ = false;
+
+    struct Batch
+    {
+        std::vector<WriteOp> ops;
+        std::vector<char> kept;
+        bool ended = false; // committed, or abandoned after an error
+    };
+
+    void startBatch()
+    {
+        auto batch = std::make_shared<Batch>();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queue_.empty())
+            {
+                inFlight_ = false;
+                return;
+            }
+            if (queue_.size() <= maxBatch_)
+            {
+                batch->ops.swap(queue_);
+            }
+            else
+            {
+                batch->ops.assign(std::make_move_iterator(queue_.begin()),
+                                  std::make_move_iterator(queue_.begin() + maxBatch_));
+                queue_.erase(queue_.begin(), queue_.begin() + maxBatch_);
+            }
+        }
+        batch->kept.assign(batch->ops.size(), 0);
+
+        auto self = shared_from_this();
+        writer_->newTransactionAsync([self, batch](const TransactionPtr &trans) {
+            trans->setCommitCallback([self, batch](bool committed) {
+                if (batch->ended)
+                    return;
+                batch->ended = true;
+                for (size_t i = 0; i < batch->ops.size(); ++i)
+                    if (batch->ops[i].done)
+                        batch->ops[i].done(committed && batch->kept[i]);
+                self->startBatch();
+            });
+            self->runOp(trans, batch, 0);
+        });
+    }
+
+    // Applies ops[i] inside a savepoint, then moves on. The transaction
+    // commits when the last reference to `trans` goes away after the final op.
+    void runOp(TransactionPtr trans, std::shared_ptr<Batch> batch, size_t i)
+    {
+        if (i == batch->ops.size())
+            return;
+        auto self = shared_from_this();
+        auto onError = [self, batch, i](const drogon::orm::DrogonDbException &) { self->abandon(batch, i); };
+        trans->execSqlAsync(
+            "SAVEPOINT batch_op",
+            [self, trans, batch, i, onError](const drogon::orm::Result &) {
+                batch->ops[i].work(trans, [self, trans, batch, i, onError](bool keep) {
+                    batch->kept[i] = keep ? 1 : 0;
+                    auto next = [self, trans, batch, i](const drogon::orm::Result &) {
+                        self->runOp(trans, batch, i + 1);
+                    };
+                    if (keep)
+                    {
+                        trans->execSqlAsync("RELEASE SAVEPOINT batch_op", next, onError);
+                    }
+                    else
+                    {
+                        trans->execSqlAsync(
+                            "ROLLBACK TO SAVEPOINT batch_op",
+                            [trans, next, onError](const drogon::orm::Result &) {
+                                trans->execSqlAsync("RELEASE SAVEPOINT batch_op", next, onError);
+                            },
+                            onError);
+                    }
+                });
+            },
+            onError);
+    }
+
+    // The transaction died while ops[i] was running, and drogon has already
+    // rolled it back, so its commit callback will not fire. ops[i] fails; the
+    // others go back to the front of the queue in their original order.
+    void abandon(const std::shared_ptr<Batch> &batch, size_t i)
+    {
+        if (batch->ended)
+            return;
+        batch->ended = true;
+        WriteOp failed = std::move(batch->ops[i]);
+        batch->ops.erase(batch->ops.begin() + static_cast<std::ptrdiff_t>(i));
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.insert(queue_.begin(), std::make_move_iterator(batch->ops.begin()),
+                          std::make_move_iterator(batch->ops.end()));
+        }
+        batch->ops.clear();
+        if (failed.done)
+            failed.done(false);
+        startBatch();
+    }
+};
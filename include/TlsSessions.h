@@ -0,0 +1,319 @@
+#pragma once
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Native TLS listeners, configured from the environment:
+//
+//   TLS_LISTEN           comma-separated ip:port pairs served over TLS (none by default)
+//   TLS_CERT, TLS_KEY    PEM certificate chain and private key
+//   TLS_MIN_PROTOCOL     TLSv1.2 (default) or TLSv1.3
+//   TLS_TICKET_SECRET    secret the session-ticket keys are derived from
+//   TLS_TICKET_ROTATE_S  lifetime of a ticket key (default 3600)
+//   TLS_SESSION_CACHE    server-side session cache entries (default 20480, 0 = off)
+//
+// Ticket keys are derived from the secret and the current rotation period,
+// so every IO thread, worker and replica with the same secret uses the same
+// key without talking to each other, and a client resumes wherever its
+// reconnect lands. A ticket stays valid for two more periods and is re-issued
+// under the current key when used. Without TLS_TICKET_SECRET a random secret
+// is drawn once per start, before the workers fork.
+//
+// Drogon builds an SSL_CTX per listening socket (one per IO loop when
+// REUSE_PORT is on) and never exposes it. install() therefore registers an OpenSSL ex_data
+// "new" callback, which runs inside SSL_CTX_new for every context created
+// afterwards; it sets the ticket-key callback, the session cache and a
+// handshake counter there. Call it before app().run().
+class TlsSessions
+{
+public:
+    struct Listener
+    {
+        std::string ip;
+        uint16_t port = 0;
+    };
+
+    struct Options
+    {
+        std::vector<Listener> listeners;
+        std::string cert;
+        std::string key;
+        std::string minProtocol = "TLSv1.2";
+        std::string ticketSecret;
+        std::chrono::seconds rotation{3600};
+        long cacheSize = 20480;
+
+        bool enabled() const { return !listeners.empty(); }
+
+        static Options fromEnv()
+        {
+            Options o;
+            if (const char *v = std::getenv("TLS_LISTEN"))
+            {
+                std::string spec = v;
+                for (size_t pos = 0; pos < spec.size();)
+                {
+                    size_t end = spec.find(',', pos);
+                    if (end == std::string::npos) end = spec.size();
+                    std::string item = spec.substr(pos, end - pos);
+                    size_t colon = item.rfind(':');
+                    if (colon != std::string::npos && std::atoi(item.c_str() + colon + 1) > 0)
+                        o.listeners.push_back({item.substr(0, colon),
+                                               static_cast<uint16_t>(std::atoi(item.c_str() + colon + 1))});
+                    pos = end + 1;
+                }
+            }
+            if (const char *v = std::getenv("TLS_CERT")) o.cert = v;
+            if (const char *v = std::getenv("TLS_KEY")) o.key = v;
+            if (const char *v = std::getenv("TLS_MIN_PROTOCOL"); v && *v) o.minProtocol = v;
+            if (const char *v = std::getenv("TLS_TICKET_ROTATE_S"); v && std::atol(v) > 0)
+                o.rotation = std::chrono::seconds(std::atol(v));
+            if (const char *v = std::getenv("TLS_SESSION_CACHE"); v && *v) o.cacheSize = std::atol(v);
+            if (const char *v = std::getenv("TLS_TICKET_SECRET"); v && *v)
+                o.ticketSecret = v;
+            else if (o.enabled())
+            {
+                unsigned char random[32];
+                RAND_bytes(random, sizeof(random));
+                o.ticketSecret.assign(reinterpret_cast<const char *>(random), sizeof(random));
+            }
+            return o;
+        }
+    };
+
+    struct Stats
+    {
+        uint64_t full = 0;            // full handshakes completed
+        uint64_t resumed = 0;         // abbreviated handshakes (cache or ticket)
+        uint64_t failed = 0;          // handshakes that ended in a fatal alert
+        uint64_t ticketsIssued = 0;
+        uint64_t ticketsRenewed = 0;  // accepted under an older key and re-issued
+        uint64_t ticketsUnknown = 0;  // no key for the ticket; full handshake instead
+        uint64_t cachedSessions = 0;  // server cache, summed over the contexts
+    };
+
+    explicit TlsSessions(Options options) : options_(std::move(options)) {}
+
+    TlsSessions(const TlsSessions &) = delete;
+    TlsSessions &operator=(const TlsSessions &) = delete;
+
+    const Options &options() const { return options_; }
+
+    // OpenSSL SSL_CONF commands for drogon's addListener().
+    std::vector<std::pair<std::string, std::string>> confCmds() const
+    {
+        return {{"MinProtocol", options_.minProtocol}, {"Options", "ServerPreference"}};
+    }
+
+    void install()
+    {
+        ctxIndex() = CRYPTO_get_ex_new_index(CRYPTO_EX_INDEX_SSL_CTX, 0, this, onNewContext, nullptr,
+                                             onFreeContext);
+        sslIndex() = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+        spdlog::info("TLS: {} listener(s), min {}, ticket keys rotate every {}s, session cache {}",
+                     options_.listeners.size(), options_.minProtocol, options_.rotation.count(),
+                     options_.cacheSize);
+    }
+
+    Stats stats() const
+    {
+        Stats s;
+        s.full = full_.load(std::memory_order_relaxed);
+        s.resumed = resumed_.load(std::memory_order_relaxed);
+        s.failed = failed_.load(std::memory_order_relaxed);
+        s.ticketsIssued = issued_.load(std::memory_order_relaxed);
+        s.ticketsRenewed = renewed_.load(std::memory_order_relaxed);
+        s.ticketsUnknown = unknown_.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (SSL_CTX *ctx : contexts_)
+            s.cachedSessions += static_cast<uint64_t>(SSL_CTX_sess_number(ctx));
+        return s;
+    }
+
+private:
+    struct TicketKey
+    {
+        int64_t period = -1;
+        unsigned char name[16];
+        unsigned char aes[32];
+        unsigned char mac[32];
+    };
+
+    static int &ctxIndex()
+    {
+        static int index = -1;
+        return index;
+    }
+
+    static int &sslIndex()
+    {
+        static int index = -1;
+        return index;
+    }
+
+    static TlsSessions *of(SSL *ssl)
+    {
+        return static_cast<TlsSessions *>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ctxIndex()));
+    }
+
+    static void onNewContext(void *parent, void *, CRYPTO_EX_DATA *ad, int idx, long, void *argp)
+    {
+        auto *self = static_cast<TlsSessions *>(argp);
+        auto *ctx = static_cast<SSL_CTX *>(parent);
+        CRYPTO_set_ex_data(ad, idx, self);
+        {
+            std::lock_guard<std::mutex> lock(self->mutex_);
+            self->contexts_.push_back(ctx);
+        }
+        static const unsigned char sidContext[] = "cppAuth";
+        SSL_CTX_set_session_id_context(ctx, sidContext, sizeof(sidContext) - 1);
+        if (self->options_.cacheSize > 0)
+        {
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_sess_set_cache_size(ctx, self->options_.cacheSize);
+        }
+        else
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+        SSL_CTX_set_timeout(ctx, static_cast<long>(2 * self->options_.rotation.count()));
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, onTicket);
+#endif
+        SSL_CTX_set_info_callback(ctx, onInfo);
+    }
+
+    static void onFreeContext(void *parent, void *, CRYPTO_EX_DATA *, int, long, void *argp)
+    {
+        auto *self = static_cast<TlsSessions *>(argp);
+        std::lock_guard<std::mutex> lock(self->mutex_);
+        auto &all = self->contexts_;
+        all.erase(std::remove(all.begin(), all.end(), static_cast<SSL_CTX *>(parent)), all.end());
+    }
+
+    // Counts each server-side handshake once; TLS 1.3 post-handshake
+    // messages reuse the same notifications.
+    static void onInfo(const SSL *ssl, int where, int ret)
+    {
+        if (!SSL_is_server(const_cast<SSL *>(ssl))) return;
+        auto *s = const_cast<SSL *>(ssl);
+        if ((where & SSL_CB_HANDSHAKE_DONE) && !SSL_get_ex_data(s, sslIndex()))
+        {
+            SSL_set_ex_data(s, sslIndex(), reinterpret_cast<void *>(1));
+            auto *self = of(s);
+            (SSL_session_reused(s) ? self->resumed_ : self->full_).fetch_add(1, std::memory_order_relaxed);
+        }
+        else if ((where & SSL_CB_WRITE_ALERT) && (ret >> 8) == SSL3_AL_FATAL && !SSL_get_ex_data(s, sslIndex()))
+        {
+            SSL_set_ex_data(s, sslIndex(), reinterpret_cast<void *>(1));
+            of(s)->failed_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    // enc = 1: encrypt a new ticket under the current key. enc = 0: find the
+    // key a ticket was issued under; 2 asks OpenSSL to re-issue it.
+    static int onTicket(SSL *ssl, unsigned char name[16], unsigned char *iv, EVP_CIPHER_CTX *cipher,
+                        EVP_MAC_CTX *mac, int enc)
+    {
+        auto *self = of(ssl);
+        int64_t now = self->period();
+        TicketKey key;
+        int result = 1;
+        if (enc)
+        {
+            key = self->keyFor(now);
+            std::memcpy(name, key.name, sizeof(key.name));
+            if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) <= 0) return -1;
+            self->issued_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            bool found = false;
+            for (int64_t p = now; p >= now - 2 && !found; --p)
+            {
+                key = self->keyFor(p);
+                found = std::memcmp(name, key.name, sizeof(key.name)) == 0;
+                if (found && p != now) result = 2;
+            }
+            if (!found)
+            {
+                self->unknown_.fetch_add(1, std::memory_order_relaxed);
+                return 0;
+            }
+            if (result == 2) self->renewed_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.mac, sizeof(key.mac)),
+            OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char *>("SHA256"), 0),
+            OSSL_PARAM_construct_end()};
+        if (!EVP_CipherInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes, iv, enc) ||
+            !EVP_MAC_CTX_set_params(mac, params))
+            return -1;
+        OPENSSL_cleanse(&key, sizeof(key));
+        return result;
+    }
+#endif
+
+    int64_t period() const
+    {
+        auto now = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch());
+        return now.count() / options_.rotation.count();
+    }
+
+    // Keys for a rotation period, derived once and kept for the three
+    // periods a ticket can be redeemed in.
+    TicketKey keyFor(int64_t period)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TicketKey &slot = keys_[static_cast<size_t>(period % 3)];
+        if (slot.period != period)
+        {
+            slot.period = period;
+            derive("cppAuth ticket name", period, slot.name, sizeof(slot.name));
+            derive("cppAuth ticket aes", period, slot.aes, sizeof(slot.aes));
+            derive("cppAuth ticket mac", period, slot.mac, sizeof(slot.mac));
+        }
+        return slot;
+    }
+
+    void derive(const char *label, int64_t period, unsigned char *out, size_t n) const
+    {
+        std::string input = std::string(label) + ":" + std::to_string(period);
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int len = 0;
+        HMAC(EVP_sha256(), options_.ticketSecret.data(), static_cast<int>(options_.ticketSecret.size()),
+             reinterpret_cast<const unsigned char *>(input.data()), input.size(), digest, &len);
+        std::memcpy(out, digest, n < len ? n : len);
+        OPENSSL_cleanse(digest, sizeof(digest));
+    }
+
+    Options options_;
+    mutable std::mutex mutex_;
+    std::array<TicketKey, 3> keys_{};
+    std::vector<SSL_CTX *> contexts_;
+    std::atomic<uint64_t> full_{0};
+    std::atomic<uint64_t> resumed_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<uint64_t> issued_{0};
+    std::atomic<uint64_t> renewed_{0};
+    std::atomic<uint64_t> unknown_{0};
+};
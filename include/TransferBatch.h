@@ -0,0 +1,261 @@
+#pragma once
+#include <json/json.h>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "IdAllocator.h"
+#include "JsonWriter.h"
+
+// One debit, many credits: the plan behind POST /transfers/batch.
+//
+// Items are checked one by one (account number, amount), then the batch
+// runs as one transaction on the source's shard:
+//
+//   1. lock the source and every target row in account-number order, so two
+//      batches touching the same accounts cannot deadlock (Postgres; SQLite
+//      already serialises writers);
+//   2. drop items whose target does not exist;
+//   3. debit the sum of what is left in one statement that also checks the
+//      balance: either every remaining item fits or none is applied;
+//   4. credit the targets with set-based UPDATEs of up to kChunk accounts
+//      each, amounts summed per target.
+//
+// The lock and credit statements bind their values in fixed-size chunks of
+// kChunk, padded with repeats, so every batch runs the same two statement
+// texts whatever its size (one prepared statement and one SQL-stats
+// fingerprint each).
+class TransferBatch
+{
+public:
+    enum class Status
+    {
+        Pending,
+        Ok,
+        InvalidAccount,
+        InvalidAmount,
+        AccountNotFound,
+        Insufficient,
+        OtherShard, // target lives on another shard; use /transfer
+        Failed
+    };
+
+    struct Item
+    {
+        std::string to;
+        double amount = 0;
+        Status status = Status::Pending;
+    };
+
+    static const char *name(Status s)
+    {
+        switch (s)
+        {
+        case Status::Pending: return "pending";
+        case Status::Ok: return "ok";
+        case Status::InvalidAccount: return "invalid_account";
+        case Status::InvalidAmount: return "invalid_amount";
+        case Status::AccountNotFound: return "account_not_found";
+        case Status::Insufficient: return "insufficient_balance";
+        case Status::OtherShard: return "other_shard";
+        case Status::Failed: return "failed";
+        }
+        return "failed";
+    }
+
+    // Reads [{"to_account":..,"amount":..}, ...]. False if `list` is not a
+    // non-empty array; items with bad fields are kept and marked instead.
+    static bool parse(const Json::Value &list, std::vector<Item> &items)
+    {
+        if (!list.isArray() || list.empty()) return false;
+        items.reserve(list.size());
+        for (const auto &v : list)
+        {
+            Item item;
+            if (v.isObject() && v["to_account"].isString()) item.to = v["to_account"].asString();
+            if (v.isObject() && v["amount"].isNumeric()) item.amount = v["amount"].asDouble();
+            if (!AccountNumber::valid(item.to)) item.status = Status::InvalidAccount;
+            items.push_back(std::move(item));
+        }
+        return true;
+    }
+
+    std::vector<Item> items;
+
+    // Marks every pending item.
+    void settle(Status status)
+    {
+        for (auto &item : items)
+            if (item.status == Status::Pending) item.status = status;
+    }
+
+    size_t count(Status status) const
+    {
+        return static_cast<size_t>(std::count_if(items.begin(), items.end(),
+                                                 [status](const Item &i) { return i.status == status; }));
+    }
+
+    double pendingTotal() const
+    {
+        double total = 0;
+        for (const auto &item : items)
+            if (item.status == Status::Pending) total += item.amount;
+        return total;
+    }
+
+    // Pending targets with their summed amounts, sorted by account number.
+    std::vector<std::pair<std::string_view, double>> credits() const
+    {
+        std::vector<std::pair<std::string_view, double>> out;
+        for (const auto &item : items)
+            if (item.status == Status::Pending) out.emplace_back(item.to, item.amount);
+        std::sort(out.begin(), out.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+        size_t n = 0;
+        for (size_t i = 0; i < out.size(); ++i)
+        {
+            if (n > 0 && out[n - 1].first == out[i].first)
+                out[n - 1].second += out[i].second;
+            else
+                out[n++] = out[i];
+        }
+        out.resize(n);
+        return out;
+    }
+
+    static constexpr size_t kChunk = 16;
+
+    // Up to kChunk accounts, with amounts where the statement needs them.
+    // Unused slots repeat the last account with amount 0, which changes
+    // neither the IN-list nor the sums.
+    struct Chunk
+    {
+        std::array<std::string, kChunk> accounts;
+        std::array<double, kChunk> amounts{};
+        size_t size = 0;
+    };
+
+    // The source and all pending targets, sorted, for lockSql().
+    std::vector<Chunk> lockChunks(std::string_view from) const
+    {
+        std::vector<std::pair<std::string_view, double>> accounts{{from, 0}};
+        for (const auto &item : items)
+            if (item.status == Status::Pending) accounts.emplace_back(item.to, 0);
+        std::sort(accounts.begin(), accounts.end());
+        accounts.erase(std::unique(accounts.begin(), accounts.end(),
+                                   [](const auto &a, const auto &b) { return a.first == b.first; }),
+                       accounts.end());
+        return chunked(accounts);
+    }
+
+    // Pending targets with their summed amounts, for creditSql().
+    std::vector<Chunk> creditChunks() const { return chunked(credits()); }
+
+    // The I-th parameter of creditSql(): accounts at even, amounts at odd I.
+    template <size_t I>
+    static decltype(auto) creditArg(const Chunk &c)
+    {
+        if constexpr (I % 2 == 0)
+            return static_cast<const std::string &>(c.accounts[I / 2]);
+        else
+            return c.amounts[I / 2];
+    }
+
+    // $1..$kChunk: accounts. Chunks go out in order, so with FOR UPDATE the
+    // row locks are taken in account-number order across the whole batch.
+    static const std::string &lockSql(bool forUpdate)
+    {
+        static const std::string plain = buildLockSql(false);
+        static const std::string locking = buildLockSql(true);
+        return forUpdate ? locking : plain;
+    }
+
+    // ($1,$2), ($3,$4), ...: account and amount pairs, numbered in order of
+    // appearance as SQLite requires. Credits every listed account once and
+    // returns the rows it changed.
+    static const std::string &creditSql()
+    {
+        static const std::string sql = [] {
+            std::string out = "WITH v(account_number, amount) AS (VALUES ";
+            for (size_t i = 1; i <= kChunk; ++i)
+            {
+                if (i > 1) out.push_back(',');
+                out.append("($" + std::to_string(2 * i - 1) + ",$" + std::to_string(2 * i) + ")");
+            }
+            out.append(") UPDATE users SET balance = balance + "
+                       "(SELECT SUM(v.amount) FROM v WHERE v.account_number = users.account_number) "
+                       "WHERE account_number IN (SELECT account_number FROM v) RETURNING account_number");
+            return out;
+        }();
+        return sql;
+    }
+
+    // Marks pending items whose target is not among `existing`.
+    void markMissing(const std::vector<std::string> &existing)
+    {
+        for (auto &item : items)
+            if (item.status == Status::Pending && std::find(existing.begin(), existing.end(), item.to) == existing.end())
+                item.status = Status::AccountNotFound;
+    }
+
+    // [{"to_account":..,"amount":..,"status":..}, ...]
+    std::string resultsJson() const
+    {
+        std::string out = "[";
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            const auto &item = items[i];
+            if (i) out.push_back(',');
+            out.append("{\"to_account\":\"");
+            JsonWriter::appendEscaped(out, item.to);
+            out.append("\",\"amount\":");
+            if (std::isfinite(item.amount))
+            {
+                char tmp[32];
+                auto res = std::to_chars(tmp, tmp + sizeof(tmp), item.amount);
+                out.append(tmp, res.ptr);
+            }
+            else
+                out.append("null");
+            out.append(",\"status\":\"");
+            out.append(name(item.status));
+            out.append("\"}");
+        }
+        out.push_back(']');
+        return out;
+    }
+
+private:
+    static std::vector<Chunk> chunked(const std::vector<std::pair<std::string_view, double>> &values)
+    {
+        std::vector<Chunk> chunks;
+        for (size_t i = 0; i < values.size(); i += kChunk)
+        {
+            Chunk &c = chunks.emplace_back();
+            c.size = std::min(kChunk, values.size() - i);
+            for (size_t j = 0; j < kChunk; ++j)
+            {
+                const auto &[account, amount] = values[i + std::min(j, c.size - 1)];
+                c.accounts[j] = std::string(account);
+                c.amounts[j] = j < c.size ? amount : 0;
+            }
+        }
+        return chunks;
+    }
+
+    static std::string buildLockSql(bool forUpdate)
+    {
+        std::string sql = "SELECT account_number FROM users WHERE account_number IN (";
+        for (size_t i = 1; i <= kChunk; ++i)
+        {
+            if (i > 1) sql.push_back(',');
+            sql.append("$" + std::to_string(i));
+        }
+        sql.append(") ORDER BY account_number");
+        if (forUpdate) sql.append(" FOR UPDATE");
+        return sql;
+    }
+};
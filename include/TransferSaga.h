@@ -0,0 +1,284 @@
+#pragma once
+#include <drogon/drogon.h>
+#include <drogon/orm/DbClient.h>
+#include <drogon/utils/Utilities.h>
+#include <spdlog/spdlog.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include "ShardMap.h"
+
+// Transfer between accounts that live on different shards.
+//
+//   1. Source shard, one transaction: debit the sender and record the
+//      transfer in transfer_intents (state 'pending'). Once this commits the
+//      transfer will be finished no matter what crashes afterwards.
+//   2. Target shard, one transaction: claim the id in applied_transfers and
+//      credit the receiver. The claim is the single point where the outcome
+//      is decided: 'credited', or 'aborted' if the receiver does not exist.
+//      Running this again finds the claim and returns the recorded outcome.
+//   3. Source shard: mark the intent 'done', or for 'aborted' mark it
+//      'refunded' and credit the sender back in the same transaction. Both
+//      updates only match a 'pending' intent, so they apply at most once.
+//
+// Every step is idempotent, so recover() simply re-drives steps 2 and 3 for
+// intents that stayed pending (process crash, DB error).
+class TransferSaga
+{
+public:
+    enum class Result
+    {
+        Completed,    // credited and intent closed
+        Refunded,     // receiver missing; the sender got the money back
+        Insufficient, // step 1 refused the debit, nothing happened
+        Pending,      // debited; recovery will finish it
+        Failed        // step 1 failed, nothing happened
+    };
+
+    using Done = std::function<void(Result, const std::string &transferId)>;
+
+    static void ensureSchema(const ShardMap &shards)
+    {
+        for (size_t i = 0; i < shards.size(); ++i)
+        {
+            const auto &client = shards.shard(i)->writer();
+            client->execSqlSync("CREATE TABLE IF NOT EXISTS transfer_intents ("
+                                "id VARCHAR(64) PRIMARY KEY, "
+                                "from_account VARCHAR(32) NOT NULL, "
+                                "to_account VARCHAR(32) NOT NULL, "
+                                "amount DOUBLE PRECISION NOT NULL, "
+                                "state VARCHAR(16) NOT NULL, "
+                                "created_at BIGINT NOT NULL)");
+            client->execSqlSync("CREATE INDEX IF NOT EXISTS transfer_intents_pending "
+                                "ON transfer_intents (state, created_at)");
+            client->execSqlSync("CREATE TABLE IF NOT EXISTS applied_transfers ("
+                                "id VARCHAR(64) PRIMARY KEY, "
+                                "outcome VARCHAR(16) NOT NULL)");
+        }
+    }
+
+    static void start(std::shared_ptr<ShardMap> shards,
+                      const std::string &from, const std::string &to, double amount, Done done)
+    {
+        std::string id = drogon::utils::getUuid();
+        auto source = shards->forAccount(from);
+        auto insufficient = std::make_shared<bool>(false);
+
+        source->transaction(
+            [id, from, to, amount, insufficient](const TransactionPtr &trans, std::function<void(bool)> finish) {
+                auto onError = [finish](const drogon::orm::DrogonDbException &e) {
+                    spdlog::error("Transfer debit failed: {}", e.base().what());
+                    finish(false);
+                };
+                DbRouter::exec(trans,
+                    "UPDATE users SET balance = balance - $1 WHERE account_number=$2 AND balance >= $1 RETURNING balance",
+                    [trans, finish, onError, id, from, to, amount, insufficient](const drogon::orm::Result &r) {
+                        if (r.empty()) {
+                            *insufficient = true;
+                            finish(false);
+                            return;
+                        }
+                        DbRouter::exec(trans,
+                            "INSERT INTO transfer_intents (id, from_account, to_account, amount, state, created_at) "
+                            "VALUES ($1, $2, $3, $4, 'pending', $5)",
+                            [finish](const drogon::orm::Result &) { finish(true); },
+                            onError,
+                            id, from, to, amount, nowSeconds());
+                    },
+                    onError,
+                    amount, from);
+            },
+            [shards, id, from, to, amount, insufficient, done](bool committed) {
+                if (!committed) {
+                    done(*insufficient ? Result::Insufficient : Result::Failed, id);
+                    return;
+                }
+                drive(shards, id, from, to, amount, done);
+            });
+    }
+
+    using Settled = std::function<void(Result, const std::string &id, const std::string &from,
+                                       const std::string &to, double amount)>;
+
+    // Finishes intents that have been pending for more than `olderThan`
+    // seconds on every shard. Safe to run while live transfers are in flight.
+    // `settled`, if set, sees the outcome of every transfer it drives.
+    static void recover(std::shared_ptr<ShardMap> shards, int64_t olderThan = 30, Settled settled = nullptr)
+    {
+        for (size_t i = 0; i < shards->size(); ++i)
+        {
+            DbRouter::exec(shards->shard(i)->writer(),
+                "SELECT id, from_account, to_account, amount FROM transfer_intents "
+                "WHERE state = 'pending' AND created_at < $1",
+                [shards, i, settled](const drogon::orm::Result &r) {
+                    if (!r.empty())
+                        spdlog::warn("Recovering {} pending transfers on shard {}", r.size(), i);
+                    for (const auto &row : r)
+                    {
+                        std::string id = row["id"].as<std::string>();
+                        std::string from = row["from_account"].as<std::string>();
+                        std::string to = row["to_account"].as<std::string>();
+                        double amount = row["amount"].as<double>();
+                        drive(shards, id, from, to, amount,
+                              [settled, from, to, amount](Result res, const std::string &id) {
+                                  spdlog::info("Recovered transfer {}: {}", id, name(res));
+                                  if (settled) settled(res, id, from, to, amount);
+                              });
+                    }
+                },
+                [i](const drogon::orm::DrogonDbException &e) {
+                    spdlog::error("Transfer recovery scan failed on shard {}: {}", i, e.base().what());
+                },
+                nowSeconds() - olderThan);
+        }
+    }
+
+    static const char *name(Result r)
+    {
+        switch (r)
+        {
+        case Result::Completed: return "completed";
+        case Result::Refunded: return "refunded";
+        case Result::Insufficient: return "insufficient";
+        case Result::Pending: return "pending";
+        case Result::Failed: return "failed";
+        }
+        return "unknown";
+    }
+
+private:
+    static int64_t nowSeconds()
+    {
+        using namespace std::chrono;
+        return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+    }
+
+    // Steps 2 and 3.
+    static void drive(std::shared_ptr<ShardMap> shards, const std::string &id,
+                      const std::string &from, const std::string &to, double amount, Done done)
+    {
+        apply(shards->forAccount(to), id, to, amount,
+              [shards, id, from, amount, done](const std::string &outcome) {
+                  if (outcome.empty()) {
+                      done(Result::Pending, id);
+                      return;
+                  }
+                  close(shards->forAccount(from), id, from, amount, outcome == "credited", done);
+              });
+    }
+
+    // Step 2; reports the outcome, or "" if it could not be determined.
+    static void apply(std::shared_ptr<DbRouter> target, const std::string &id,
+                      const std::string &to, double amount,
+                      std::function<void(const std::string &)> report)
+    {
+        struct State
+        {
+            std::string outcome;
+            bool claimedElsewhere = false;
+        };
+        auto st = std::make_shared<State>();
+
+        target->transaction(
+            [id, to, amount, st](const TransactionPtr &trans, std::function<void(bool)> finish) {
+                auto onError = [finish](const drogon::orm::DrogonDbException &e) {
+                    spdlog::error("Transfer credit failed: {}", e.base().what());
+                    finish(false);
+                };
+                DbRouter::exec(trans,
+                    "INSERT INTO applied_transfers (id, outcome) VALUES ($1, 'credited') "
+                    "ON CONFLICT (id) DO NOTHING RETURNING id",
+                    [trans, finish, onError, id, to, amount, st](const drogon::orm::Result &claim) {
+                        if (claim.empty()) {
+                            st->claimedElsewhere = true;
+                            finish(false);
+                            return;
+                        }
+                        DbRouter::exec(trans,
+                            "UPDATE users SET balance = balance + $1 WHERE account_number=$2 RETURNING balance",
+                            [trans, finish, onError, id, st](const drogon::orm::Result &r) {
+                                if (!r.empty()) {
+                                    st->outcome = "credited";
+                                    finish(true);
+                                    return;
+                                }
+                                DbRouter::exec(trans,
+                                    "UPDATE applied_transfers SET outcome = 'aborted' WHERE id = $1",
+                                    [finish, st](const drogon::orm::Result &) {
+                                        st->outcome = "aborted";
+                                        finish(true);
+                                    },
+                                    onError,
+                                    id);
+                            },
+                            onError,
+                            amount, to);
+                    },
+                    onError,
+                    id);
+            },
+            [target, id, st, report](bool committed) {
+                if (committed) {
+                    report(st->outcome);
+                    return;
+                }
+                if (!st->claimedElsewhere) {
+                    report("");
+                    return;
+                }
+                // Decided by an earlier run; read what it decided.
+                DbRouter::exec(target->writer(),
+                    "SELECT outcome FROM applied_transfers WHERE id = $1",
+                    [report](const drogon::orm::Result &r) {
+                        report(r.empty() ? std::string() : r[0]["outcome"].as<std::string>());
+                    },
+                    [report](const drogon::orm::DrogonDbException &) { report(""); },
+                    id);
+            });
+    }
+
+    // Step 3.
+    static void close(std::shared_ptr<DbRouter> source, const std::string &id,
+                      const std::string &from, double amount, bool credited, Done done)
+    {
+        if (credited) {
+            source->write(
+                "UPDATE transfer_intents SET state = 'done' WHERE id = $1 AND state = 'pending'",
+                [id, done](const drogon::orm::Result &) { done(Result::Completed, id); },
+                [id, done](const drogon::orm::DrogonDbException &e) {
+                    // The money has moved; only the bookkeeping is left to recovery.
+                    spdlog::warn("Closing transfer {} failed: {}", id, e.base().what());
+                    done(Result::Completed, id);
+                },
+                id);
+            return;
+        }
+
+        source->transaction(
+            [id, from, amount](const TransactionPtr &trans, std::function<void(bool)> finish) {
+                auto onError = [finish](const drogon::orm::DrogonDbException &e) {
+                    spdlog::error("Transfer refund failed: {}", e.base().what());
+                    finish(false);
+                };
+                DbRouter::exec(trans,
+                    "UPDATE transfer_intents SET state = 'refunded' WHERE id = $1 AND state = 'pending' RETURNING id",
+                    [trans, finish, onError, from, amount](const drogon::orm::Result &r) {
+                        if (r.empty()) {
+                            finish(true); // already refunded
+                            return;
+                        }
+                        DbRouter::exec(trans,
+                            "UPDATE users SET balance = balance + $1 WHERE account_number=$2",
+                            [finish](const drogon::orm::Result &) { finish(true); },
+                            onError,
+                            amount, from);
+                    },
+                    onError,
+                    id);
+            },
+            [id, done](bool committed) {
+                done(committed ? Result::Refunded : Result::Pending, id);
+            });
+    }
+};
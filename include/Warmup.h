@@ -0,0 +1,106 @@
+#pragma once
+#include <drogon/drogon.h>
+#include <drogon/orm/DbClient.h>
+#include <spdlog/spdlog.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include "DbRouter.h"
+#include "PasswordHasher.h"
+#include "Readiness.h"
+
+// Brings a fresh process to full speed before the load balancer sees it:
+// opens every pooled DB connection, prepares the controllers' hot statements
+// on each of them, and runs one bcrypt hash to page in the code and tables.
+// Readiness flips to ready once everything has succeeded; a failed pass is
+// retried every two seconds.
+class Warmup : public std::enable_shared_from_this<Warmup>
+{
+public:
+    Warmup(std::shared_ptr<DbRouter> db, size_t readConnections, size_t writeConnections)
+        : db_(std::move(db)),
+          readConnections_(readConnections ? readConnections : 1),
+          writeConnections_(writeConnections ? writeConnections : 1) {}
+
+    // Reads are warmed on the router's reader pool, writes on its writer.
+    static void start(std::shared_ptr<DbRouter> db, size_t readConnections, size_t writeConnections)
+    {
+        Readiness::instance().setStage("warming_up");
+        std::make_shared<Warmup>(std::move(db), readConnections, writeConnections)->runPass();
+    }
+
+private:
+    std::shared_ptr<DbRouter> db_;
+    size_t readConnections_;
+    size_t writeConnections_;
+
+    // Statements issued by AuthController and BankController. The dummy
+    // arguments match no row, so the writes are no-ops.
+    struct HotStatement
+    {
+        const char *sql;
+        int params; // 1: ('') , 2: (0.0, '')
+        bool write;
+    };
+
+    static const std::vector<HotStatement> &hotStatements()
+    {
+        static const std::vector<HotStatement> stmts{
+            {"SELECT password_hash, account_number FROM users WHERE username=$1", 1, false},
+            {"SELECT id, username, email, created_at FROM users WHERE username=$1", 1, false},
+            {"SELECT balance FROM users WHERE account_number=$1", 1, false},
+            {"UPDATE users SET balance = balance + $1 WHERE account_number=$2 RETURNING balance", 2, true},
+            {"UPDATE users SET balance = balance - $1 WHERE account_number=$2 AND balance >= $1 RETURNING balance", 2, true},
+        };
+        return stmts;
+    }
+
+    void runPass()
+    {
+        auto self = shared_from_this();
+        // Every statement N times at once: DbRouter::reader() and drogon's
+        // pools hand concurrent queries to distinct idle connections, so each
+        // connection opens and prepares each.
+        size_t total = 1;
+        for (const auto &stmt : hotStatements())
+            total += stmt.write ? writeConnections_ : readConnections_;
+        auto pending = std::make_shared<std::atomic<size_t>>(total);
+        auto failed = std::make_shared<std::atomic<bool>>(false);
+
+        auto finishOne = [self, pending, failed]() {
+            if (pending->fetch_sub(1) != 1)
+                return;
+            if (failed->load())
+            {
+                spdlog::warn("Warmup pass failed, retrying in 2s");
+                drogon::app().getLoop()->runAfter(2.0, [self] { self->runPass(); });
+                return;
+            }
+            long long ms = Readiness::instance().markReady();
+            spdlog::info("Ready after {} ms ({} read / {} write DB connections warmed)",
+                         ms, self->readConnections_, self->writeConnections_);
+        };
+
+        for (const auto &stmt : hotStatements())
+        {
+            size_t n = stmt.write ? writeConnections_ : readConnections_;
+            for (size_t i = 0; i < n; ++i)
+            {
+                const auto &client = stmt.write ? db_->writer() : db_->reader();
+                auto ok = [finishOne](const drogon::orm::Result &) { finishOne(); };
+                auto err = [finishOne, failed, sql = stmt.sql](const drogon::orm::DrogonDbException &e) {
+                    spdlog::error("Warmup statement failed ({}): {}", sql, e.base().what());
+                    failed->store(true);
+                    finishOne();
+                };
+                if (stmt.params == 1)
+                    client->execSqlAsync(stmt.sql, ok, err, std::string());
+                else
+                    client->execSqlAsync(stmt.sql, ok, err, 0.0, std::string());
+            }
+        }
+
+        PasswordHasher::instance().hash("warmup", [finishOne](std::string) { finishOne(); });
+    }
+};
@@ -0,0 +1,101 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CpuTopology.h"
+
+// Fixed-size pool of worker threads fed from a single FIFO queue. Used to
+// keep CPU-heavy work (bcrypt) off the drogon IO loops. Threads are pinned
+// to `cpus` when a non-empty set is given.
+class WorkerPool
+{
+public:
+    WorkerPool() = default;
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    ~WorkerPool() { stop(); }
+
+    void start(size_t threads, const std::vector<int> &cpus = {})
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!threads_.empty())
+            return;
+        stopping_ = false;
+        for (size_t i = 0; i < threads; ++i)
+        {
+            threads_.emplace_back([this, cpus, i] {
+                pinCurrentThread(cpus, static_cast<int>(i));
+                run();
+            });
+        }
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto &t : threads_)
+            if (t.joinable())
+                t.join();
+        threads_.clear();
+    }
+
+    bool running() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !threads_.empty() && !stopping_;
+    }
+
+    // Runs the task on a worker, or inline when the pool was never started.
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!threads_.empty() && !stopping_)
+            {
+                tasks_.push_back(std::move(task));
+                cv_.notify_one();
+                return;
+            }
+        }
+        task();
+    }
+
+    size_t queued() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return tasks_.size();
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::thread> threads_;
+    bool stopping_ = false;
+
+    void run()
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                if (tasks_.empty())
+                    return;
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+};
@@ -1,12 +1,56 @@
 #pragma once
 
+#include <jwt-cpp/jwt.h>
 #include <string>
+#include "JwtSigner.h"
+#include "RuntimeConfig.h"
 
-// Minimal jwt helper stub used by BankController during builds.
-// verifyJWT should check token validity and return true/false; here it's a stub.
-inline bool verifyJWT(const std::string &token, const std::string &secret, std::string &outUsername) {
-    // naive stub: accept any non-empty token and set username to 'stub'
-    if(token.empty()) return false;
-    outUsername = "stubuser";
-    return true;
+// General HS256 verification through jwt-cpp, for tokens JwtSigner does not
+// recognise (a header or claim layout it never issues).
+inline bool verifyJWTGeneric(const std::string &token, const ConfigSnapshot &cfg, std::string &outUsername,
+                             std::string *outAccount = nullptr) {
+    try {
+        auto decoded = jwt::decode(token);
+        for (const std::string *secret : {&cfg.jwtSecret, &cfg.acceptedPreviousSecret()}) {
+            if (secret->empty()) continue;
+            try {
+                jwt::verify()
+                    .allow_algorithm(jwt::algorithm::hs256{*secret})
+                    .with_issuer(JwtSigner::kIssuer)
+                    .verify(decoded);
+                outUsername = decoded.get_subject();
+                if (outAccount)
+                    *outAccount = decoded.has_payload_claim("acct") ? decoded.get_payload_claim("acct").as_string()
+                                                                    : std::string();
+                return true;
+            } catch (const std::exception &) {
+                // try the next key
+            }
+        }
+    } catch (const std::exception &) {
+        // malformed token
+    }
+    return false;
+}
+
+// Verifies an HS256 token issued by AuthController against the current
+// signing secret and, during a rotation, the previous one. On success the
+// token subject is written to outUsername and its "acct" claim, if asked
+// for, to outAccount.
+inline bool verifyJWT(const std::string &token, const ConfigSnapshot &cfg, std::string &outUsername,
+                      std::string *outAccount = nullptr) {
+    if (token.empty()) return false;
+    for (const std::string *secret : {&cfg.jwtSecret, &cfg.acceptedPreviousSecret()}) {
+        if (secret->empty()) continue;
+        switch (JwtSigner::verify(token, *secret, outUsername, outAccount)) {
+        case JwtSigner::Result::Valid: return true;
+        case JwtSigner::Result::Invalid: continue;
+        case JwtSigner::Result::Unknown: return verifyJWTGeneric(token, cfg, outUsername, outAccount);
+        }
+    }
+    return false;
+}
+
+inline bool verifyJWT(const std::string &token, std::string &outUsername, std::string *outAccount = nullptr) {
+    return verifyJWT(token, RuntimeConfig::current(), outUsername, outAccount);
 }
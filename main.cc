@@ -2,33 +2,165 @@
 #include <drogon/orm/DbClient.h>
 #include <laserpants/dotenv/dotenv.h>
 #include <spdlog/spdlog.h>
-#include <spdlog/sinks/rotating_file_sink.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <new>
+#include <unistd.h>
+#include "AdminController.h"
+#include "AdmissionControl.h"
+#include "AllocStats.h"
+#include "AuditJournal.h"
 #include "AuthController.h"
+#include "BalanceEngine.h"
 #include "BankController.h"
+#include "BinLog.h"
+#include "CpuTopology.h"
+#include "DebugController.h"
+#include "HealthController.h"
+#include "IdAllocator.h"
+#include "LogArchiver.h"
+#include "LogThreads.h"
+#include "LoopLagMonitor.h"
+#include "PasswordHasher.h"
+#include "Readiness.h"
+#include "RuntimeConfig.h"
+#include "SessionStore.h"
+#include "ShardMap.h"
+#include "SingleFlight.h"
+#include "SlowQueryLog.h"
+#include "SqlStats.h"
+#include "SqliteTuning.h"
+#include "TlsSessions.h"
+#include "TransferSaga.h"
+#include "Warmup.h"
 
 using namespace drogon;
 
 drogon::orm::DbClientPtr dbClient;
 
+#ifdef CPPAUTH_ALLOC_STATS
+// Count every heap allocation for /debug/allocs. The array, nothrow and
+// aligned forms all end up here or bypass counting harmlessly.
+void *operator new(std::size_t n) {
+    AllocStats::record(n);
+    if (void *p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+#endif
+
+namespace {
+    constexpr size_t kMaxWorkers = 256;
+    pid_t workerPids[kMaxWorkers];
+    size_t workerPidCount = 0;
+    volatile std::sig_atomic_t reloadRequested = 0;
+
+    void requestReload(int) {
+        reloadRequested = 1;
+    }
+
+    void forwardToWorkers(int sig) {
+        for (size_t i = 0; i < workerPidCount; ++i)
+            kill(workerPids[i], sig);
+    }
+
+    // Parent side of WORKERS > 1: pass termination signals on and wait for
+    // every worker to exit.
+    int superviseWorkers() {
+        std::signal(SIGTERM, forwardToWorkers);
+        std::signal(SIGINT, forwardToWorkers);
+        std::signal(SIGHUP, forwardToWorkers);
+        size_t remaining = workerPidCount;
+        while (remaining > 0) {
+            int status = 0;
+            pid_t pid = waitpid(-1, &status, 0);
+            if (pid < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            --remaining;
+            std::cout << "[INFO] worker " << pid << " exited with status " << status << "\n";
+        }
+        return 0;
+    }
+}
+
 int main() {
+    Readiness::instance(); // process start for time-to-ready
     try {
         // Load .env
         dotenv::init();
         std::cout << "[INFO] .env file loaded successfully.\n";
         int port = std::getenv("PORT") ? std::atoi(std::getenv("PORT")) : 8088;
+        // Read before forking so a generated ticket secret is shared by all workers
+        auto tlsOptions = TlsSessions::Options::fromEnv();
+
+        // Multi-process mode: fork before any thread exists; every worker
+        // binds the same port with SO_REUSEPORT and the kernel spreads accepts.
+        size_t workers = std::min(CpuLayout::workerCount(), kMaxWorkers);
+        size_t workerId = 0;
+        if (workers > 1) {
+            for (size_t i = 0; i < workers; ++i) {
+                pid_t pid = fork();
+                if (pid < 0) throw std::runtime_error("fork failed");
+                if (pid == 0) {
+                    workerId = i;
+                    workerPidCount = 0;
+                    break;
+                }
+                workerPids[workerPidCount++] = pid;
+            }
+            if (workerPidCount > 0) return superviseWorkers();
+        }
 
-        // Configure logger
-        auto logger = spdlog::rotating_logger_mt("bank_logger", "logs/bank.log", 1024 * 1024 * 5, 3); // 5MB, 3 files
+        CpuLayout layout = CpuLayout::fromEnv(workerId, workers);
+
+        // Configure logger; writes happen on the spdlog thread pool so they
+        // can be pinned away from the IO loops.
+        std::vector<int> logCpus = layout.pinning ? layout.logCpus : std::vector<int>{};
+        LogThreads::start(8192, layout.logThreads, logCpus);
+        std::string logFile = workers > 1 ? "logs/bank.w" + std::to_string(workerId) + ".log" : "logs/bank.log";
+        // Each worker's request filters get their own logs/*.<pid>.blog
+        if (workers > 1) BinLog::setProcessTag(std::to_string(getpid()));
+        auto logger = LogThreads::rotating("bank_logger", logFile, 1024 * 1024 * 5, 3); // 5MB, 3 files
         spdlog::set_default_logger(logger);
         spdlog::set_pattern("[%Y-%m-%d %H:%M:%S] [%l] %v");
         spdlog::flush_on(spdlog::level::info);
 
+        // Rotated logs are compressed and indexed into logs/archive at idle priority
+        std::unique_ptr<LogArchiver> archiver;
+        if (LogArchiver::Options::enabled()) {
+            archiver = std::make_unique<LogArchiver>(LogArchiver::Options::fromEnv(
+                {logFile, "logs/api.log", BinLog::tagged("logs/api.blog"), BinLog::tagged("logs/request.blog")}));
+            archiver->start();
+        }
+
         // DB connection from env
         std::string driver = std::getenv("DB_DRIVER") ? std::getenv("DB_DRIVER") : "sqlite3";
+        size_t dbConnections = CpuLayout::envSize("DB_CONNECTIONS", 1);
+        size_t readConnections = dbConnections;
+        std::shared_ptr<DbRouter> dbRouter;
+        bool slowLog = SlowQueryLog::Options::enabled();
+        drogon::orm::DbClientPtr explainClient; // slow-query EXPLAINs, off the serving pool
+        std::string pgConnInfo; // also opens the session store's LISTEN connection
 
         if(driver == "sqlite3") {
             std::string dbFile = std::getenv("DB_DATABASE") ? std::getenv("DB_DATABASE") : "./test.db";
-            dbClient = drogon::orm::DbClient::newSqlite3Client(dbFile, 1);
+            if (SqliteTuning::enabled()) {
+                // WAL readers + one group-committing writer
+                auto tuning = SqliteTuning::fromEnv();
+                dbRouter = tuning.open(dbFile);
+                dbClient = dbRouter->writer();
+                readConnections = tuning.readers;
+                dbConnections = 1;
+            } else {
+                dbClient = drogon::orm::DbClient::newSqlite3Client(dbFile, dbConnections);
+            }
+            if (slowLog) explainClient = drogon::orm::DbClient::newSqlite3Client(dbFile, 1);
             spdlog::info("Connected to SQLite at {}", dbFile);
         } else if(driver == "postgres") {
             std::string connStr = "host=" + std::string(std::getenv("DB_HOST")) +
@@ -36,28 +168,184 @@ int main() {
                                   " dbname=" + std::string(std::getenv("DB_NAME")) +
                                   " user=" + std::string(std::getenv("DB_USER")) +
                                   " password=" + std::string(std::getenv("DB_PASS"));
-            dbClient = drogon::orm::DbClient::newPgClient(connStr, 1);
+            dbClient = drogon::orm::DbClient::newPgClient(connStr, dbConnections);
+            pgConnInfo = connStr;
+            if (slowLog) explainClient = drogon::orm::DbClient::newPgClient(connStr, 1);
             spdlog::info("Connected to PostgreSQL at {}:{}", std::getenv("DB_HOST"), std::getenv("DB_PORT"));
         } else {
             throw std::runtime_error("Unsupported DB_DRIVER");
         }
+        if (!dbRouter) dbRouter = std::make_shared<DbRouter>(dbClient);
+        if (slowLog)
+            DbRouter::addObserver(std::make_shared<SlowQueryLog>(SlowQueryLog::Options::fromEnv(),
+                                                                 explainClient, driver == "sqlite3"));
+        // Per-fingerprint query totals behind /debug/sql; SQL_STATS=0 turns them off
+        std::shared_ptr<SqlStats> sqlStats;
+        if (!(std::getenv("SQL_STATS") && std::string(std::getenv("SQL_STATS")) == "0")) {
+            sqlStats = std::make_shared<SqlStats>();
+            DbRouter::addObserver(sqlStats);
+        }
+
+        // Extra account shards: DB_SHARDS lists further databases of the same
+        // driver, ';'-separated (SQLite files or Postgres conninfo strings).
+        // The primary database above is shard 0.
+        std::vector<std::shared_ptr<DbRouter>> shardRouters{dbRouter};
+        if (const char *extra = std::getenv("DB_SHARDS"); extra && *extra) {
+            for (const auto &spec : drogon::utils::splitString(extra, ";")) {
+                if (driver == "sqlite3" && SqliteTuning::enabled())
+                    shardRouters.push_back(SqliteTuning::fromEnv().open(spec));
+                else if (driver == "sqlite3")
+                    shardRouters.push_back(std::make_shared<DbRouter>(
+                        drogon::orm::DbClient::newSqlite3Client(spec, dbConnections)));
+                else
+                    shardRouters.push_back(std::make_shared<DbRouter>(
+                        drogon::orm::DbClient::newPgClient(spec, dbConnections)));
+            }
+            spdlog::info("Accounts sharded over {} databases", shardRouters.size());
+        }
+        auto shards = std::make_shared<ShardMap>(std::move(shardRouters));
+        TransferSaga::ensureSchema(*shards);
+        shards->ensureSchema();
+
+        // JWT secrets, token lifetimes and limits; reloaded on SIGHUP or POST /admin/reload
+        RuntimeConfig::reloadFromEnv();
+        std::signal(SIGHUP, requestReload);
+        app().getLoop()->runEvery(1.0, [] {
+            if (!reloadRequested) return;
+            reloadRequested = 0;
+            const auto &cfg = RuntimeConfig::reloadFromEnv();
+            spdlog::info("Config reloaded on SIGHUP (version {})", cfg.version);
+        });
+
+        // Account numbers are served from blocks reserved in id_blocks
+        auto accountIds = std::make_shared<IdAllocator>(dbRouter, "account_number",
+                                                        CpuLayout::envSize("ACCOUNT_ID_BLOCK", 1000));
+        accountIds->ensureSchema();
+
+        // Identical concurrent balance/profile reads share one query; SINGLEFLIGHT=0 turns it off
+        std::shared_ptr<SingleFlight> flights;
+        if (SingleFlight::Options::enabled())
+            flights = std::make_shared<SingleFlight>(SingleFlight::Options::fromEnv());
+
+        // Hash-chained journal of money movements; AUDIT_JOURNAL=0 turns it off
+        std::shared_ptr<AuditJournal> audit;
+        if (AuditJournal::Options::enabled()) {
+            audit = std::make_shared<AuditJournal>(AuditJournal::Options::fromEnv(workerId, workers));
+            audit->open();
+        }
 
-        // JWT secret from env
-        std::string jwtSecret = std::getenv("JWT_SECRET") ? std::getenv("JWT_SECRET") : "changeme";
+        // Refresh tokens; SESSION_STORE=memory keeps them in this process only
+        std::shared_ptr<SessionStore> sessions;
+        if (SessionStore::Options::persistent()) {
+            DbSessionStore::ensureSchema(*dbRouter);
+            sessions = std::make_shared<DbSessionStore>(dbRouter, SessionStore::Options::fromEnv(), pgConnInfo);
+            app().registerBeginningAdvice([sessions] { sessions->start(app().getLoop()); });
+        }
 
         // Controllers
-        auto authController = std::make_shared<AuthController>(dbClient, jwtSecret);
-        auto bankController = std::make_shared<BankController>(dbClient, jwtSecret);
+        auto authController = std::make_shared<AuthController>(shards, accountIds, flights, sessions);
+        // Optional in-memory balance engine; needs to be the only balance writer
+        std::shared_ptr<BalanceEngine> engine;
+        if (BalanceEngine::Options::enabled()) {
+            if (workers > 1) throw std::runtime_error("BALANCE_ENGINE=1 requires WORKERS=1");
+            engine = std::make_shared<BalanceEngine>(shards, BalanceEngine::Options::fromEnv());
+            engine->start();
+            app().getLoop()->runEvery(engine->flushSeconds(), [engine] { engine->flush(); });
+        }
+        auto bankController = std::make_shared<BankController>(shards, engine, flights, audit);
 
         // Register controllers with Drogon
         app().registerController(authController);
         app().registerController(bankController);
+        app().registerController(std::make_shared<AdminController>());
+        app().registerController(std::make_shared<HealthController>());
+        // Per-group adaptive concurrency limits; excess requests get 503 before routing
+        std::shared_ptr<AdmissionControl> admission;
+        if (AdmissionControl::enabled()) {
+            admission = std::make_shared<AdmissionControl>();
+            app().registerSyncAdvice([admission](const HttpRequestPtr &req) { return admission->admit(req); });
+            app().registerPreSendingAdvice([admission](const HttpRequestPtr &req, const HttpResponsePtr &) {
+                admission->finished(req);
+            });
+        }
+        // Native TLS listeners; must hook OpenSSL before drogon creates its contexts
+        std::shared_ptr<TlsSessions> tls;
+        if (tlsOptions.enabled()) {
+            tls = std::make_shared<TlsSessions>(tlsOptions);
+            tls->install();
+            for (const auto &l : tlsOptions.listeners)
+                app().addListener(l.ip, l.port, true, tlsOptions.cert, tlsOptions.key, false, tls->confCmds());
+        }
+        app().registerController(std::make_shared<DebugController>(sqlStats, admission, flights, tls));
+        if (AllocStats::kEnabled) {
+            app().registerPreSendingAdvice([](const HttpRequestPtr &, const HttpResponsePtr &) {
+                AllocStats::requestDone();
+            });
+        }
+
+        // bcrypt runs on its own pool, off the IO loops
+        PasswordHasher::instance().start(layout.hashThreads,
+                                         layout.pinning ? layout.hashCpus : std::vector<int>{});
+
+        if (layout.pinning) {
+            app().registerBeginningAdvice([ioCpus = layout.ioCpus, n = layout.ioThreads] {
+                for (size_t i = 0; i < n; ++i) {
+                    app().getIOLoop(i)->queueInLoop([ioCpus, i] {
+                        pinCurrentThread(ioCpus, static_cast<int>(i));
+                    });
+                }
+            });
+        }
+
+        // Per-loop lag histograms and stall reports (/debug/loops)
+        if (LoopLagMonitor::Options::enabled()) {
+            app().registerBeginningAdvice([] {
+                LoopLagMonitor::instance().start(LoopLagMonitor::Options::fromEnv(), app().getIOLoops());
+            });
+            app().registerPreHandlingAdvice([](const HttpRequestPtr &req) {
+                LoopLagMonitor::instance().requestStarted(req);
+            });
+        }
+
+        // Cross-shard transfers left pending by a crash or DB error
+        if (shards->size() > 1) {
+            // Transfers settled by recovery are audited like live ones
+            TransferSaga::Settled settled;
+            if (audit) {
+                settled = [audit](TransferSaga::Result res, const std::string &id, const std::string &from,
+                                  const std::string &to, double amount) {
+                    if (res == TransferSaga::Result::Completed || res == TransferSaga::Result::Refunded)
+                        audit->record({"transfer", from, to, amount, NAN, id, TransferSaga::name(res)}, nullptr);
+                };
+            }
+            app().registerBeginningAdvice([shards, settled] {
+                TransferSaga::recover(shards, 0, settled);
+                app().getLoop()->runEvery(30.0, [shards, settled] { TransferSaga::recover(shards, 30, settled); });
+            });
+        }
+
+        // /readyz stays 503 until every connection is open and prepared
+        app().registerBeginningAdvice([dbRouter, readConnections, dbConnections] {
+            Warmup::start(dbRouter, readConnections, dbConnections);
+        });
+
+        spdlog::info("Worker {}/{} thread layout: {}", workerId + 1, workers, layout.describe());
+
+        // One listening socket per IO loop (and per worker) unless REUSE_PORT=0
+        bool reusePort = !(std::getenv("REUSE_PORT") && std::string(std::getenv("REUSE_PORT")) == "0");
 
         // Run HTTP server
         app().addListener("0.0.0.0", port)
-             .setThreadNum(4)
+             .setThreadNum(layout.ioThreads)
+             .enableReusePort(reusePort || workers > 1)
              .run();
 
+        PasswordHasher::instance().stop();
+        if (engine) engine->stop();
+        if (audit) audit->stop();
+        if (archiver) archiver->stop();
+        LoopLagMonitor::instance().stop();
+
     } catch (const std::exception &e) {
         spdlog::error("Fatal error: {}", e.what());
     }
@@ -0,0 +1,57 @@
+#include <drogon/drogon_test.h>
+#include <chrono>
+#include <thread>
+#include "AdmissionControl.h"
+
+namespace {
+AdaptiveLimit::Options options()
+{
+    AdaptiveLimit::Options o;
+    o.initial = 8;
+    o.min = 4;
+    o.max = 100;
+    return o;
+}
+}
+
+DROGON_TEST(AdaptiveLimitAdmitsUpToLimit)
+{
+    AdaptiveLimit limit(options());
+    for (int i = 0; i < 8; ++i)
+        CHECK(limit.tryAcquire());
+    CHECK(!limit.tryAcquire());
+    CHECK(limit.inflight() == 8);
+
+    limit.abandon();
+    CHECK(limit.inflight() == 7);
+    CHECK(limit.tryAcquire());
+    CHECK(!limit.tryAcquire());
+}
+
+DROGON_TEST(AdaptiveLimitBacksOffWhenLatencyRises)
+{
+    using std::chrono::milliseconds;
+    AdaptiveLimit limit(options());
+
+    // First window: the baseline. Nearly idle, so the limit does not grow.
+    for (int i = 0; i < 10; ++i)
+    {
+        REQUIRE(limit.tryAcquire());
+        limit.release(milliseconds(1));
+    }
+    CHECK(limit.limit() == 8);
+
+    // Latency up 20x: shrink, but never below `min`
+    for (int window = 0; window < 5; ++window)
+    {
+        std::this_thread::sleep_for(milliseconds(110));
+        for (int i = 0; i < 10; ++i)
+        {
+            REQUIRE(limit.tryAcquire());
+            limit.release(milliseconds(20));
+        }
+    }
+    CHECK(limit.limit() < 8);
+    CHECK(limit.limit() >= 4);
+    CHECK(limit.inflight() == 0);
+}
@@ -0,0 +1,113 @@
+#include <drogon/drogon_test.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AuditJournal.h"
+
+namespace {
+
+struct TempDir
+{
+    std::string path;
+
+    explicit TempDir(const char *name)
+        : path((std::filesystem::temp_directory_path() /
+                (std::string("cppauth_") + name + "." + std::to_string(getpid()))).string())
+    {
+        std::filesystem::remove_all(path);
+    }
+
+    ~TempDir() { std::filesystem::remove_all(path); }
+};
+
+// Makes the next write() past `bytes` into a file fail with EFBIG.
+struct FileSizeLimit
+{
+    rlimit saved{};
+
+    explicit FileSizeLimit(rlim_t bytes)
+    {
+        std::signal(SIGXFSZ, SIG_IGN);
+        getrlimit(RLIMIT_FSIZE, &saved);
+        rlimit limit = saved;
+        limit.rlim_cur = bytes;
+        setrlimit(RLIMIT_FSIZE, &limit);
+    }
+
+    ~FileSizeLimit() { setrlimit(RLIMIT_FSIZE, &saved); }
+};
+
+AuditJournal::Options strict(const std::string &dir)
+{
+    AuditJournal::Options o;
+    o.dir = dir;
+    o.strict = true;
+    return o;
+}
+
+// Records a deposit and waits for the (strict) completion.
+bool record(AuditJournal &journal, double amount)
+{
+    auto p = std::make_shared<std::promise<bool>>();
+    auto f = p->get_future();
+    journal.record({"deposit", "ACCT0000000018", {}, amount}, [p](bool ok) { p->set_value(ok); });
+    return f.wait_for(std::chrono::seconds(5)) == std::future_status::ready && f.get();
+}
+
+uintmax_t journalBytes(const std::string &dir)
+{
+    uintmax_t total = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(dir))
+        total += entry.file_size();
+    return total;
+}
+
+// Every payload links to the one before it, starting from the zero hash.
+bool chained(const std::string &dir, size_t &records)
+{
+    AuditJournal::Hash prev{};
+    bool ok = true;
+    records = GroupCommitLog(dir, "audit").replay([&](std::string_view payload) {
+        ok = ok && payload.size() > AuditJournal::kHashSize &&
+             payload.compare(0, AuditJournal::kHashSize,
+                             std::string_view(reinterpret_cast<const char *>(prev.data()), prev.size())) == 0;
+        prev = AuditJournal::hash(payload);
+    });
+    return ok;
+}
+
+} // namespace
+
+// A failed write fences the journal instead of chaining later records to
+// one that was cut off, and a restart continues from the last durable one.
+DROGON_TEST(AuditJournalFencesAfterFailedWrite)
+{
+    TempDir dir("audit_fence");
+    {
+        AuditJournal journal(strict(dir.path));
+        journal.open();
+        CHECK(record(journal, 1));
+        {
+            FileSizeLimit limit(journalBytes(dir.path) + 20);
+            CHECK(!record(journal, 2));
+        }
+        CHECK(!record(journal, 3));
+        journal.stop();
+    }
+    {
+        AuditJournal journal(strict(dir.path));
+        journal.open();
+        CHECK(record(journal, 4));
+        journal.stop();
+    }
+
+    size_t records = 0;
+    CHECK(chained(dir.path, records));
+    CHECK(records == 2);
+}
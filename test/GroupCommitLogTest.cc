@@ -0,0 +1,169 @@
+#include <drogon/drogon_test.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "GroupCommitLog.h"
+
+namespace {
+
+struct TempDir
+{
+    std::string path;
+
+    explicit TempDir(const char *name)
+        : path((std::filesystem::temp_directory_path() /
+                (std::string("cppauth_") + name + "." + std::to_string(getpid()))).string())
+    {
+        std::filesystem::remove_all(path);
+    }
+
+    ~TempDir() { std::filesystem::remove_all(path); }
+};
+
+// Appends and waits for the completion.
+bool append(GroupCommitLog &log, std::string payload)
+{
+    auto p = std::make_shared<std::promise<bool>>();
+    auto f = p->get_future();
+    log.append(std::move(payload), [p](bool ok) { p->set_value(ok); });
+    return f.wait_for(std::chrono::seconds(5)) == std::future_status::ready && f.get();
+}
+
+std::vector<std::string> replayAll(const std::string &dir)
+{
+    std::vector<std::string> out;
+    GroupCommitLog(dir, "j").replay([&out](std::string_view rec) { out.emplace_back(rec); });
+    return out;
+}
+
+// Makes the next write() past `bytes` into the file fail with EFBIG.
+struct FileSizeLimit
+{
+    rlimit saved{};
+
+    explicit FileSizeLimit(rlim_t bytes)
+    {
+        std::signal(SIGXFSZ, SIG_IGN);
+        getrlimit(RLIMIT_FSIZE, &saved);
+        rlimit limit = saved;
+        limit.rlim_cur = bytes;
+        setrlimit(RLIMIT_FSIZE, &limit);
+    }
+
+    ~FileSizeLimit() { setrlimit(RLIMIT_FSIZE, &saved); }
+};
+
+uintmax_t segmentBytes(const std::string &dir)
+{
+    uintmax_t total = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(dir))
+        total += entry.file_size();
+    return total;
+}
+
+} // namespace
+
+DROGON_TEST(GroupCommitLogReplay)
+{
+    TempDir dir("gcl_replay");
+    {
+        GroupCommitLog log(dir.path, "j");
+        log.open();
+        CHECK(append(log, "first"));
+        CHECK(append(log, ""));
+        CHECK(append(log, std::string(1000, 'x')));
+        log.stop();
+    }
+    auto records = replayAll(dir.path);
+    REQUIRE(records.size() == 3);
+    CHECK(records[0] == "first");
+    CHECK(records[1].empty());
+    CHECK(records[2] == std::string(1000, 'x'));
+}
+
+// A crash mid-write leaves half a record; replay keeps what is before it and
+// cuts the rest off, so the next open appends after a clean record.
+DROGON_TEST(GroupCommitLogTornTail)
+{
+    TempDir dir("gcl_torn");
+    {
+        GroupCommitLog log(dir.path, "j");
+        log.open();
+        CHECK(append(log, "kept"));
+        log.stop();
+    }
+    std::string torn;
+    GroupCommitLog::frame(torn, "lost in the crash");
+    {
+        auto path = std::filesystem::directory_iterator(dir.path)->path().string();
+        FILE *f = std::fopen(path.c_str(), "ab");
+        REQUIRE(f != nullptr);
+        std::fwrite(torn.data(), 1, torn.size() - 5, f);
+        std::fclose(f);
+    }
+    auto records = replayAll(dir.path);
+    REQUIRE(records.size() == 1);
+    CHECK(records[0] == "kept");
+
+    GroupCommitLog log(dir.path, "j");
+    log.open();
+    CHECK(append(log, "after"));
+    log.stop();
+    records = replayAll(dir.path);
+    REQUIRE(records.size() == 2);
+    CHECK(records[1] == "after");
+}
+
+// A failed write must not leave a partial record that hides the records
+// acknowledged after it.
+DROGON_TEST(GroupCommitLogFailedWrite)
+{
+    TempDir dir("gcl_failed");
+    GroupCommitLog log(dir.path, "j");
+    log.open();
+    CHECK(append(log, "before"));
+    {
+        FileSizeLimit limit(segmentBytes(dir.path) + 20);
+        CHECK(!append(log, std::string(4096, 'f')));
+    }
+    CHECK(append(log, "after"));
+    log.stop();
+
+    auto records = replayAll(dir.path);
+    REQUIRE(records.size() == 2);
+    CHECK(records[0] == "before");
+    CHECK(records[1] == "after");
+}
+
+// With setStopOnError() nothing is accepted after a failure.
+DROGON_TEST(GroupCommitLogStopOnError)
+{
+    TempDir dir("gcl_stop");
+    GroupCommitLog log(dir.path, "j");
+    log.setStopOnError(true);
+    log.open();
+    CHECK(append(log, "before"));
+    {
+        FileSizeLimit limit(segmentBytes(dir.path) + 20);
+        CHECK(!append(log, std::string(4096, 'f')));
+    }
+    CHECK(!append(log, "after"));
+
+    auto synced = std::make_shared<std::promise<bool>>();
+    log.sync([synced](bool ok) { synced->set_value(ok); });
+    auto f = synced->get_future();
+    REQUIRE(f.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    CHECK(!f.get());
+    log.stop();
+
+    auto records = replayAll(dir.path);
+    REQUIRE(records.size() == 1);
+    CHECK(records[0] == "before");
+}
@@ -0,0 +1,77 @@
+#include <drogon/drogon_test.h>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MpscRing.h"
+
+DROGON_TEST(MpscRingFullAndEmpty)
+{
+    MpscRing<std::string> ring(3); // rounded up to 4
+    std::string v;
+    CHECK(!ring.tryPop(v));
+    for (int i = 0; i < 4; ++i)
+    {
+        v = "item" + std::to_string(i);
+        CHECK(ring.tryPush(v));
+    }
+    v = "overflow";
+    CHECK(!ring.tryPush(v));
+    CHECK(v == "overflow"); // left untouched when full
+
+    // FIFO, and slots are reused after a pop
+    CHECK(ring.tryPop(v));
+    CHECK(v == "item0");
+    v = "item4";
+    CHECK(ring.tryPush(v));
+    for (int i = 1; i <= 4; ++i)
+    {
+        REQUIRE(ring.tryPop(v));
+        CHECK(v == "item" + std::to_string(i));
+    }
+    CHECK(!ring.tryPop(v));
+}
+
+DROGON_TEST(MpscRingProducers)
+{
+    constexpr int kProducers = 4;
+    constexpr uint64_t kPerProducer = 20000;
+    MpscRing<uint64_t> ring(64);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p)
+        producers.emplace_back([&ring, p] {
+            for (uint64_t i = 0; i < kPerProducer; ++i)
+            {
+                uint64_t v = (static_cast<uint64_t>(p) << 32) | i;
+                while (!ring.tryPush(v))
+                    std::this_thread::yield();
+            }
+        });
+
+    // Every value arrives once, and each producer's values in order
+    std::vector<uint64_t> next(kProducers, 0);
+    bool ordered = true;
+    for (uint64_t received = 0; received < kProducers * kPerProducer;)
+    {
+        uint64_t v;
+        if (!ring.tryPop(v))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        auto p = static_cast<size_t>(v >> 32);
+        ordered = ordered && p < next.size() && (v & 0xFFFFFFFF) == next[p];
+        if (p < next.size())
+            ++next[p];
+        ++received;
+    }
+    for (auto &t : producers)
+        t.join();
+
+    CHECK(ordered);
+    for (uint64_t n : next)
+        CHECK(n == kPerProducer);
+    uint64_t v;
+    CHECK(!ring.tryPop(v));
+}
@@ -0,0 +1,96 @@
+#include <drogon/drogon_test.h>
+#include <drogon/orm/DbClient.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <string>
+#include "DbRouter.h"
+#include "SessionStore.h"
+
+namespace {
+
+struct Fixture
+{
+    std::string path = "/tmp/cppauth_sessions_test." + std::to_string(getpid()) + ".db";
+    drogon::orm::DbClientPtr client;
+    std::shared_ptr<DbSessionStore> store;
+
+    Fixture()
+    {
+        std::remove(path.c_str());
+        client = drogon::orm::DbClient::newSqlite3Client("filename=" + path, 1);
+        auto router = std::make_shared<DbRouter>(client, client, std::make_shared<SqliteWriteBatcher>(client));
+        DbSessionStore::ensureSchema(*router);
+        store = std::make_shared<DbSessionStore>(router, SessionStore::Options{});
+    }
+
+    ~Fixture() { std::remove(path.c_str()); }
+
+    template <typename Call>
+    SessionStore::Result wait(Call call)
+    {
+        auto p = std::make_shared<std::promise<SessionStore::Result>>();
+        call([p](SessionStore::Result r) { p->set_value(r); });
+        auto f = p->get_future();
+        if (f.wait_for(std::chrono::seconds(5)) != std::future_status::ready)
+            return SessionStore::Result::Error;
+        return f.get();
+    }
+
+    SessionStore::Result put(const std::string &user, const std::string &token)
+    {
+        return wait([&](SessionStore::Done done) { store->put(user, token, std::chrono::hours(1), done); });
+    }
+
+    SessionStore::Result check(const std::string &user, const std::string &token)
+    {
+        return wait([&](SessionStore::Done done) { store->check(user, token, done); });
+    }
+
+    SessionStore::Result rotate(const std::string &user, const std::string &from, const std::string &to)
+    {
+        return wait([&](SessionStore::Done done) { store->rotate(user, from, to, std::chrono::hours(1), done); });
+    }
+
+    int64_t version(const std::string &user)
+    {
+        auto r = client->execSqlSync("SELECT version FROM sessions WHERE username = $1", user);
+        return r.empty() ? 0 : r[0]["version"].as<int64_t>();
+    }
+};
+
+} // namespace
+
+DROGON_TEST(SessionStoreRotateIsSingleUse)
+{
+    Fixture fx;
+    REQUIRE(fx.put("alice", "t1") == SessionStore::Result::Ok);
+    CHECK(fx.check("alice", "t1") == SessionStore::Result::Ok);
+    CHECK(fx.check("alice", "other") == SessionStore::Result::Rejected);
+
+    CHECK(fx.rotate("alice", "t1", "t2") == SessionStore::Result::Ok);
+    CHECK(fx.rotate("alice", "t1", "t3") == SessionStore::Result::Rejected);
+    CHECK(fx.check("alice", "t1") == SessionStore::Result::Rejected);
+    CHECK(fx.check("alice", "t2") == SessionStore::Result::Ok);
+    CHECK(fx.rotate("nobody", "t1", "t2") == SessionStore::Result::Rejected);
+}
+
+// Deleting the newest row (expiry) must not hand its version out again, or
+// a replica polling for newer versions would miss the next write.
+DROGON_TEST(SessionStoreVersionsOutliveDeletes)
+{
+    Fixture fx;
+    REQUIRE(fx.put("alice", "a") == SessionStore::Result::Ok);
+    REQUIRE(fx.put("bob", "b") == SessionStore::Result::Ok);
+    int64_t bob = fx.version("bob");
+    CHECK(bob > fx.version("alice"));
+
+    fx.client->execSqlSync("DELETE FROM sessions WHERE username = 'bob'");
+    REQUIRE(fx.put("carol", "c") == SessionStore::Result::Ok);
+    CHECK(fx.version("carol") > bob);
+
+    REQUIRE(fx.rotate("alice", "a", "a2") == SessionStore::Result::Ok);
+    CHECK(fx.version("alice") > fx.version("carol"));
+}
@@ -0,0 +1,122 @@
+#include <drogon/drogon_test.h>
+#include <drogon/orm/DbClient.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SingleFlight.h"
+
+namespace {
+
+// Holds each launched query back until release(), so callers can pile up
+// behind it.
+struct Launcher
+{
+    drogon::orm::DbClientPtr client = drogon::orm::DbClient::newSqlite3Client("filename=:memory:", 1);
+    std::vector<std::function<void()>> held;
+
+    auto launch(const std::string &sql)
+    {
+        return [this, sql](drogon::orm::ResultCallback rcb, drogon::orm::ExceptionCallback ecb) {
+            held.push_back([this, sql, rcb = std::move(rcb), ecb = std::move(ecb)] {
+                client->execSqlAsync(sql, rcb, ecb);
+            });
+        };
+    }
+
+    void release()
+    {
+        auto launches = std::move(held);
+        held.clear();
+        for (auto &l : launches)
+            l();
+    }
+};
+
+struct Answers
+{
+    std::atomic<int> rows{0};
+    std::atomic<int> errors{0};
+    std::atomic<int> pending{0};
+    std::promise<void> done;
+
+    drogon::orm::ResultCallback onResult()
+    {
+        ++pending;
+        return [this](const drogon::orm::Result &r) {
+            rows += static_cast<int>(r.size());
+            if (--pending == 0) done.set_value();
+        };
+    }
+
+    drogon::orm::ExceptionCallback onError()
+    {
+        return [this](const drogon::orm::DrogonDbException &) {
+            ++errors;
+            if (--pending == 0) done.set_value();
+        };
+    }
+
+    bool wait() { return done.get_future().wait_for(std::chrono::seconds(5)) == std::future_status::ready; }
+};
+
+} // namespace
+
+DROGON_TEST(SingleFlightCoalesces)
+{
+    SingleFlight flights;
+    Launcher db;
+    Answers answers;
+    std::string key = SingleFlight::key("SELECT 1", {"ACCT0000000018"});
+
+    for (int i = 0; i < 3; ++i)
+        flights.run(key, answers.onResult(), answers.onError(), db.launch("SELECT 1"));
+    flights.run(SingleFlight::key("SELECT 1", {"ACCT0000000026"}), answers.onResult(), answers.onError(),
+                db.launch("SELECT 1"));
+    CHECK(db.held.size() == 2);
+    db.release();
+    REQUIRE(answers.wait());
+    CHECK(answers.rows == 4);
+    CHECK(answers.errors == 0);
+
+    auto s = flights.stats();
+    CHECK(s.queries == 2);
+    CHECK(s.joined == 2);
+    CHECK(s.overflow == 0);
+}
+
+DROGON_TEST(SingleFlightForgetAndOverflow)
+{
+    SingleFlight::Options options;
+    options.maxWaiters = 2;
+    SingleFlight flights(options);
+    Launcher db;
+    Answers answers;
+    std::string key = SingleFlight::key("SELECT 1", {});
+
+    // Two fit in one flight; the third starts another
+    for (int i = 0; i < 3; ++i)
+        flights.run(key, answers.onResult(), answers.onError(), db.launch("SELECT 1"));
+    CHECK(db.held.size() == 2);
+    CHECK(flights.stats().overflow == 1);
+
+    // After forget() a read never joins a query already in flight
+    flights.forget(key);
+    flights.run(key, answers.onResult(), answers.onError(), db.launch("SELECT 1"));
+    CHECK(db.held.size() == 3);
+
+    // Errors reach every waiter too
+    std::string bad = SingleFlight::key("SELECT * FROM missing_table", {});
+    for (int i = 0; i < 2; ++i)
+        flights.run(bad, answers.onResult(), answers.onError(), db.launch("SELECT * FROM missing_table"));
+    CHECK(db.held.size() == 4);
+
+    db.release();
+    REQUIRE(answers.wait());
+    CHECK(answers.rows == 4);
+    CHECK(answers.errors == 2);
+    CHECK(flights.stats().queries == 4);
+}
@@ -0,0 +1,57 @@
+#include <drogon/drogon_test.h>
+#include <cstdint>
+#include <string>
+#include "SqlFingerprint.h"
+
+DROGON_TEST(SqlFingerprintNormalize)
+{
+    // Placeholders and literals of any kind share one shape
+    CHECK(SqlFingerprint::normalize("SELECT balance FROM users WHERE account_number=$1") ==
+          "select balance from users where account_number=?");
+    CHECK(SqlFingerprint::normalize("select  balance\n  from users where account_number = 'ACCT0000000018'") ==
+          "select balance from users where account_number=?");
+    CHECK(SqlFingerprint::normalize("UPDATE users SET balance = balance - 12.50 WHERE id = ?1") ==
+          "update users set balance=balance-? where id=?");
+    CHECK(SqlFingerprint::normalize("SELECT \"Users\".id FROM \"Users\" WHERE x > .5") ==
+          "select \"users\".id from \"users\" where x>?");
+
+    // '' inside a literal does not end it
+    CHECK(SqlFingerprint::normalize("SELECT id FROM users WHERE username = 'o''brien' AND id > 3") ==
+          "select id from users where username=? and id>?");
+
+    // IN lists of any length collapse, a single value does not
+    CHECK(SqlFingerprint::normalize("SELECT * FROM t WHERE id IN (1, 2, 3)") == "select*from t where id in(?...)");
+    CHECK(SqlFingerprint::normalize("SELECT * FROM t WHERE id IN ($1,$2)") == "select*from t where id in(?...)");
+    CHECK(SqlFingerprint::normalize("SELECT * FROM t WHERE id IN ($1)") == "select*from t where id in(?)");
+}
+
+DROGON_TEST(SqlFingerprintInterning)
+{
+    const auto *a = SqlFingerprint::of("SELECT balance FROM fp_test WHERE account_number=$1");
+    const auto *b = SqlFingerprint::of("select balance from fp_test where account_number = 'ACCT0000000018'");
+    const auto *c = SqlFingerprint::of("SELECT email FROM fp_test WHERE account_number=$1");
+    REQUIRE(a != nullptr);
+    REQUIRE(c != nullptr);
+
+    // Same shape, same entry; the sample is the first raw text seen
+    CHECK(a == b);
+    CHECK(a->sample == "SELECT balance FROM fp_test WHERE account_number=$1");
+    CHECK(a->id == SqlFingerprint::hash(a->text));
+    CHECK(SqlFingerprint::of("SELECT balance FROM fp_test WHERE account_number=$1") == a);
+
+    CHECK(c != a);
+    CHECK(c->id != a->id);
+    CHECK(c->index > a->index);
+
+    auto all = SqlFingerprint::all();
+    REQUIRE(all.size() > c->index);
+    CHECK(all[a->index] == a);
+    CHECK(all[c->index] == c);
+}
+
+DROGON_TEST(SqlFingerprintParamTypes)
+{
+    CHECK((SqlFingerprint::paramTypes<std::string, const char *, double, int64_t, bool>() ==
+           "string, string, double, int, bool"));
+    CHECK(SqlFingerprint::paramTypes<>().empty());
+}
@@ -0,0 +1,37 @@
+#include <drogon/drogon_test.h>
+#include <drogon/orm/DbClient.h>
+#include <unistd.h>
+#include <cstdio>
+#include <set>
+#include <string>
+#include "SqliteTuning.h"
+
+// Every reader connection, not just whichever ran the pragma first, is
+// read-only and waits on locks.
+DROGON_TEST(SqliteTuningConfiguresEveryReader)
+{
+    std::string path = "/tmp/cppauth_tuning_test." + std::to_string(getpid()) + ".db";
+    std::remove(path.c_str());
+    {
+        SqliteTuning tuning;
+        tuning.readers = 3;
+        auto router = tuning.open("filename=" + path);
+
+        std::set<drogon::orm::DbClient *> seen;
+        for (size_t i = 0; i < 2 * tuning.readers; ++i)
+        {
+            const auto &reader = router->reader();
+            seen.insert(reader.get());
+            CHECK(reader->execSqlSync("PRAGMA query_only")[0][0].as<int64_t>() == 1);
+            CHECK(reader->execSqlSync("PRAGMA busy_timeout")[0][0].as<int64_t>() == 5000);
+            CHECK_THROWS(reader->execSqlSync("CREATE TABLE t (x INTEGER)"));
+        }
+        CHECK(seen.size() == tuning.readers);
+
+        CHECK(router->writer()->execSqlSync("PRAGMA query_only")[0][0].as<int64_t>() == 0);
+        CHECK(router->writer()->execSqlSync("PRAGMA journal_mode")[0][0].as<std::string>() == "wal");
+    }
+    std::remove(path.c_str());
+    std::remove((path + "-wal").c_str());
+    std::remove((path + "-shm").c_str());
+}
@@ -0,0 +1,104 @@
+#include <drogon/drogon_test.h>
+#include <drogon/orm/DbClient.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "DbRouter.h"
+
+namespace {
+
+struct Fixture
+{
+    std::string path = "/tmp/cppauth_batcher_test." + std::to_string(getpid()) + ".db";
+    drogon::orm::DbClientPtr client;
+    std::shared_ptr<DbRouter> router;
+
+    Fixture()
+    {
+        std::remove(path.c_str());
+        client = drogon::orm::DbClient::newSqlite3Client("filename=" + path, 1);
+        client->execSqlSync("CREATE TABLE t (k TEXT PRIMARY KEY)");
+        client->execSqlSync("INSERT INTO t VALUES ('taken')");
+        router = std::make_shared<DbRouter>(client, client, std::make_shared<SqliteWriteBatcher>(client));
+    }
+
+    ~Fixture() { std::remove(path.c_str()); }
+
+    // INSERT through the batcher; the future says whether it was committed
+    std::future<bool> insert(const std::string &key)
+    {
+        auto p = std::make_shared<std::promise<bool>>();
+        router->write(
+            "INSERT INTO t (k) VALUES ($1)",
+            [p](const drogon::orm::Result &) { p->set_value(true); },
+            [p](const drogon::orm::DrogonDbException &) { p->set_value(false); },
+            key);
+        return p->get_future();
+    }
+
+    size_t count()
+    {
+        return client->execSqlSync("SELECT k FROM t").size();
+    }
+};
+
+bool settled(std::future<bool> &f)
+{
+    return f.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+}
+
+} // namespace
+
+// The first write goes out alone; the next three share one batch in which the
+// middle one hits the primary key. Only that one may fail, and the batcher
+// must keep taking writes afterwards.
+DROGON_TEST(SqliteWriteBatcherFailingOpInBatch)
+{
+    Fixture fx;
+    std::vector<std::future<bool>> results;
+    for (const char *key : {"a", "b", "taken", "c"})
+        results.push_back(fx.insert(key));
+
+    for (auto &r : results)
+        REQUIRE(settled(r));
+    CHECK(results[0].get() == true);
+    CHECK(results[1].get() == true);
+    CHECK(results[2].get() == false);
+    CHECK(results[3].get() == true);
+    CHECK(fx.count() == 4);
+
+    auto after = fx.insert("d");
+    REQUIRE(settled(after));
+    CHECK(after.get() == true);
+    CHECK(fx.count() == 5);
+}
+
+// finish(false) without a DB error rolls back that op's savepoint only.
+DROGON_TEST(SqliteWriteBatcherDiscardedOp)
+{
+    Fixture fx;
+    auto first = fx.insert("a");
+    auto p = std::make_shared<std::promise<bool>>();
+    fx.router->transaction(
+        [](const TransactionPtr &trans, std::function<void(bool)> finish) {
+            DbRouter::exec(trans, "INSERT INTO t (k) VALUES ($1)",
+                           [finish](const drogon::orm::Result &) { finish(false); },
+                           [finish](const drogon::orm::DrogonDbException &) { finish(false); },
+                           std::string("discarded"));
+        },
+        [p](bool committed) { p->set_value(committed); });
+    auto discarded = p->get_future();
+    auto last = fx.insert("b");
+
+    REQUIRE(settled(first));
+    REQUIRE(settled(discarded));
+    REQUIRE(settled(last));
+    CHECK(first.get() == true);
+    CHECK(discarded.get() == false);
+    CHECK(last.get() == true);
+    CHECK(fx.count() == 3);
+}
@@ -0,0 +1,176 @@
+// cppAuth_auditverify: checks the hash chain of an audit journal (see
+// include/AuditJournal.h).
+//
+// Usage:
+//   cppAuth_auditverify [--head HEX] [--from HEX] [DIR]      (DIR defaults to ./audit)
+//
+// Every record must pass its CRC, carry the SHA-256 of the record before it
+// and the next sequence number. --head compares the final hash with one
+// taken from the server log ("Audit journal closed at seq N, head ..."), so
+// a chain rewritten end to end is caught too. --from anchors the first
+// record when older segments have been archived away; without it the chain
+// must start at seq 1 from an all-zero hash.
+//
+// Exit status: 0 intact, 1 broken, 2 usage or I/O error. A torn record at
+// the very end of the newest segment (a crash mid-write, never
+// acknowledged) is reported but is not a failure.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "AuditJournal.h"
+
+namespace {
+
+bool parseHex(const std::string &s, AuditJournal::Hash &out)
+{
+    if (s.size() != 2 * AuditJournal::kHashSize) return false;
+    for (size_t i = 0; i < out.size(); ++i)
+    {
+        unsigned v = 0;
+        if (std::sscanf(s.c_str() + 2 * i, "%2x", &v) != 1) return false;
+        out[i] = static_cast<unsigned char>(v);
+    }
+    return true;
+}
+
+std::string segmentPath(const std::string &dir, uint64_t seg)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "audit.%08llu.log", static_cast<unsigned long long>(seg));
+    return dir + "/" + name;
+}
+
+int usage()
+{
+    std::cerr << "usage: cppAuth_auditverify [--head HEX] [--from HEX] [DIR]\n";
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::string dir = "./audit";
+    AuditJournal::Hash expectHead{}, prev{};
+    bool checkHead = false, anchored = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string a = argv[i];
+        if (a == "--head" && i + 1 < argc)
+        {
+            if (!parseHex(argv[++i], expectHead)) return usage();
+            checkHead = true;
+        }
+        else if (a == "--from" && i + 1 < argc)
+        {
+            if (!parseHex(argv[++i], prev)) return usage();
+            anchored = true;
+        }
+        else if (!a.empty() && a[0] == '-')
+            return usage();
+        else
+            dir = a;
+    }
+
+    auto segments = GroupCommitLog(dir, "audit").segments();
+    if (segments.empty())
+    {
+        std::cerr << "no audit segments in " << dir << "\n";
+        return 2;
+    }
+
+    uint64_t records = 0, firstSeq = 0, lastSeq = 0;
+    for (size_t s = 0; s < segments.size(); ++s)
+    {
+        std::string path = segmentPath(dir, segments[s]);
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            std::cerr << path << ": cannot open\n";
+            return 2;
+        }
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        bool newest = s + 1 == segments.size();
+
+        size_t off = 0;
+        while (off < data.size())
+        {
+            uint32_t hdr[2];
+            bool torn = data.size() - off < sizeof(hdr);
+            if (!torn)
+            {
+                std::memcpy(hdr, data.data() + off, sizeof(hdr));
+                torn = data.size() - off - sizeof(hdr) < hdr[0];
+            }
+            std::string_view payload;
+            if (!torn)
+            {
+                payload = std::string_view(data).substr(off + sizeof(hdr), hdr[0]);
+                torn = GroupCommitLog::crc32(payload) != hdr[1];
+                if (torn && !(newest && off + sizeof(hdr) + hdr[0] == data.size()))
+                {
+                    std::cout << "BROKEN: " << path << " offset " << off << ": CRC mismatch\n";
+                    return 1;
+                }
+            }
+            if (torn)
+            {
+                if (!newest)
+                {
+                    std::cout << "BROKEN: " << path << " offset " << off << ": truncated record\n";
+                    return 1;
+                }
+                std::cout << "note: " << path << " ends in a torn record at offset " << off
+                          << " (never acknowledged)\n";
+                break;
+            }
+
+            uint64_t seq = AuditJournal::sequenceOf(payload);
+            if (payload.size() < AuditJournal::kHashSize || seq == 0)
+            {
+                std::cout << "BROKEN: " << path << " offset " << off << ": not an audit record\n";
+                return 1;
+            }
+            if (records == 0 && !anchored && seq != 1)
+            {
+                std::cout << "BROKEN: chain starts at seq " << seq
+                          << "; pass --from with the head logged before it if older segments were archived\n";
+                return 1;
+            }
+            if (std::memcmp(payload.data(), prev.data(), prev.size()) != 0)
+            {
+                std::cout << "BROKEN: " << path << " offset " << off << ": seq " << seq
+                          << " does not link to the record before it\n";
+                return 1;
+            }
+            if (records > 0 && seq != lastSeq + 1)
+            {
+                std::cout << "BROKEN: " << path << " offset " << off << ": seq " << seq << " follows " << lastSeq
+                          << "\n";
+                return 1;
+            }
+
+            if (records == 0) firstSeq = seq;
+            lastSeq = seq;
+            ++records;
+            prev = AuditJournal::hash(payload);
+            off += sizeof(hdr) + hdr[0];
+        }
+    }
+
+    if (checkHead && prev != expectHead)
+    {
+        std::cout << "BROKEN: head " << AuditJournal::hex(prev) << " does not match " << AuditJournal::hex(expectHead)
+                  << "\n";
+        return 1;
+    }
+    std::cout << "OK: " << records << " records";
+    if (records) std::cout << ", seq " << firstSeq << ".." << lastSeq;
+    std::cout << ", " << segments.size() << " segments, head " << AuditJournal::hex(prev) << "\n";
+    return 0;
+}
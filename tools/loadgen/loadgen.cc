@@ -0,0 +1,429 @@
+// cppAuth_loadgen: open-loop replay of NDJSON request scripts.
+//
+// Requests are issued on a Poisson schedule at a fixed arrival rate, no matter
+// how fast the server answers, and each latency is measured from the request's
+// *intended* send time. A server stall therefore shows up as the queueing delay
+// real clients would see instead of silently lowering the offered load
+// (coordinated omission).
+//
+// Script format, one JSON object per line:
+//   {"method": "POST", "path": "/deposit", "auth": true,
+//    "body": {"amount": "{{amount}}"}, "headers": {}, "weight": 2}
+//
+// Placeholders: {{user}}, {{password}}, {{token}}, {{seq}}; "{{amount}}" written
+// as a whole JSON string value is emitted as a bare number. "auth": true adds
+// "Authorization: Bearer {{token}}". Users are registered and logged in before
+// the run unless --no-setup is given.
+//
+// Usage:
+//   cppAuth_loadgen --url http://127.0.0.1:8088 --script tools/loadgen/example.jsonl
+//                   --rate 2000 --duration 60 [--warmup 5] [--users 100]
+//                   [--connections 64] [--threads 4] [--seed 1] [--out result.json]
+
+#include <drogon/HttpClient.h>
+#include <drogon/drogon.h>
+#include <trantor/net/EventLoopThread.h>
+#include <trantor/net/EventLoopThreadPool.h>
+#include <json/json.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HdrHistogram.h"
+
+using namespace drogon;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct LoadgenOptions
+{
+    std::string url = "http://127.0.0.1:8088";
+    std::string script = "tools/loadgen/example.jsonl";
+    double rate = 1000;          // requests per second
+    double duration = 30;        // measured seconds
+    double warmup = 5;           // unmeasured seconds before that
+    size_t users = 100;
+    size_t connections = 64;
+    size_t threads = 4;
+    uint64_t seed = 1;
+    double timeout = 10;
+    bool setup = true;
+    std::string out;
+};
+
+struct ScriptEntry
+{
+    HttpMethod method = Get;
+    std::string methodName = "GET";
+    std::string path;
+    std::string body; // serialized template, empty for no body
+    std::vector<std::pair<std::string, std::string>> headers;
+    double weight = 1;
+    std::unique_ptr<HdrHistogram> latency = std::make_unique<HdrHistogram>();
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> failed{0};
+};
+
+struct User
+{
+    std::string name;
+    std::string password;
+    std::string token;
+};
+
+struct Stats
+{
+    HdrHistogram latency;
+    std::atomic<uint64_t> scheduled{0};
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> byClass[6]{}; // [0] transport errors, [n] nxx
+    std::atomic<uint64_t> outstanding{0};
+    std::atomic<uint64_t> maxLagUs{0};  // how late the dispatcher itself ran
+};
+
+void usage()
+{
+    std::cerr << "usage: cppAuth_loadgen --url URL --script FILE [--rate RPS] [--duration S]\n"
+                 "                       [--warmup S] [--users N] [--connections N] [--threads N]\n"
+                 "                       [--seed N] [--timeout S] [--no-setup] [--out FILE]\n";
+}
+
+bool parseArgs(int argc, char **argv, LoadgenOptions &o)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string a = argv[i];
+        auto next = [&](const char *name) -> const char * {
+            if (i + 1 >= argc)
+                throw std::runtime_error(std::string("missing value for ") + name);
+            return argv[++i];
+        };
+        if (a == "--url") o.url = next("--url");
+        else if (a == "--script") o.script = next("--script");
+        else if (a == "--rate") o.rate = std::atof(next("--rate"));
+        else if (a == "--duration") o.duration = std::atof(next("--duration"));
+        else if (a == "--warmup") o.warmup = std::atof(next("--warmup"));
+        else if (a == "--users") o.users = std::strtoul(next("--users"), nullptr, 10);
+        else if (a == "--connections") o.connections = std::strtoul(next("--connections"), nullptr, 10);
+        else if (a == "--threads") o.threads = std::strtoul(next("--threads"), nullptr, 10);
+        else if (a == "--seed") o.seed = std::strtoull(next("--seed"), nullptr, 10);
+        else if (a == "--timeout") o.timeout = std::atof(next("--timeout"));
+        else if (a == "--no-setup") o.setup = false;
+        else if (a == "--out") o.out = next("--out");
+        else if (a == "-h" || a == "--help") return false;
+        else throw std::runtime_error("unknown option " + a);
+    }
+    return o.rate > 0 && o.duration > 0 && o.users > 0 && o.connections > 0 && o.threads > 0;
+}
+
+HttpMethod methodFromString(const std::string &m)
+{
+    if (m == "POST") return Post;
+    if (m == "PUT") return Put;
+    if (m == "DELETE") return Delete;
+    if (m == "PATCH") return Patch;
+    return Get;
+}
+
+std::vector<std::unique_ptr<ScriptEntry>> loadScript(const std::string &file)
+{
+    std::ifstream in(file);
+    if (!in)
+        throw std::runtime_error("cannot open script " + file);
+
+    Json::CharReaderBuilder rb;
+    Json::StreamWriterBuilder wb;
+    wb["indentation"] = "";
+
+    std::vector<std::unique_ptr<ScriptEntry>> entries;
+    std::string line;
+    size_t lineNo = 0;
+    while (std::getline(in, line))
+    {
+        ++lineNo;
+        if (line.find_first_not_of(" \t\r") == std::string::npos || line[0] == '#')
+            continue;
+        Json::Value v;
+        std::string errs;
+        std::istringstream ls(line);
+        if (!Json::parseFromStream(rb, ls, &v, &errs) || !v.isObject() || !v["path"].isString())
+            throw std::runtime_error(file + ":" + std::to_string(lineNo) + ": invalid entry " + errs);
+
+        auto e = std::make_unique<ScriptEntry>();
+        e->methodName = v.get("method", "GET").asString();
+        e->method = methodFromString(e->methodName);
+        e->path = v["path"].asString();
+        e->weight = v.get("weight", 1.0).asDouble();
+        if (v.isMember("body"))
+            e->body = v["body"].isString() ? v["body"].asString() : Json::writeString(wb, v["body"]);
+        if (v["headers"].isObject())
+            for (const auto &name : v["headers"].getMemberNames())
+                e->headers.emplace_back(name, v["headers"][name].asString());
+        if (v.get("auth", false).asBool())
+            e->headers.emplace_back("Authorization", "Bearer {{token}}");
+        entries.push_back(std::move(e));
+    }
+    if (entries.empty())
+        throw std::runtime_error("script " + file + " has no entries");
+    return entries;
+}
+
+void replaceAll(std::string &s, const std::string &from, const std::string &to)
+{
+    for (size_t pos = s.find(from); pos != std::string::npos; pos = s.find(from, pos + to.size()))
+        s.replace(pos, from.size(), to);
+}
+
+std::string render(std::string s, const User &u, uint64_t seq, std::mt19937_64 &rng)
+{
+    if (s.find("{{") == std::string::npos)
+        return s;
+    std::uniform_int_distribution<int> amount(1, 100);
+    replaceAll(s, "\"{{amount}}\"", std::to_string(amount(rng)));
+    replaceAll(s, "{{amount}}", std::to_string(amount(rng)));
+    replaceAll(s, "{{user}}", u.name);
+    replaceAll(s, "{{password}}", u.password);
+    replaceAll(s, "{{token}}", u.token);
+    replaceAll(s, "{{seq}}", std::to_string(seq));
+    return s;
+}
+
+HttpRequestPtr buildRequest(const ScriptEntry &e, const User &u, uint64_t seq, std::mt19937_64 &rng)
+{
+    auto req = HttpRequest::newHttpRequest();
+    req->setMethod(e.method);
+    req->setPath(render(e.path, u, seq, rng));
+    for (const auto &h : e.headers)
+        req->addHeader(h.first, render(h.second, u, seq, rng));
+    if (!e.body.empty())
+    {
+        req->setContentTypeCode(CT_APPLICATION_JSON);
+        req->setBody(render(e.body, u, seq, rng));
+    }
+    return req;
+}
+
+// Registers (ignoring "already exists") and logs in every templated user.
+void setupUsers(const LoadgenOptions &o, std::vector<User> &users)
+{
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto client = HttpClient::newHttpClient(o.url, loopThread.getLoop());
+    Json::StreamWriterBuilder wb;
+    wb["indentation"] = "";
+
+    size_t loggedIn = 0;
+    for (auto &u : users)
+    {
+        Json::Value reg;
+        reg["username"] = u.name;
+        reg["email"] = u.name + "@loadgen.local";
+        reg["password"] = u.password;
+        auto r1 = HttpRequest::newHttpJsonRequest(reg);
+        r1->setMethod(Post);
+        r1->setPath("/register");
+        client->sendRequest(r1, o.timeout);
+
+        Json::Value login;
+        login["username"] = u.name;
+        login["password"] = u.password;
+        auto r2 = HttpRequest::newHttpJsonRequest(login);
+        r2->setMethod(Post);
+        r2->setPath("/login");
+        auto [result, resp] = client->sendRequest(r2, o.timeout);
+        if (result == ReqResult::Ok && resp && resp->statusCode() == k200OK && resp->jsonObject())
+        {
+            u.token = (*resp->jsonObject())["access_token"].asString();
+            ++loggedIn;
+        }
+    }
+    std::cerr << "[loadgen] setup: " << loggedIn << "/" << users.size() << " users logged in\n";
+}
+
+Json::Value histogramJson(const HdrHistogram &h)
+{
+    Json::Value j;
+    j["count"] = static_cast<Json::UInt64>(h.count());
+    j["min_us"] = static_cast<Json::UInt64>(h.min());
+    j["mean_us"] = h.mean();
+    for (double p : {50.0, 75.0, 90.0, 99.0, 99.9, 99.99})
+    {
+        std::ostringstream key;
+        key << "p" << p << "_us";
+        j[key.str()] = static_cast<Json::UInt64>(h.valueAtPercentile(p));
+    }
+    j["max_us"] = static_cast<Json::UInt64>(h.max());
+    return j;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    LoadgenOptions opt;
+    try
+    {
+        if (!parseArgs(argc, argv, opt))
+        {
+            usage();
+            return 2;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << "\n";
+        usage();
+        return 2;
+    }
+
+    try
+    {
+        auto script = loadScript(opt.script);
+
+        std::vector<User> users(opt.users);
+        for (size_t i = 0; i < users.size(); ++i)
+        {
+            users[i].name = "loadgen_user" + std::to_string(i);
+            users[i].password = "loadgen_pw" + std::to_string(i);
+        }
+        if (opt.setup)
+            setupUsers(opt, users);
+
+        trantor::EventLoopThreadPool loops(opt.threads, "loadgen");
+        loops.start();
+        std::vector<HttpClientPtr> clients;
+        for (size_t i = 0; i < opt.connections; ++i)
+            clients.push_back(HttpClient::newHttpClient(opt.url, loops.getNextLoop()));
+
+        std::vector<double> weights;
+        for (const auto &e : script)
+            weights.push_back(e->weight);
+
+        Stats stats;
+        std::mt19937_64 rng(opt.seed);
+        std::exponential_distribution<double> interArrival(opt.rate);
+        std::discrete_distribution<size_t> pickEntry(weights.begin(), weights.end());
+        std::uniform_int_distribution<size_t> pickUser(0, users.size() - 1);
+
+        const auto start = Clock::now() + std::chrono::milliseconds(100);
+        const auto measureFrom = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opt.warmup));
+        const auto end = measureFrom + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opt.duration));
+
+        std::cerr << "[loadgen] " << opt.rate << " req/s for " << opt.duration << "s (+" << opt.warmup
+                  << "s warmup) over " << opt.connections << " connections\n";
+
+        // The schedule is fixed by the seed; only the send loop below can fall
+        // behind it, and that lag is charged to the requests it delays.
+        auto intended = start;
+        uint64_t seq = 0;
+        while (intended < end)
+        {
+            intended += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interArrival(rng)));
+            std::this_thread::sleep_until(intended);
+            auto lag = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - intended).count();
+            if (lag > 0 && static_cast<uint64_t>(lag) > stats.maxLagUs.load())
+                stats.maxLagUs.store(static_cast<uint64_t>(lag));
+
+            ScriptEntry &entry = *script[pickEntry(rng)];
+            const User &user = users[pickUser(rng)];
+            auto req = buildRequest(entry, user, seq, rng);
+            auto &client = clients[seq % clients.size()];
+            bool measured = intended >= measureFrom;
+            ++seq;
+
+            if (measured)
+                stats.scheduled.fetch_add(1, std::memory_order_relaxed);
+            stats.outstanding.fetch_add(1, std::memory_order_relaxed);
+            entry.sent.fetch_add(1, std::memory_order_relaxed);
+
+            client->sendRequest(
+                req,
+                [&stats, &entry, intended, measured](ReqResult result, const HttpResponsePtr &resp) {
+                    auto us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - intended).count();
+                    if (measured)
+                    {
+                        stats.latency.record(static_cast<uint64_t>(us));
+                        entry.latency->record(static_cast<uint64_t>(us));
+                        size_t cls = (result == ReqResult::Ok && resp) ? std::min<size_t>(resp->statusCode() / 100, 5) : 0;
+                        stats.byClass[cls].fetch_add(1, std::memory_order_relaxed);
+                        if (cls == 0 || cls >= 4)
+                            entry.failed.fetch_add(1, std::memory_order_relaxed);
+                        stats.completed.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    stats.outstanding.fetch_sub(1, std::memory_order_relaxed);
+                },
+                opt.timeout);
+        }
+
+        // Drain: everything still in flight either answers or times out.
+        auto drainDeadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opt.timeout + 1));
+        while (stats.outstanding.load() > 0 && Clock::now() < drainDeadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        Json::Value report;
+        report["config"]["url"] = opt.url;
+        report["config"]["script"] = opt.script;
+        report["config"]["rate"] = opt.rate;
+        report["config"]["duration_s"] = opt.duration;
+        report["config"]["warmup_s"] = opt.warmup;
+        report["config"]["users"] = static_cast<Json::UInt64>(opt.users);
+        report["config"]["connections"] = static_cast<Json::UInt64>(opt.connections);
+        report["config"]["seed"] = static_cast<Json::UInt64>(opt.seed);
+        report["scheduled"] = static_cast<Json::UInt64>(stats.scheduled.load());
+        report["completed"] = static_cast<Json::UInt64>(stats.completed.load());
+        report["achieved_rps"] = stats.completed.load() / opt.duration;
+        report["transport_errors"] = static_cast<Json::UInt64>(stats.byClass[0].load());
+        for (int c = 2; c <= 5; ++c)
+            report["status"][std::to_string(c) + "xx"] = static_cast<Json::UInt64>(stats.byClass[c].load());
+        report["dispatcher_max_lag_us"] = static_cast<Json::UInt64>(stats.maxLagUs.load());
+        report["latency"] = histogramJson(stats.latency);
+        for (const auto &e : script)
+        {
+            Json::Value je;
+            je["method"] = e->methodName;
+            je["path"] = e->path;
+            je["sent"] = static_cast<Json::UInt64>(e->sent.load());
+            je["failed"] = static_cast<Json::UInt64>(e->failed.load());
+            je["latency"] = histogramJson(*e->latency);
+            report["entries"].append(je);
+        }
+        for (const auto &b : stats.latency.buckets())
+        {
+            Json::Value jb;
+            jb.append(static_cast<Json::UInt64>(b.first));
+            jb.append(static_cast<Json::UInt64>(b.second));
+            report["histogram_us"].append(jb);
+        }
+
+        Json::StreamWriterBuilder wb;
+        wb["indentation"] = "  ";
+        const std::string text = Json::writeString(wb, report);
+        if (!opt.out.empty())
+            std::ofstream(opt.out) << text << "\n";
+
+        const auto &h = stats.latency;
+        std::cout << "completed " << stats.completed.load() << "/" << stats.scheduled.load()
+                  << " (" << report["achieved_rps"].asDouble() << " req/s), errors "
+                  << stats.byClass[0].load() << " transport / " << stats.byClass[4].load() << " 4xx / "
+                  << stats.byClass[5].load() << " 5xx\n"
+                  << "latency us: p50 " << h.valueAtPercentile(50) << "  p90 " << h.valueAtPercentile(90)
+                  << "  p99 " << h.valueAtPercentile(99) << "  p99.9 " << h.valueAtPercentile(99.9)
+                  << "  max " << h.max() << "\n";
+        if (stats.maxLagUs.load() > 1000)
+            std::cout << "warning: dispatcher fell " << stats.maxLagUs.load()
+                      << "us behind schedule; client-side saturation may inflate results\n";
+        return 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "[loadgen] " << e.what() << "\n";
+        return 1;
+    }
+}
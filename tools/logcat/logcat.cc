@@ -0,0 +1,125 @@
+// cppAuth_logcat: decodes BinLog files (see include/BinLog.h) to text or NDJSON.
+//
+// Usage:
+//   cppAuth_logcat [--json] logs/request.blog [logs/request.blog.1 ...]
+//
+// Text lines look like the old spdlog output:
+//   [2026-10-19 14:03:11.482] [info] REQ_ID=... GET /balance STATUS=200 DURATION=3ms
+// --json prints one object per record: {"ts":..., "level":..., "msg":..., "args":[...]}.
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "BinLogReader.h"
+
+namespace {
+
+std::string jsonEscape(const std::string &s)
+{
+    std::string out;
+    for (unsigned char c : s)
+    {
+        switch (c)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20)
+            {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            }
+            else
+                out += static_cast<char>(c);
+        }
+    }
+    return out;
+}
+
+std::string timestamp(int64_t wallNs)
+{
+    std::time_t secs = static_cast<std::time_t>(wallNs / 1000000000);
+    std::tm tm{};
+    localtime_r(&secs, &tm);
+    char buf[40];
+    size_t n = std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    std::snprintf(buf + n, sizeof(buf) - n, ".%03d", static_cast<int>((wallNs / 1000000) % 1000));
+    return buf;
+}
+
+void print(const BinLogReader::Record &r, bool json)
+{
+    std::string msg = r.message();
+    const char *level = BinLogReader::levelName(r.level);
+    if (!json)
+    {
+        std::cout << '[' << timestamp(r.wallNs) << "] [" << level << "] " << msg << '\n';
+        return;
+    }
+    std::cout << "{\"ts\":\"" << timestamp(r.wallNs) << "\",\"ts_ns\":" << r.wallNs
+              << ",\"level\":\"" << level << "\",\"msg\":\"" << jsonEscape(msg)
+              << "\",\"format\":\"" << jsonEscape(r.format) << "\",\"args\":[";
+    for (size_t i = 0; i < r.args.size(); ++i)
+    {
+        if (i) std::cout << ',';
+        if (r.args[i].type == 's')
+            std::cout << '"' << jsonEscape(r.args[i].text) << '"';
+        else
+            std::cout << r.args[i].text;
+    }
+    std::cout << "]}\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    bool json = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string a = argv[i];
+        if (a == "--json")
+            json = true;
+        else if (a == "-h" || a == "--help")
+        {
+            std::cout << "usage: cppAuth_logcat [--json] FILE...\n";
+            return 0;
+        }
+        else
+            files.push_back(a);
+    }
+    if (files.empty())
+    {
+        std::cerr << "usage: cppAuth_logcat [--json] FILE...\n";
+        return 2;
+    }
+
+    int rc = 0;
+    for (const auto &path : files)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            std::cerr << path << ": cannot open\n";
+            rc = 1;
+            continue;
+        }
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        BinLogReader reader(data);
+        if (!reader.read([json](const BinLogReader::Record &r) { print(r, json); }))
+        {
+            std::cerr << path << ": stopped early: " << reader.error() << "\n";
+            rc = 1;
+        }
+    }
+    return rc;
+}
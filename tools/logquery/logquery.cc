@@ -0,0 +1,208 @@
+// cppAuth_logquery: searches archived logs (see include/LogArchiver.h).
+//
+// Each archive's .idx sidecar is mmapped and only the gzip members whose
+// time range and request-id filter match are read and decompressed.
+//
+// Usage:
+//   cppAuth_logquery [--from "2026-10-19 14:00:00"] [--to "2026-10-19 15:00:00"]
+//                    [--request ID] [ARCHIVE_DIR_OR_IDX...]
+//
+// With no paths, logs/archive is searched. Times are local, like the logs.
+// BinLog members are printed in cppAuth_logcat's text format.
+
+#include <drogon/utils/Utilities.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "LogArchiver.h"
+
+namespace {
+
+struct Query
+{
+    int64_t from = 0;
+    int64_t to = 0; // 0: open-ended
+    std::string request;
+
+    bool overlaps(const LogIndex::Entry &e) const
+    {
+        if (!e.firstTs) return true; // nothing timestamped; cannot rule it out
+        if (from && e.lastTs < from) return false;
+        if (to && e.firstTs > to) return false;
+        return true;
+    }
+
+    bool inWindow(int64_t ts) const
+    {
+        return (!from || ts >= from) && (!to || ts <= to);
+    }
+};
+
+int64_t parseTime(const char *s)
+{
+    std::tm tm{};
+    if (!strptime(s, "%Y-%m-%d %H:%M:%S", &tm))
+    {
+        std::cerr << "bad time '" << s << "', expected YYYY-MM-DD HH:MM:SS\n";
+        std::exit(2);
+    }
+    tm.tm_isdst = -1;
+    return static_cast<int64_t>(std::mktime(&tm));
+}
+
+std::string timestamp(int64_t wallNs)
+{
+    std::time_t secs = static_cast<std::time_t>(wallNs / 1000000000);
+    std::tm tm{};
+    localtime_r(&secs, &tm);
+    char buf[40];
+    size_t n = std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    std::snprintf(buf + n, sizeof(buf) - n, ".%03d", static_cast<int>((wallNs / 1000000) % 1000));
+    return buf;
+}
+
+void printText(std::string_view data, const Query &q)
+{
+    int64_t ts = 0; // continuation lines inherit the last timestamp
+    size_t pos = 0;
+    while (pos < data.size())
+    {
+        size_t eol = data.find('\n', pos);
+        if (eol == std::string_view::npos) eol = data.size();
+        std::string_view line = data.substr(pos, eol - pos);
+        pos = eol + 1;
+        if (int64_t t = LogIndex::lineTime(line)) ts = t;
+        if (ts && !q.inWindow(ts)) continue;
+        if (!q.request.empty() && LogIndex::requestId(line) != q.request) continue;
+        std::cout << line << '\n';
+    }
+}
+
+void printBinary(std::string_view data, const Query &q)
+{
+    BinLogReader reader(data);
+    bool ok = reader.read([&q](const BinLogReader::Record &r) {
+        if (!q.inWindow(r.wallNs / 1000000000)) return;
+        if (!q.request.empty() &&
+            (r.format.compare(0, 9, "REQ_ID={}") != 0 || r.args.empty() || r.args[0].text != q.request))
+            return;
+        std::cout << '[' << timestamp(r.wallNs) << "] [" << BinLogReader::levelName(r.level) << "] "
+                  << r.message() << '\n';
+    });
+    if (!ok) std::cerr << "binary member stopped early: " << reader.error() << "\n";
+}
+
+// Returns the number of members decompressed.
+size_t search(const std::string &idxPath, const Query &q)
+{
+    int fd = ::open(idxPath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << idxPath << ": cannot open\n";
+        return 0;
+    }
+    struct stat st{};
+    fstat(fd, &st);
+    if (static_cast<size_t>(st.st_size) < sizeof(LogIndex::Header))
+    {
+        ::close(fd);
+        return 0;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return 0;
+
+    auto *header = static_cast<const LogIndex::Header *>(map);
+    auto *entries = reinterpret_cast<const LogIndex::Entry *>(header + 1);
+    size_t count = header->count;
+    auto *blooms = reinterpret_cast<const uint64_t *>(entries + count);
+    size_t bloomWords = (st.st_size - sizeof(LogIndex::Header) - count * sizeof(LogIndex::Entry)) / sizeof(uint64_t);
+    if (std::memcmp(header->magic, LogIndex::kMagic, sizeof(header->magic)) != 0 ||
+        sizeof(LogIndex::Header) + count * sizeof(LogIndex::Entry) > static_cast<size_t>(st.st_size))
+    {
+        std::cerr << idxPath << ": not a log index\n";
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    std::string gzPath = idxPath.substr(0, idxPath.size() - 4) + ".gz";
+    int gz = ::open(gzPath.c_str(), O_RDONLY);
+    size_t read = 0;
+    for (size_t i = 0; gz >= 0 && i < count; ++i)
+    {
+        const LogIndex::Entry &e = entries[i];
+        if (!q.overlaps(e)) continue;
+        if (!q.request.empty() &&
+            (e.bloomOffset + e.bloomWords > bloomWords ||
+             !LogIndex::bloomMayContain(blooms + e.bloomOffset, e.bloomWords, q.request)))
+            continue;
+
+        std::string member(e.length, '\0');
+        if (pread(gz, member.data(), e.length, static_cast<off_t>(e.offset)) != static_cast<ssize_t>(e.length))
+        {
+            std::cerr << gzPath << ": short read\n";
+            break;
+        }
+        std::string data = drogon::utils::gzipDecompress(member.data(), member.size());
+        ++read;
+        if (e.binary)
+            printBinary(data, q);
+        else
+            printText(data, q);
+    }
+    if (gz >= 0) ::close(gz);
+    munmap(map, st.st_size);
+    return read;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Query q;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string a = argv[i];
+        if (a == "--from" && i + 1 < argc) q.from = parseTime(argv[++i]);
+        else if (a == "--to" && i + 1 < argc) q.to = parseTime(argv[++i]);
+        else if (a == "--request" && i + 1 < argc) q.request = argv[++i];
+        else if (a == "-h" || a == "--help")
+        {
+            std::cout << "usage: cppAuth_logquery [--from TIME] [--to TIME] [--request ID] [DIR|IDX...]\n";
+            return 0;
+        }
+        else paths.push_back(a);
+    }
+    if (paths.empty()) paths.push_back("logs/archive");
+
+    std::vector<std::string> indexes;
+    for (const auto &p : paths)
+    {
+        std::error_code ec;
+        if (std::filesystem::is_directory(p, ec))
+        {
+            for (const auto &entry : std::filesystem::directory_iterator(p, ec))
+                if (entry.path().extension() == ".idx") indexes.push_back(entry.path().string());
+        }
+        else
+            indexes.push_back(p);
+    }
+    std::sort(indexes.begin(), indexes.end());
+
+    size_t members = 0;
+    for (const auto &idx : indexes)
+        members += search(idx, q);
+    std::cerr << indexes.size() << " archives, " << members << " chunks decompressed\n";
+    return 0;
+}
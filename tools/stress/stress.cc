@@ -0,0 +1,501 @@
+// cppAuth_stress: drives BankController with contended random traffic and
+// checks that no money was created or destroyed.
+//
+// Every worker thread runs a closed loop of transfers, batch transfers,
+// deposits, withdrawals and balance reads between a small set of seeded accounts, calling the
+// controller's handlers directly (no HTTP), so the database and the handler
+// logic are what gets stressed. The first --registered accounts are set up
+// the way a client would: POST /register, POST /login for the access token
+// and a first deposit of --initial. The rest are inserted directly, with
+// tokens minted under the server's secret, so large populations stay cheap. A fraction of the operations are invalid on
+// purpose (zero or negative amounts, a transfer to an account that does not
+// exist) and must be rejected.
+//
+// Afterwards the accounts are read back and the run fails if
+//   - the sum of the balances differs from
+//     seeded total + accepted deposits - accepted withdrawals,
+//   - any balance is negative, or
+//   - any invalid operation was accepted.
+//
+// Usage:
+//   cppAuth_stress [--db sqlite:FILE | --db postgres:CONNINFO] [--concurrent]
+//                  [--connections N] [--accounts N] [--initial N] [--threads N]
+//                  [--duration S] [--seed N] [--invalid FRACTION] [--retries N]
+//                  [--registered N]
+//
+// SQLite files are created with a minimal users table; Postgres needs the
+// server's schema already in place. --concurrent opens SQLite the way
+// SQLITE_MODE=concurrent does (see include/SqliteTuning.h). Accounts are
+// named stress-<n> and replaced on every run; nothing else is touched.
+//
+// A 500 (e.g. "database is locked") counts as a conflict and the operation is
+// retried up to --retries times with the same amount. Exit status: 0
+// conserved, 1 violated, 2 usage or setup error.
+
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <drogon/orm/DbClient.h>
+#include <json/json.h>
+#include <trantor/net/EventLoopThread.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AuthController.h"
+#include "BankController.h"
+#include "DbRouter.h"
+#include "HdrHistogram.h"
+#include "IdAllocator.h"
+#include "JwtSigner.h"
+#include "PasswordHasher.h"
+#include "RuntimeConfig.h"
+#include "ShardMap.h"
+#include "SingleFlight.h"
+#include "SqliteTuning.h"
+#include "TransferSaga.h"
+
+using namespace drogon;
+using Clock = std::chrono::steady_clock;
+
+// AuthController keeps the server's global client pointed at the primary
+drogon::orm::DbClientPtr dbClient;
+
+namespace {
+
+struct StressOptions
+{
+    std::string db = "sqlite:./stress.db";
+    bool concurrent = false; // SQLite WAL readers + batched writer
+    size_t connections = 4;
+    size_t accounts = 50;
+    int64_t initial = 1000;
+    size_t threads = 16;
+    double duration = 10;
+    uint64_t seed = 1;
+    double invalid = 0.05;
+    int retries = 3;
+    size_t registered = 10; // accounts set up through /register and /login
+};
+
+enum Op
+{
+    Transfer,
+    Deposit,
+    Withdraw,
+    Balance,
+    Batch,
+    kOps
+};
+
+const char *const kOpNames[kOps] = {"transfer", "deposit", "withdraw", "balance", "batch"};
+
+struct OpStats
+{
+    HdrHistogram latency; // microseconds, retries included
+    std::atomic<uint64_t> ok{0};
+    std::atomic<uint64_t> declined{0}; // insufficient balance
+    std::atomic<uint64_t> failed{0};   // still failing after the retries
+};
+
+struct Stats
+{
+    OpStats ops[kOps];
+    std::atomic<uint64_t> conflicts{0}; // 500s seen, retried or not
+    std::atomic<uint64_t> retries{0};
+    std::atomic<uint64_t> invalidSent{0};
+    std::atomic<uint64_t> invalidAccepted{0};
+    std::atomic<uint64_t> negativeSeen{0}; // negative balance in a response
+    std::atomic<int64_t> deposited{0};
+    std::atomic<int64_t> withdrawn{0};
+};
+
+void usage()
+{
+    std::cerr << "usage: cppAuth_stress [--db sqlite:FILE | --db postgres:CONNINFO] [--concurrent]\n"
+                 "                      [--connections N] [--accounts N] [--initial N] [--threads N]\n"
+                 "                      [--duration S] [--seed N] [--invalid FRACTION] [--retries N]\n"
+                 "                      [--registered N]\n";
+}
+
+bool parseArgs(int argc, char **argv, StressOptions &o)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string a = argv[i];
+        auto next = [&](const char *name) -> const char * {
+            if (i + 1 >= argc)
+                throw std::runtime_error(std::string("missing value for ") + name);
+            return argv[++i];
+        };
+        if (a == "--db") o.db = next("--db");
+        else if (a == "--concurrent") o.concurrent = true;
+        else if (a == "--connections") o.connections = std::strtoul(next("--connections"), nullptr, 10);
+        else if (a == "--accounts") o.accounts = std::strtoul(next("--accounts"), nullptr, 10);
+        else if (a == "--initial") o.initial = std::strtoll(next("--initial"), nullptr, 10);
+        else if (a == "--threads") o.threads = std::strtoul(next("--threads"), nullptr, 10);
+        else if (a == "--duration") o.duration = std::atof(next("--duration"));
+        else if (a == "--seed") o.seed = std::strtoull(next("--seed"), nullptr, 10);
+        else if (a == "--invalid") o.invalid = std::atof(next("--invalid"));
+        else if (a == "--retries") o.retries = std::atoi(next("--retries"));
+        else if (a == "--registered") o.registered = std::strtoul(next("--registered"), nullptr, 10);
+        else if (a == "-h" || a == "--help") return false;
+        else throw std::runtime_error("unknown option " + a);
+    }
+    o.registered = std::min(o.registered, o.accounts);
+    return o.accounts >= 2 && o.initial >= 0 && o.threads > 0 && o.connections > 0 && o.duration > 0 &&
+           o.invalid >= 0 && o.invalid <= 1 && o.retries >= 0 &&
+           (o.db.rfind("sqlite:", 0) == 0 || o.db.rfind("postgres:", 0) == 0);
+}
+
+bool isSqlite(const StressOptions &o) { return o.db.rfind("sqlite:", 0) == 0; }
+
+std::shared_ptr<DbRouter> connect(const StressOptions &o)
+{
+    if (!isSqlite(o))
+        return std::make_shared<DbRouter>(orm::DbClient::newPgClient(o.db.substr(9), o.connections));
+    std::string conninfo = "filename=" + o.db.substr(7);
+    if (o.concurrent)
+    {
+        auto tuning = SqliteTuning::fromEnv();
+        tuning.readers = o.connections;
+        return tuning.open(conninfo);
+    }
+    return std::make_shared<DbRouter>(orm::DbClient::newSqlite3Client(conninfo, o.connections));
+}
+
+// Account numbers of the directly seeded accounts come from a block no real
+// allocation starts in.
+std::string accountOf(size_t i) { return AccountNumber::format(900000000 + i); }
+
+std::string userOf(size_t i) { return "stress-" + std::to_string(i); }
+
+void seed(const StressOptions &o, const orm::DbClientPtr &db)
+{
+    if (isSqlite(o))
+        db->execSqlSync("CREATE TABLE IF NOT EXISTS users ("
+                        "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                        "username TEXT UNIQUE NOT NULL, "
+                        "email TEXT, "
+                        "password_hash TEXT, "
+                        "account_number TEXT UNIQUE, "
+                        "balance REAL NOT NULL DEFAULT 0, "
+                        "created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP)");
+    db->execSqlSync("DELETE FROM users WHERE username LIKE 'stress-%'");
+    for (size_t i = o.registered; i < o.accounts; ++i)
+    {
+        std::string name = userOf(i);
+        db->execSqlSync("INSERT INTO users (username, email, password_hash, account_number, balance) "
+                        "VALUES ($1, $2, $3, $4, $5)",
+                        name, name + "@stress.local", std::string("-"), accountOf(i),
+                        static_cast<double>(o.initial));
+    }
+}
+
+struct Outcome
+{
+    int status = 0;
+    double balance = NAN; // "new_balance" or "balance", when present
+    bool applied = true;  // false for a batch none of whose items went through
+};
+
+template <class Controller>
+using Handler = void (Controller::*)(const HttpRequestPtr &, std::function<void(const HttpResponsePtr &)> &&);
+
+// Runs one handler and waits for its response. Without a token no
+// Authorization header is sent; with `loop` the handler is called on it;
+// with `reply` the JSON response body is copied there.
+template <class Controller>
+Outcome call(Controller &controller, Handler<Controller> handler, const std::string &token, const Json::Value &body,
+             trantor::EventLoop *loop = nullptr, Json::Value *reply = nullptr)
+{
+    auto req = body.isNull() ? HttpRequest::newHttpRequest() : HttpRequest::newHttpJsonRequest(body);
+    if (!token.empty())
+        req->addHeader("Authorization", "Bearer " + token);
+    std::promise<Outcome> done;
+    auto result = done.get_future();
+    auto invoke = [&] {
+        (controller.*handler)(req, [&done, reply](const HttpResponsePtr &resp) {
+            Outcome out;
+            out.status = static_cast<int>(resp->statusCode());
+            if (auto json = resp->jsonObject())
+            {
+                if ((*json)["new_balance"].isNumeric()) out.balance = (*json)["new_balance"].asDouble();
+                else if ((*json)["balance"].isNumeric()) out.balance = (*json)["balance"].asDouble();
+                out.applied = (*json)["status"].asString() != "failed";
+                if (reply) *reply = *json;
+            }
+            done.set_value(out);
+        });
+    };
+    if (loop)
+        loop->queueInLoop(invoke);
+    else
+        invoke();
+    return result.get();
+}
+
+// Registers, logs in and funds account i as a client would; fills in its
+// account number and access token.
+void enroll(AuthController &auth, BankController &bank, trantor::EventLoop *loop, size_t i, int64_t initial,
+            std::string &account, std::string &token)
+{
+    std::string name = userOf(i);
+    Json::Value body, reply;
+    body["username"] = name;
+    body["email"] = name + "@stress.local";
+    body["password"] = "stress-password-" + std::to_string(i);
+
+    Outcome out = call(auth, &AuthController::registerUser, {}, body, loop, &reply);
+    account = reply["account_number"].asString();
+    if (out.status != 200 || account.empty())
+        throw std::runtime_error("/register " + name + " returned " + std::to_string(out.status));
+
+    out = call(auth, &AuthController::loginUser, {}, body, loop, &reply);
+    token = reply["access_token"].asString();
+    if (out.status != 200 || token.empty())
+        throw std::runtime_error("/login " + name + " returned " + std::to_string(out.status));
+
+    if (initial > 0)
+    {
+        Json::Value deposit;
+        deposit["amount"] = static_cast<double>(initial);
+        out = call(bank, &BankController::deposit, token, deposit);
+        if (out.status != 200)
+            throw std::runtime_error("first deposit for " + name + " returned " + std::to_string(out.status));
+    }
+}
+
+void worker(const StressOptions &o, BankController &bank, const std::vector<std::string> &accounts,
+            const std::vector<std::string> &tokens, size_t id, Clock::time_point until, Stats &stats)
+{
+    std::mt19937_64 rng(o.seed * 1000003 + id);
+    std::uniform_int_distribution<size_t> pickAccount(0, o.accounts - 1);
+    std::uniform_int_distribution<int> pickAmount(1, static_cast<int>(std::max<int64_t>(1, o.initial / 10)));
+    std::discrete_distribution<int> pickOp({55, 15, 15, 10, 5});
+    std::uniform_int_distribution<int> pickBatchSize(2, 8);
+    std::bernoulli_distribution pickInvalid(o.invalid);
+    const std::string ghost = accountOf(o.accounts + 1000000); // valid checksum, never seeded
+
+    while (Clock::now() < until)
+    {
+        Op op = static_cast<Op>(pickOp(rng));
+        size_t from = pickAccount(rng);
+        size_t to = pickAccount(rng);
+        if (to == from) to = (to + 1) % o.accounts;
+        double amount = pickAmount(rng);
+        bool invalid = op != Balance && op != Batch && pickInvalid(rng);
+        bool ghostTarget = false;
+        if (invalid)
+        {
+            if (op == Transfer && rng() % 3 == 0) ghostTarget = true;
+            else amount = rng() % 2 ? 0 : -amount;
+        }
+
+        Json::Value body;
+        Handler<BankController> handler = &BankController::getBalance;
+        if (op != Balance) body["amount"] = amount;
+        if (op == Transfer)
+        {
+            body["to_account"] = ghostTarget ? ghost : accounts[to];
+            handler = &BankController::transfer;
+        }
+        else if (op == Deposit)
+            handler = &BankController::deposit;
+        else if (op == Withdraw)
+            handler = &BankController::withdraw;
+        else if (op == Batch)
+        {
+            body = Json::Value(Json::arrayValue);
+            for (int n = pickBatchSize(rng); n > 0; --n)
+            {
+                size_t target = pickAccount(rng);
+                if (target == from) target = (target + 1) % o.accounts;
+                Json::Value item;
+                item["to_account"] = accounts[target];
+                item["amount"] = static_cast<double>(pickAmount(rng));
+                body.append(item);
+            }
+            handler = &BankController::transferBatch;
+        }
+
+        auto start = Clock::now();
+        Outcome out;
+        for (int attempt = 0;; ++attempt)
+        {
+            out = call(bank, handler, tokens[from], body);
+            if (out.status < 500) break;
+            ++stats.conflicts;
+            if (attempt >= o.retries) break;
+            ++stats.retries;
+        }
+        OpStats &s = stats.ops[op];
+        s.latency.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count()));
+
+        if (!std::isnan(out.balance) && out.balance < 0) ++stats.negativeSeen;
+        if (invalid)
+        {
+            ++stats.invalidSent;
+            if (out.status < 300)
+            {
+                ++stats.invalidAccepted;
+                std::cerr << "[stress] accepted invalid " << kOpNames[op] << " of " << amount
+                          << (ghostTarget ? " to a missing account" : "") << "\n";
+            }
+            continue;
+        }
+        if (out.status >= 500) ++s.failed;
+        else if (out.status >= 400 || !out.applied) ++s.declined;
+        else
+        {
+            ++s.ok;
+            if (op == Deposit) stats.deposited += static_cast<int64_t>(amount);
+            else if (op == Withdraw) stats.withdrawn += static_cast<int64_t>(amount);
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    StressOptions opt;
+    try
+    {
+        if (!parseArgs(argc, argv, opt))
+        {
+            usage();
+            return 2;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << "\n";
+        usage();
+        return 2;
+    }
+
+    std::shared_ptr<ShardMap> shards;
+    std::unique_ptr<BankController> bankPtr;
+    std::vector<std::string> accounts, tokens;
+    trantor::EventLoopThread enrollLoop("stress-enroll"); // IdAllocator::next() needs a loop thread
+    try
+    {
+        auto router = connect(opt);
+        seed(opt, router->writer());
+        shards = std::make_shared<ShardMap>(std::vector<std::shared_ptr<DbRouter>>{router});
+        TransferSaga::ensureSchema(*shards);
+
+        setenv("JWT_SECRET", "stress-secret-0123456789abcdef0123", 0);
+        const auto &cfg = RuntimeConfig::reloadFromEnv();
+
+        // Balance reads are coalesced as in the server's default configuration
+        bankPtr = std::make_unique<BankController>(shards, nullptr, std::make_shared<SingleFlight>(), nullptr);
+
+        if (opt.registered > 0)
+        {
+            auto accountIds = std::make_shared<IdAllocator>(router, "account_number", 100);
+            accountIds->ensureSchema();
+            AuthController auth(shards, accountIds);
+            PasswordHasher::instance().start(2);
+            enrollLoop.run();
+            accounts.resize(opt.registered);
+            tokens.resize(opt.registered);
+            for (size_t i = 0; i < opt.registered; ++i)
+                enroll(auth, *bankPtr, enrollLoop.getLoop(), i, opt.initial, accounts[i], tokens[i]);
+            PasswordHasher::instance().stop();
+        }
+        for (size_t i = opt.registered; i < opt.accounts; ++i)
+        {
+            accounts.push_back(accountOf(i));
+            tokens.push_back(JwtSigner::sign(userOf(i), std::chrono::hours(24), cfg.jwtSecret, accountOf(i)));
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "setup failed: " << e.what() << "\n";
+        return 2;
+    }
+
+    BankController &bank = *bankPtr;
+    Stats stats;
+    std::cerr << "[stress] " << opt.threads << " threads, " << opt.accounts << " accounts (" << opt.registered
+              << " registered), " << opt.duration
+              << "s against " << opt.db << "\n";
+
+    auto start = Clock::now();
+    auto until = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opt.duration));
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < opt.threads; ++t)
+        threads.emplace_back(worker, std::cref(opt), std::ref(bank), std::cref(accounts), std::cref(tokens), t, until,
+                             std::ref(stats));
+    for (auto &t : threads)
+        t.join();
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    auto r = shards->primary()->writer()->execSqlSync(
+        "SELECT COUNT(*) AS n, SUM(balance) AS total, MIN(balance) AS lowest, "
+        "SUM(CASE WHEN balance < 0 THEN 1 ELSE 0 END) AS negative FROM users WHERE username LIKE 'stress-%'");
+    auto count = r[0]["n"].as<int64_t>();
+    double total = r[0]["total"].as<double>();
+    double lowest = r[0]["lowest"].as<double>();
+    auto negative = r[0]["negative"].as<int64_t>();
+    double expected = static_cast<double>(opt.initial) * static_cast<double>(opt.accounts) +
+                      static_cast<double>(stats.deposited.load() - stats.withdrawn.load());
+
+    uint64_t completed = 0;
+    std::cout << "op        ok        declined  failed    p50_us    p99_us    max_us\n";
+    for (int op = 0; op < kOps; ++op)
+    {
+        const OpStats &s = stats.ops[op];
+        completed += s.latency.count();
+        std::printf("%-9s %-9llu %-9llu %-9llu %-9llu %-9llu %llu\n", kOpNames[op],
+                    static_cast<unsigned long long>(s.ok.load()), static_cast<unsigned long long>(s.declined.load()),
+                    static_cast<unsigned long long>(s.failed.load()),
+                    static_cast<unsigned long long>(s.latency.valueAtPercentile(50)),
+                    static_cast<unsigned long long>(s.latency.valueAtPercentile(99)),
+                    static_cast<unsigned long long>(s.latency.max()));
+    }
+    std::printf("throughput %.0f ops/s (%llu in %.1fs), conflicts %llu, retries %llu, invalid %llu sent\n",
+                completed / elapsed, static_cast<unsigned long long>(completed), elapsed,
+                static_cast<unsigned long long>(stats.conflicts.load()),
+                static_cast<unsigned long long>(stats.retries.load()),
+                static_cast<unsigned long long>(stats.invalidSent.load()));
+    std::printf("accounts %lld, total %.2f (expected %.2f), lowest balance %.2f\n", static_cast<long long>(count),
+                total, expected, lowest);
+
+    bool ok = true;
+    if (static_cast<size_t>(count) != opt.accounts)
+    {
+        std::cout << "VIOLATION: " << count << " accounts, seeded " << opt.accounts << "\n";
+        ok = false;
+    }
+    if (std::fabs(total - expected) > 0.005)
+    {
+        std::printf("VIOLATION: total is off by %.2f\n", total - expected);
+        ok = false;
+    }
+    if (negative > 0 || stats.negativeSeen > 0)
+    {
+        std::cout << "VIOLATION: " << negative << " negative balances, " << stats.negativeSeen.load()
+                  << " negative balances returned\n";
+        ok = false;
+    }
+    if (stats.invalidAccepted > 0)
+    {
+        std::cout << "VIOLATION: " << stats.invalidAccepted.load() << " invalid operations accepted\n";
+        ok = false;
+    }
+    std::cout << (ok ? "OK: balances conserved\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}